@@ -0,0 +1,121 @@
+//
+//  AmbisonicBus.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "AmbisonicBus.h"
+#include "Functions.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr int AmbisonicBus::maxOrder;
+constexpr int AmbisonicBus::maxNumChannels;
+constexpr int AmbisonicBus::defaultOrder;
+constexpr float AmbisonicBus::radius;
+
+AmbisonicBus::AmbisonicBus()
+    : filters (maxNumChannels * 2 * maxNumTimeSteps, 0.0f)
+{
+}
+
+void AmbisonicBus::allocate(const int newMaxBlockSize)
+{
+    maxBlockSize = newMaxBlockSize;
+    channels.assign(maxNumChannels * maxBlockSize, 0.0f);
+    channelBufferSize = maxBlockSize + maxNumTimeSteps;
+    channelBuffers.assign(maxNumChannels * 2 * channelBufferSize, 0.0f);
+    channelBufferPos = 0;
+}
+
+void AmbisonicBus::reset() noexcept
+{
+    std::fill(channelBuffers.begin(), channelBuffers.end(), 0.0f);
+    channelBufferPos = 0;
+    silentSamples = maxNumTimeSteps;
+}
+
+void AmbisonicBus::setDecoder(const HRIRSphericalHarmonics* newDecoder) noexcept
+{
+    decoder = newDecoder;
+    order = std::min(decoder->getOrder(), maxOrder);
+    numChannels = (order + 1) * (order + 1);
+    filterLength = decoder->getHRIRData()->getLength();
+    decoder->interpolateBasisFilters(radius, &filters[0]);
+}
+
+void AmbisonicBus::encode(const float* rae, float* gains) const noexcept
+{
+    // the same direction convention as HRIRSphericalHarmonics::interpolateHRIR(), and its 1/sqrt(r) falloff relative to the decoder's distance
+    HRIRSphericalHarmonics::evaluateBasis(order, rae[2], (float)(2*M_PI) - rae[1], gains);
+    const float scale = std::sqrt(radius / rae[0]);
+    for (int c = 0; c < numChannels; ++c)
+        gains[c] *= scale;
+}
+
+void AmbisonicBus::beginBlock(const int N) noexcept
+{
+    std::fill_n(channels.begin(), numChannels * N, 0.0f);
+    active = false;
+}
+
+void AmbisonicBus::add(const float* signal, const float* fromGains, const float* toGains, const int N) noexcept
+{
+    // the ramp is the same for every channel, so it's applied to the signal once and each channel just takes a mix of the signal and the ramped signal
+    STACK_ARRAY(float, rampedSignal, N)
+    const float oneOverN = 1.0f / N;
+    for (int n = 0; n < N; ++n)
+        rampedSignal[n] = signal[n] * (n * oneOverN);
+    for (int c = 0; c < numChannels; ++c) {
+        float* const channel = &channels[c * N];
+        const float g = fromGains[c], dg = toGains[c] - fromGains[c];
+        for (int n = 0; n < N; ++n)
+            channel[n] += g * signal[n] + dg * rampedSignal[n];
+    }
+    active = true;
+}
+
+void AmbisonicBus::render(float* out, const int N) noexcept
+{
+    // the channels go into their mirrored buffers even while silent so they're all caught up once something plays again
+    for (int c = 0; c < numChannels; ++c) {
+        const float* const channel = &channels[c * N];
+        float* const buffer = &channelBuffers[c * 2 * channelBufferSize];
+        for (int n = 0, i = channelBufferPos; n < N; ++n) {
+            buffer[i] = buffer[i + channelBufferSize] = channel[n];
+            if (++i == channelBufferSize)
+                i = 0;
+        }
+    }
+    silentSamples = active ? 0 : std::min(silentSamples + N, maxNumTimeSteps);
+    if (silentSamples < maxNumTimeSteps) {
+        STACK_ARRAY(float, y, 2*N)
+        for (int c = 0; c < numChannels; ++c) {
+            const float* const filter = &filters[c * 2 * maxNumTimeSteps];
+            convolveStereo(&channelBuffers[c * 2 * channelBufferSize], channelBufferPos, channelBufferSize, filter, filter + maxNumTimeSteps, filterLength, 1, 1,
+                           &y[0], &y[N], N);
+            for (int n = 0; n < 2*N; ++n)
+                out[n] += y[n];
+        }
+    }
+    channelBufferPos = (channelBufferPos + N) % channelBufferSize;
+}
@@ -0,0 +1,87 @@
+//
+//  AmbisonicBus.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __AmbisonicBus__
+#define __AmbisonicBus__
+
+#include "HRIRSphericalHarmonics.h"
+#include <vector>
+
+// a higher order ambisonic bus that all the sources are encoded into, each one with just a gain per channel (the spherical harmonics at its direction), and
+// that is then decoded to binaural once per block. the decoding filters are an HRIRSphericalHarmonics fit of the hrir data at the bus's order, its basis
+// filters are exactly what each ambisonic channel has to be convolved with for the sum to be the fitted hrirs, so a source's sound is the same as the fit's
+// interpolated hrir and the convolution cost is bounded by the number of channels instead of the number of sources. for the audio thread, except for the
+// constructor and allocate().
+class AmbisonicBus
+{
+public:
+    // orders past 7 cost more to decode than convolving a reasonable number of sources directly
+    static constexpr int maxOrder = 7;
+    static constexpr int maxNumChannels = (maxOrder + 1) * (maxOrder + 1);
+    static constexpr int defaultOrder = 3;
+    // the decoding filters are those of the fit at this distance (in meters) from the center of the head
+    static constexpr float radius = 1;
+
+    AmbisonicBus();
+    AmbisonicBus(const AmbisonicBus&) = delete;
+    AmbisonicBus& operator=(const AmbisonicBus&) = delete;
+    /** allocate for blocks of up to maxBlockSize samples, not realtime safe */
+    void allocate(int maxBlockSize);
+    /** forget the bus's history */
+    void reset() noexcept;
+    /** decode with the basis filters of a (ready) spherical harmonic fit, the bus takes on its order */
+    void setDecoder(const HRIRSphericalHarmonics* newDecoder) noexcept;
+    /** the fit decoding the bus, nullptr until setDecoder() */
+    const HRIRSphericalHarmonics* getDecoder() const noexcept { return decoder; }
+    int getOrder() const noexcept { return order; }
+    int getNumChannels() const noexcept { return numChannels; }
+    /** the channel gains for a source at rae, with the same falloff with distance as the hrir interpolation has */
+    void encode(const float* rae, float* gains) const noexcept;
+    /** start a new block of N samples with all the channels silent */
+    void beginBlock(int N) noexcept;
+    /** add a source's signal to the bus, its gains moving linearly from one encoding to the other across the block */
+    void add(const float* signal, const float* fromGains, const float* toGains, int N) noexcept;
+    /** convolve each channel of the block with its decoding filters and add them into the stereo output (the left ear at out[0], the right at out[N]) */
+    void render(float* out, int N) noexcept;
+
+private:
+    const HRIRSphericalHarmonics* decoder = nullptr;
+    int order = 0;
+    int numChannels = 1;
+    int filterLength = numTimeSteps;
+    // each channel's decoding filter pair [channel][ear][numTimeSteps]
+    std::vector<float> filters;
+    // this block's channels [channel][sample], and each channel's circular buffer mirrored into its second half (like PlayableSoundSource's)
+    std::vector<float> channels;
+    std::vector<float> channelBuffers;
+    int channelBufferSize = 0;
+    int channelBufferPos = 0;
+    int maxBlockSize = 0;
+    // whether any source was added this block, and for how many samples the bus has been silent so decoding can stop once the filters have rung out
+    bool active = false;
+    int silentSamples = maxNumTimeSteps;
+};
+
+#endif /* defined(__AmbisonicBus__) */
@@ -34,6 +34,9 @@
 #define distanceBegin  0.1
 #define distanceEnd  3.25
 #define sampleRate_HRTF  44100.0
+// the hrir data is resampled to the host's sample rate up to this, the longest hrirs (numTimeSteps at this rate rounded up to a multiple of 32) are what all the buffers of hrirs are strided by
+#define maxSampleRate_HRTF  96000.0
+#define maxNumTimeSteps  288
 #define sphereRad  0.09
 #define threshold  0.00000001
 #define earElevation  90
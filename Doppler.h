@@ -28,38 +28,96 @@
 #ifndef __Doppler__
 #define __Doppler__
 
+#include <atomic>
 #include <vector>
 
 static constexpr float defaultSpeedOfSound = 343.0f; // in meters/sec
 
-class Doppler
+/** where a source's doppler effect goes. DELAY_LINE delays its input once with a DopplerDelayLine tap for each ear before the hrir convolution, PER_EAR
+    runs a Doppler on each ear's output after it. PER_EAR costs more (and more the faster the source moves), but it leaves the source's input alone so
+    the sources can still share the basis filters' convolution */
+enum class DopplerMode { DELAY_LINE, PER_EAR };
+
+/** the circular buffer the doppler effects keep their delayed audio in, sized for how long sound takes to go some distance. another thread can make a
+    longer one as the sources go farther away (or a shorter one when the speed of sound goes up) while the audio thread keeps using it, see
+    getResizeSize() */
+class DopplerBuffer
 {
 public:
-	/*Doppler() noexcept;
-	~Doppler();*/
-    /** process an input audio buffer at certain distance from the listener such that the doppler effect is applied to output */
-	void process(float distance, int bufferSize, const float* input, float* output) noexcept;
-    /** allocate enough memory for the doppler effect given a maximum sound source distance (in meters), maximum buffer size, and minimum speed of sound (in m/s) */
-	void allocate(float maxDistance, int maxBufferSize, float speedOfSoundToPlanAllocationSize);
+	DopplerBuffer() noexcept {}
+    // copies the buffer as it is, not a resized one still waiting to be swapped in
+    DopplerBuffer(const DopplerBuffer& other);
+    DopplerBuffer& operator=(const DopplerBuffer& other);
+	~DopplerBuffer();
+    /** the length of buffer to make if this one is too short for the farthest distance the audio thread has been given at the current speed of sound
+        (or far longer than it needs to be), 0 if it's fine or the last one made hasn't been swapped in yet. the buffer is made by the caller, so it can
+        do that without holding whatever keeps this object around, and then handed over with setResizedBuffer(). like the rest of resizing, for calling
+        off of the audio thread while it processes (from one thread at a time) */
+    int getResizeSize() const noexcept;
+    /** hands over the buffer made for getResizeSize() for the audio thread to swap in, returns false if it won't do anymore (the source may have gone
+        farther in the meantime, or the buffer was reallocated or freed), the caller still owns it then */
+    bool setResizedBuffer(std::vector<float>* resized) noexcept;
+    /** the buffer the audio thread swapped out last time (if any) for the caller to free, it doesn't swap in another until this is taken */
+    std::vector<float>* takeRetiredBuffer() noexcept;
+    /** bytes of memory the buffer takes */
+    std::size_t getMemorySize() const noexcept;
     /** free all memory */
 	void free()	noexcept;
-    /** reset the doppler effect state */
-	void reset() noexcept;
     /** specify the sample rate of the audio being processed */
 	void setSampleRate(float sampleRate) noexcept;
     /** set the speed of sound for the doppler effect */
 	void setSpeedOfSound(float speedOfSound) noexcept;
-private:
+    // longest delay (in seconds) a buffer is ever made for, a source farther away than this at a slow speed of sound is heard too early
+    static constexpr float maxDelayTime = 60;
+protected:
+    // (re)allocate a zeroed buffer for sources up to maxDistance (in meters) away at the current speed of sound and blocks of up to maxBufferSize
+    void allocateBuffer(float maxDistance, int maxBufferSize);
+    // delay (in samples) for sound to go the distance, held at the longest one the buffer fits for a block of blockSize samples (leaving some room for the
+    // delay interpolation to overshoot) until a longer one is swapped in
+    float getDelay(float distance, int blockSize) noexcept;
+    // the buffer from setResizedBuffer() (if any) for the audio thread to copy the delayed audio into and then swapBuffer() in
+    std::vector<float>* getResizedBuffer() noexcept;
+    void swapBuffer(std::vector<float>* resized) noexcept;
 	// circular buffer for holding delayed input
 	std::vector<float> buffer;
+private:
+    // length of buffer needed for a distance at the current speed of sound and sample rate
+    int getSizeFor(float distance) const noexcept;
+    // if a buffer of the length does for the farthest distance so far, with headroom so a source moving away doesn't need a new one every time it gets a
+    // little farther, and isn't far too long
+    bool isSizeFine(int size) const noexcept;
+    // buffer.size() for the other threads
+    std::atomic<int> bufferSize {0};
+    // from setResizedBuffer() for the audio thread to swap in, and the one swapped out for takeRetiredBuffer()
+    std::atomic<std::vector<float>*> resizedBuffer {nullptr};
+    std::atomic<std::vector<float>*> retiredBuffer {nullptr};
+    // largest distance the audio thread has been given (in meters) and buffer size allocated for
+    std::atomic<float> farthestDistance {0};
+    std::atomic<int> maxBufferSize {0};
+	// sample rate (in Hz)
+	std::atomic<float> sampleRate {44100};
+	// in meters / sec
+	std::atomic<float> speedOfSound {defaultSpeedOfSound};
+};
+
+/** the doppler effect for one signal, each input sample is spread into the buffer at the time it arrives */
+class Doppler : public DopplerBuffer
+{
+public:
+    /** process an input audio buffer at certain distance from the listener such that the doppler effect is applied to output */
+	void process(float distance, int bufferSize, const float* input, float* output) noexcept;
+    /** allocate enough memory for the doppler effect given a maximum sound source distance (in meters) at the current speed of sound and sample rate,
+        and the maximum buffer size */
+	void allocate(float maxDistance, int maxBufferSize);
+    /** reset the doppler effect state */
+	void reset() noexcept;
+private:
+    // swaps in the buffer from setResizedBuffer() (if any), keeping the delayed audio in it
+    void swapInResizedBuffer() noexcept;
 	// next index to insert input in circular buffer
 	float bufferInIdx = 0;
 	// next index to output from circular buffer
 	float bufferOutIdx = 0;
-	// sample rate (in Hz)
-	float sampleRate = 44100; 
-	// in meters / sec
-	float speedOfSound = defaultSpeedOfSound;
 	// previous buffer's delay at end (in samples) 
 	float delayPrev = -1; 
 	// distance delay over input sample slope at begining of current input buffer / end of last input buffer
@@ -70,6 +128,33 @@ private:
 	float prevSampleDelayedIdx = 0;
 };
 
+/** the doppler effect for a few listening points (like the two ears) off of one buffer, the signal goes in once and each point's output is read back
+    out at a fractional delay for its own distance. unlike Doppler the cost per sample is the same however fast the source moves */
+class DopplerDelayLine : public DopplerBuffer
+{
+public:
+    /** put an input audio buffer into the delay line and read out each tap's output, delayed for the time sound takes to go its distance (in meters) from
+        the source. the delays glide over the buffer from the ones the taps had at the end of the last buffer, picking up at the rate they were changing
+        so the pitch doesn't jump between buffers, and the output is read with cubic lagrange interpolation */
+    void process(const float* input, int bufferSize, const float* distances, int numTaps, float* const* outputs) noexcept;
+    /** allocate enough memory for the doppler effect given a maximum sound source distance (in meters) at the current speed of sound and sample rate,
+        and the maximum buffer size */
+	void allocate(float maxDistance, int maxBufferSize);
+    /** reset the doppler effect state */
+	void reset() noexcept;
+    static constexpr int maxNumTaps = 2;
+private:
+    // swaps in the buffer from setResizedBuffer() (if any), keeping the most recent inputs in it
+    void swapInResizedBuffer() noexcept;
+    // the first few samples of the circular buffer are repeated past its end so the 4 samples for any interpolation are contiguous
+    static constexpr int mirroredSize = 3;
+    // next index to insert input in circular buffer
+    int bufferInIdx = 0;
+    // each tap's delay at the end of the previous buffer (in samples), -1 for none yet, and how fast it was changing then (in samples per sample)
+    float delaysPrev[maxNumTaps] {-1, -1};
+    float slopesPrev[maxNumTaps] {0, 0};
+};
+
 
 
 
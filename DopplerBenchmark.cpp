@@ -0,0 +1,87 @@
+//
+//  DopplerBenchmark.cpp
+//  ThreeDAudio
+//
+//  Created by Andrew Barker on 10/18/26.
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+// standalone benchmark of the two doppler effects, not part of the plugin (everything is behind DOPPLER_BENCHMARK so it builds to nothing there).
+// it times Doppler (each input sample spread into the buffer) and DopplerDelayLine (each output sample read back out) for one signal moving
+// sinusoidally 20 m either side of 40 m away at a range of peak speeds, supersonic ones included, and checks that both outputs stay finite:
+//
+//     c++ -std=c++14 -O2 -march=native -DDOPPLER_BENCHMARK DopplerBenchmark.cpp Doppler.cpp -o DopplerBenchmark && ./DopplerBenchmark
+
+#ifdef DOPPLER_BENCHMARK
+
+#include "Doppler.h"
+#include "Functions.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+int main()
+{
+    constexpr float sampleRate = 44100;
+    constexpr int bufferSize = 512;
+    constexpr int numBuffers = 3000;
+    // buffers at the start left out of the timing while the delays settle
+    constexpr int numWarmUpBuffers = 100;
+    constexpr float centerDistance = 40, swing = 20;
+    std::vector<float> input (bufferSize);
+    for (int n = 0; n < bufferSize; ++n)
+        input[n] = std::sin(0.05f * n);
+    std::vector<float> scatterOutput (bufferSize), pullOutput (bufferSize);
+    float* pullOutputs[1] {pullOutput.data()};
+    std::printf("%10s %16s %16s   (us per %d sample buffer, one signal)\n", "peak m/s", "Doppler", "DopplerDelayLine", bufferSize);
+    for (const float peakSpeed : {0.0f, 10.0f, 100.0f, 300.0f, 500.0f, 1000.0f, 3000.0f}) {
+        Doppler scatter;
+        DopplerDelayLine pull;
+        for (DopplerBuffer* d : {(DopplerBuffer*)&scatter, (DopplerBuffer*)&pull})
+            d->setSampleRate(sampleRate);
+        scatter.allocate(centerDistance + swing, bufferSize);
+        pull.allocate(centerDistance + swing, bufferSize);
+        double scatterTime = 0, pullTime = 0;
+        bool finite = true;
+        for (int b = 0; b < numBuffers; ++b) {
+            const double t = double(b + 1) * bufferSize / sampleRate;
+            const float distance = centerDistance + swing * (float)std::sin(peakSpeed / swing * t);
+            cauto start = std::chrono::steady_clock::now();
+            scatter.process(distance, bufferSize, input.data(), scatterOutput.data());
+            cauto middle = std::chrono::steady_clock::now();
+            pull.process(input.data(), bufferSize, &distance, 1, pullOutputs);
+            cauto end = std::chrono::steady_clock::now();
+            if (b >= numWarmUpBuffers) {
+                scatterTime += std::chrono::duration<double, std::micro>(middle - start).count();
+                pullTime += std::chrono::duration<double, std::micro>(end - middle).count();
+            }
+            for (int n = 0; n < bufferSize; ++n)
+                finite = finite && std::isfinite(scatterOutput[n]) && std::isfinite(pullOutput[n]);
+        }
+        std::printf("%10g %16.2f %16.2f   %s\n", peakSpeed, scatterTime / (numBuffers - numWarmUpBuffers),
+                    pullTime / (numBuffers - numWarmUpBuffers), finite ? "" : "non-finite output!");
+    }
+    return 0;
+}
+
+#endif
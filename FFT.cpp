@@ -0,0 +1,97 @@
+//
+//  FFT.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "FFT.h"
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+FFT::FFT(const int order)
+    : size (1 << order),
+      twiddles (std::max(1, size - 1)),
+      inverseTwiddles (std::max(1, size - 1)),
+      bitReversed (size)
+{
+    for (int length = 2; length <= size; length <<= 1) {
+        for (int j = 0; j < length / 2; ++j) {
+            twiddles[length / 2 - 1 + j] = std::polar(1.0, -2 * M_PI * j / length);
+            inverseTwiddles[length / 2 - 1 + j] = std::conj(twiddles[length / 2 - 1 + j]);
+        }
+    }
+    for (int i = 0; i < size; ++i) {
+        int r = 0;
+        for (int b = 0; b < order; ++b)
+            r |= ((i >> b) & 1) << (order - 1 - b);
+        bitReversed[i] = r;
+    }
+}
+
+void FFT::perform(std::complex<float>* data, const bool inverse) const noexcept
+{
+    for (int i = 0; i < size; ++i)
+        if (i < bitReversed[i])
+            std::swap(data[i], data[bitReversed[i]]);
+    const std::complex<float>* const stageTwiddles = inverse ? inverseTwiddles.data() : twiddles.data();
+    for (int length = 2; length <= size; length <<= 1) {
+        const int half = length / 2;
+        const std::complex<float>* const w = stageTwiddles + half - 1;
+        for (int i = 0; i < size; i += length) {
+            std::complex<float>* const a = data + i;
+            std::complex<float>* const b = data + i + half;
+            int j = 0;
+#if SIMD_AVX
+            // 4 butterflies at a time on interleaved complex values
+            for (; j + 4 <= half; j += 4) {
+                float* const pa = reinterpret_cast<float*>(a + j);
+                float* const pb = reinterpret_cast<float*>(b + j);
+                const __m256 tw = _mm256_loadu_ps(reinterpret_cast<const float*>(w + j));
+                const __m256 x = _mm256_loadu_ps(pb);
+                const __m256 t = _mm256_mul_ps(_mm256_permute_ps(x, 0xb1), _mm256_movehdup_ps(tw));
+              #if SIMD_FMA
+                const __m256 v = _mm256_fmaddsub_ps(x, _mm256_moveldup_ps(tw), t);
+              #else
+                const __m256 v = _mm256_addsub_ps(_mm256_mul_ps(x, _mm256_moveldup_ps(tw)), t);
+              #endif
+                const __m256 u = _mm256_loadu_ps(pa);
+                _mm256_storeu_ps(pa, _mm256_add_ps(u, v));
+                _mm256_storeu_ps(pb, _mm256_sub_ps(u, v));
+            }
+#endif
+            for (; j < half; ++j) {
+                const auto x = b[j];
+                const auto u = a[j];
+                // written out since std::complex multiplication has to handle infs and nans
+                const std::complex<float> v (x.real() * w[j].real() - x.imag() * w[j].imag(), x.real() * w[j].imag() + x.imag() * w[j].real());
+                a[j] = u + v;
+                b[j] = u - v;
+            }
+        }
+    }
+    if (inverse) {
+        const float scale = 1.0f / size;
+        for (int i = 0; i < size; ++i)
+            data[i] *= scale;
+    }
+}
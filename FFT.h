@@ -0,0 +1,50 @@
+//
+//  FFT.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __FFT__
+#define __FFT__
+
+#include "SIMD.h"
+#include <complex>
+#include <vector>
+
+// plain iterative radix-2 complex fft, the tables are computed once at construction so perform() is realtime safe
+class FFT
+{
+public:
+    /** an fft of size 2^order */
+    explicit FFT(int order);
+    int getSize() const noexcept { return size; }
+    /** in place fft of getSize() values, the inverse is scaled by 1/getSize() */
+    void perform(std::complex<float>* data, bool inverse) const noexcept;
+private:
+    int size;
+    // twiddles for each stage laid out one after the other so the butterflies read them contiguously, e^(-2*pi*i*j/length) for
+    // j = 0 to length/2-1 at offset length/2-1 for the stage combining transforms of length/2, and their conjugates for the inverse
+    std::vector<std::complex<float>> twiddles, inverseTwiddles;
+    std::vector<int> bitReversed;
+};
+
+#endif /* defined(__FFT__) */
@@ -0,0 +1,101 @@
+//
+//  FFTConvolver.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+
+#include "FFTConvolver.h"
+#include <algorithm>
+
+// the fft needs to be at least 4 times the filter length to get through a decent chunk of output per transform
+static int getOrder(const int maxFilterLength) noexcept
+{
+    int order = 1;
+    while ((1 << order) < 4 * maxFilterLength)
+        ++order;
+    return order;
+}
+
+FFTConvolver::FFTConvolver(const int maxFilterLength)
+    : fft (getOrder(maxFilterLength)),
+      inputSpectrum (fft.getSize()),
+      outputPair (fft.getSize())
+{
+}
+
+void FFTConvolver::computeSpectrum(const float* h, const int Nh, const float hScale, std::complex<float>* spectrum) const noexcept
+{
+    const int M = fft.getSize();
+    for (int n = 0; n < Nh; ++n)
+        spectrum[n] = h[n] * hScale;
+    for (int n = Nh; n < M; ++n)
+        spectrum[n] = 0;
+    fft.perform(spectrum, false);
+}
+
+void FFTConvolver::process(const float* cBuf, const int cBufIdx, const int cBufN, const int Nh,
+                           const std::complex<float>* const* spectra, const int numSpectra,
+                           float* const* outputs, const int N) noexcept
+{
+    const int M = fft.getSize();
+    // output samples we get out of each transform, the first Nh-1 wrap around and are thrown away
+    const int chunkSize = M - Nh + 1;
+    for (int n0 = 0; n0 < N; n0 += chunkSize) {
+        const int L = std::min(chunkSize, N - n0);
+        // the inputs that overlap this chunk's outputs, zero padded
+        const float* const x = &cBuf[(cBufIdx + n0 - (Nh - 1) + cBufN) % cBufN];
+        for (int n = 0; n < L + Nh - 1; ++n)
+            inputSpectrum[n] = x[n];
+        for (int n = L + Nh - 1; n < M; ++n)
+            inputSpectrum[n] = 0;
+        fft.perform(inputSpectrum.data(), false);
+        // two real outputs per inverse transform, X*(A + iB) -> a + ib
+        for (int s = 0; s < numSpectra; s += 2) {
+            const std::complex<float>* const a = spectra[s];
+            if (s + 1 == numSpectra) { // the odd one out goes alone
+                for (int k = 0; k < M; ++k)
+                    outputPair[k] = inputSpectrum[k] * a[k];
+                fft.perform(outputPair.data(), true);
+                float* const outA = outputs[s] + n0;
+                for (int n = 0; n < L; ++n)
+                    outA[n] = outputPair[Nh - 1 + n].real();
+                break;
+            }
+            const std::complex<float>* const b = spectra[s + 1];
+            for (int k = 0; k < M; ++k) {
+                const float hr = a[k].real() - b[k].imag();
+                const float hi = a[k].imag() + b[k].real();
+                const float xr = inputSpectrum[k].real();
+                const float xi = inputSpectrum[k].imag();
+                outputPair[k] = {xr * hr - xi * hi, xr * hi + xi * hr};
+            }
+            fft.perform(outputPair.data(), true);
+            float* const outA = outputs[s] + n0;
+            float* const outB = outputs[s + 1] + n0;
+            for (int n = 0; n < L; ++n) {
+                outA[n] = outputPair[Nh - 1 + n].real();
+                outB[n] = outputPair[Nh - 1 + n].imag();
+            }
+        }
+    }
+}
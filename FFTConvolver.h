@@ -0,0 +1,56 @@
+//
+//  FFTConvolver.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+
+#ifndef __FFTConvolver__
+#define __FFTConvolver__
+
+#include "FFT.h"
+#include <complex>
+#include <vector>
+
+// overlap-save fft convolution of a circular input buffer with filters no longer than the fft's zero padding, each output chunk
+// only needs the filter's length-1 previous inputs so there is no added latency and any number of samples can be processed.
+// the input's spectrum is shared between all the filters and the outputs are inverse transformed two at a time since they are real
+class FFTConvolver
+{
+public:
+    /** a convolver for filters of up to maxFilterLength taps */
+    explicit FFTConvolver(int maxFilterLength);
+    /** the number of complex values in a filter's spectrum */
+    int getSpectrumSize() const noexcept { return fft.getSize(); }
+    /** compute the spectrum of the Nh tap filter h scaled by hScale, so it can be reused for as long as the filter stays the same */
+    void computeSpectrum(const float* h, int Nh, float hScale, std::complex<float>* spectrum) const noexcept;
+    /** convolve N samples of the mirrored circular input buffer (see convolve() in Functions.h) from cBufIdx, whose previous Nh-1 samples are the history, with any number of (Nh tap) filter spectra, one output each (an even number goes faster). N + Nh - 1 must not be more than cBufN */
+    void process(const float* cBuf, int cBufIdx, int cBufN, int Nh,
+                 const std::complex<float>* const* spectra, int numSpectra,
+                 float* const* outputs, int N) noexcept;
+private:
+    FFT fft;
+    std::vector<std::complex<float>> inputSpectrum;
+    std::vector<std::complex<float>> outputPair;
+};
+
+#endif /* defined(__FFTConvolver__) */
@@ -0,0 +1,74 @@
+//
+//  FractionalDelay.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+     
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+     
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+     
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+     
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "FractionalDelay.h"
+#include <algorithm>
+
+FractionalDelay::FractionalDelay(const int maxDelayInSamples)
+    : maxDelay (maxDelayInSamples)
+{
+    // need maxDelay+2 samples of history for the interpolation plus the current one
+    int size = 1;
+    while (size < maxDelayInSamples + 4)
+        size <<= 1;
+    buffer.resize(size, 0.0f);
+    mask = size - 1;
+}
+
+void FractionalDelay::process(const float* delays, const int stride, const int numDelays, const float* input, float* output, const int N) noexcept
+{
+    const float L = numDelays > 1 ? N / float(numDelays - 1) : 1;
+    for (int n = 0; n < N; ++n) {
+        buffer[writeIdx] = input[n];
+        float delay = delays[0];
+        if (numDelays > 1) {
+            const float ndL = n / L;
+            const int i = ndL;
+            const float blend = ndL - i;
+            delay = delays[i * stride] * (1 - blend) + delays[(i + 1) * stride] * blend;
+        }
+        // at least one sample of delay so the interpolation never needs a future sample
+        delay = std::max(1.0f, std::min(delay, maxDelay));
+        const int d = delay;
+        const float t = delay - d;
+        // x0 is delayed by d samples, xm1 by d-1, x1 by d+1, and x2 by d+2
+        const float xm1 = buffer[(writeIdx - d + 1) & mask];
+        const float x0  = buffer[(writeIdx - d    ) & mask];
+        const float x1  = buffer[(writeIdx - d - 1) & mask];
+        const float x2  = buffer[(writeIdx - d - 2) & mask];
+        const float tp1 = t + 1, tm1 = t - 1, tm2 = t - 2;
+        output[n] = - xm1 *   t * tm1 * tm2 * 0.1666666666666666667f
+                    + x0  * tp1 * tm1 * tm2 * 0.5f
+                    - x1  * tp1 *   t * tm2 * 0.5f
+                    + x2  * tp1 *   t * tm1 * 0.1666666666666666667f;
+        writeIdx = (writeIdx + 1) & mask;
+    }
+}
+
+void FractionalDelay::reset() noexcept
+{
+    std::fill(buffer.begin(), buffer.end(), 0.0f);
+    writeIdx = 0;
+}
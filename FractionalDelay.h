@@ -0,0 +1,49 @@
+//
+//  FractionalDelay.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+     
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+     
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+     
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+     
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __FractionalDelay__
+#define __FractionalDelay__
+
+#include <vector>
+
+// short delay line with a smoothly changing fractional delay (cubic lagrange interpolation), used to put back the onset delays that were split off of minimum phase hrirs
+class FractionalDelay
+{
+public:
+    /** a delay line that can delay by up to maxDelay samples */
+    explicit FractionalDelay(int maxDelay);
+    /** delay the input where the delay (in samples) moves linearly between numDelays delays spread evenly across the buffer (just like hrir blending), delays are read from delays[0], delays[stride], ... */
+    void process(const float* delays, int stride, int numDelays, const float* input, float* output, int N) noexcept;
+    /** reset the delay line state */
+    void reset() noexcept;
+private:
+    // circular buffer with a power of 2 size for cheap wrapping
+    std::vector<float> buffer;
+    int mask;
+    int writeIdx = 0;
+    float maxDelay;
+};
+
+#endif /* defined(__FractionalDelay__) */
@@ -32,6 +32,9 @@
 #include <vector>
 #include <cassert>
 #include "DrewLib.h"
+#include "Data.h"
+#include "SIMD.h"
+#include "StackArray.h"
 
 //inline float lagrangeInterpolate(const float y1, const float y2, const float y3, const float y4, const float x) noexcept
 //{
@@ -136,52 +139,158 @@ T boundsCheck(const T value, const T min, const T max)
     return std::max(std::min(value, max), min);
 }
 
-// circular input buffer convolution
+// dot product of an input window with an Nh tap (reversed) filter, specialized for the hrir lengths we use
+inline float dotTaps(const float *x, const float *hReversed, const int Nh) noexcept
+{
+	switch (Nh) {
+		case numTimeSteps:
+			return simd::dot<numTimeSteps>(x, hReversed);
+		case numTimeSteps / 2: // minimum phase hrirs
+			return simd::dot<numTimeSteps / 2>(x, hReversed);
+		default:
+			return simd::dot(x, hReversed, Nh);
+	}
+}
+
+// circular input buffer convolution, the buffer is mirrored (cBuf[i + cBufN] = cBuf[i]) so the Nh inputs
+// ending at any output sample are always contiguous and each output is one branch-free dot product
 inline void convolve(const float *cBuf, const int cBufIdx, const int cBufN,
 					 const float *h, const int Nh, const float hScale,
 					 float* output, const int N) noexcept
 {
+	STACK_ARRAY(float, hReversed, Nh)
+	for (int j = 0; j < Nh; ++j)
+		hReversed[j] = h[Nh - 1 - j];
 	// for each output sample
+	int i = cBufIdx % cBufN;
 	for (int n = 0; n < N; ++n) {
-		// for each overlaping sample of the two signals
-		float sum = 0;
-		int i = (cBufIdx + n) % cBufN;
-		for (int j = 0; j < Nh; ++j) {
-			sum += cBuf[i] * h[j];
-			if (--i < 0)
-				i = cBufN - 1;
-		}
-		output[n] = sum * hScale;
+		output[n] = dotTaps(&cBuf[i + cBufN - (Nh - 1)], hReversed, Nh) * hScale;
+		if (++i == cBufN)
+			i = 0;
 	}
 }
 
 inline void convolve(const float *cBuf, const int cBufIdx, const int cBufN,
-					 const float *hs, const int Nh, const int numHs, const float *hScales, const int ch, 
+					 const float *hs, const int Nh, const int hStride, const int numHs, const float *hScales, const int ch,
 					 float *output, const int N) noexcept
 {
+	// the two filters being blended get reversed once they come up, the second one of each pair is the first one of the next pair
+	STACK_ARRAY(float, hReversed, 2 * Nh)
+	float *h1 = &hReversed[0], *h2 = &hReversed[Nh];
+	const auto reverse = [&] (const int hIdx, float *hRev)
+	{
+		const float *h = &hs[hIdx * hStride];
+		for (int j = 0; j < Nh; ++j)
+			hRev[j] = h[Nh - 1 - j];
+	};
+	int prevHi = -1;
+	const float L = N / float(numHs - 1);
+	int i = cBufIdx % cBufN;
 	// for each output sample
 	for (int n = 0; n < N; ++n) {
-		const float L = N / float(numHs - 1);
 		const float ndL = n / L;
 		const int hi = ndL;
 		const int hIdx1 = 2 * hi + ch;
 		const int hIdx2 = 2 * (hi + 1) + ch;
-		const float *h1 = &hs[hIdx1 * Nh],
-			        *h2 = &hs[hIdx2 * Nh];
-		int i = (cBufIdx + n) % cBufN;
-		float sum1 = 0, sum2 = 0;
-		// for each overlaping sample of the two signals
-		for (int j = 0; j < Nh; ++j) {
-			sum1 += cBuf[i] * h1[j];
-			sum2 += cBuf[i] * h2[j];
-			if (--i < 0)
-				i = cBufN - 1;
+		if (hi != prevHi) {
+			if (hi == prevHi + 1 && prevHi >= 0) {
+				std::swap(h1, h2);
+			} else {
+				reverse(hIdx1, h1);
+			}
+			reverse(hIdx2, h2);
+			prevHi = hi;
 		}
+		const float *x = &cBuf[i + cBufN - (Nh - 1)];
+		const float sum1 = dotTaps(x, h1, Nh);
+		const float sum2 = dotTaps(x, h2, Nh);
+		if (++i == cBufN)
+			i = 0;
 		const float hBlend = ndL - hi; //std::fmod(n, L);
 		output[n] = sum1 * hScales[hIdx1] * (1-hBlend) + sum2 * hScales[hIdx2] * hBlend;
 	}
 }
 
+// dot products of an input window with numHs Nh tap (reversed) filters at once, specialized for the hrir lengths we use
+template <int numHs>
+inline void dotsTaps(const float *x, const float *const *hsReversed, const int Nh, float *sums) noexcept
+{
+	switch (Nh) {
+		case numTimeSteps:
+			simd::dots<numTimeSteps, numHs>(x, hsReversed, sums);
+			break;
+		case numTimeSteps / 2: // minimum phase hrirs
+			simd::dots<numTimeSteps / 2, numHs>(x, hsReversed, sums);
+			break;
+		default:
+			simd::dots<numHs>(x, hsReversed, Nh, sums);
+	}
+}
+
+// stereo version of the circular input buffer convolution, both ears' filters are applied in the same pass over the (mirrored) input buffer
+inline void convolveStereo(const float *cBuf, const int cBufIdx, const int cBufN,
+						   const float *hL, const float *hR, const int Nh, const float hScaleL, const float hScaleR,
+						   float *outputL, float *outputR, const int N) noexcept
+{
+	STACK_ARRAY(float, hReversed, 2 * Nh)
+	for (int j = 0; j < Nh; ++j) {
+		hReversed[     j] = hL[Nh - 1 - j];
+		hReversed[Nh + j] = hR[Nh - 1 - j];
+	}
+	const float *hs[2] {&hReversed[0], &hReversed[Nh]};
+	int i = cBufIdx % cBufN;
+	// for each output sample
+	for (int n = 0; n < N; ++n) {
+		float sums[2];
+		dotsTaps<2>(&cBuf[i + cBufN - (Nh - 1)], hs, Nh, sums);
+		outputL[n] = sums[0] * hScaleL;
+		outputR[n] = sums[1] * hScaleR;
+		if (++i == cBufN)
+			i = 0;
+	}
+}
+
+// stereo version of the blending convolution, each input window is loaded once for the two blended filters of both ears
+inline void convolveStereo(const float *cBuf, const int cBufIdx, const int cBufN,
+						   const float *hs, const int Nh, const int hStride, const int numHs, const float *hScales,
+						   float *outputL, float *outputR, const int N) noexcept
+{
+	// [0] = ch 0 filter 1, [1] = ch 0 filter 2, [2] = ch 1 filter 1, [3] = ch 1 filter 2, the second filter of each pair is the first one of the next pair
+	STACK_ARRAY(float, hReversed, 4 * Nh)
+	float *hsReversed[4] {&hReversed[0], &hReversed[Nh], &hReversed[2 * Nh], &hReversed[3 * Nh]};
+	const auto reverse = [&] (const int hIdx, float *hRev)
+	{
+		const float *h = &hs[hIdx * hStride];
+		for (int j = 0; j < Nh; ++j)
+			hRev[j] = h[Nh - 1 - j];
+	};
+	int prevHi = -1;
+	const float L = N / float(numHs - 1);
+	int i = cBufIdx % cBufN;
+	// for each output sample
+	for (int n = 0; n < N; ++n) {
+		const float ndL = n / L;
+		const int hi = ndL;
+		if (hi != prevHi) {
+			for (int ch = 0; ch < 2; ++ch) {
+				if (hi == prevHi + 1 && prevHi >= 0)
+					std::swap(hsReversed[2 * ch], hsReversed[2 * ch + 1]);
+				else
+					reverse(2 * hi + ch, hsReversed[2 * ch]);
+				reverse(2 * (hi + 1) + ch, hsReversed[2 * ch + 1]);
+			}
+			prevHi = hi;
+		}
+		float sums[4];
+		dotsTaps<4>(&cBuf[i + cBufN - (Nh - 1)], hsReversed, Nh, sums);
+		if (++i == cBufN)
+			i = 0;
+		const float hBlend = ndL - hi;
+		outputL[n] = sums[0] * hScales[2 *  hi      ] * (1-hBlend) + sums[1] * hScales[2 * (hi + 1)    ] * hBlend;
+		outputR[n] = sums[2] * hScales[2 *  hi  + 1 ] * (1-hBlend) + sums[3] * hScales[2 * (hi + 1) + 1] * hBlend;
+	}
+}
+
 // time domain convolution
 /*static*/
 inline void convolve(const float *x, int Nx, const float *h, int Nh, float *output) noexcept
@@ -0,0 +1,200 @@
+//
+//  HRIRBaker.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "HRIRBaker.h"
+#include "Functions.h"
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+constexpr float HRIRBaker::controlRate;
+constexpr int HRIRBaker::maxNumPositions;
+constexpr float HRIRBaker::maxPositionError;
+constexpr int HRIRBaker::bakeInterval;
+
+HRIRBaker::HRIRBaker(const int numSources, std::function<bool(Job&)> getJob)
+    : getJob (std::move(getJob)),
+      trajectories (numSources)
+{
+    thread = std::thread([this] { run(); });
+}
+
+HRIRBaker::~HRIRBaker()
+{
+    {
+        const std::lock_guard<std::mutex> lock (wakeLock);
+        shouldExit = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+bool HRIRBaker::getHRIR(const int sourceIndex, const float posSec, const float* rae, const HRIRData* hrirData, const HRIRInterpolationQuality quality,
+                        float* hrir, float* delays, float* scaling) const noexcept
+{
+    if (sourceIndex < 0 || sourceIndex >= (int)trajectories.size())
+        return false;
+    const std::unique_lock<Mutex> lock (trajectories[sourceIndex].getLock(), std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+    const Trajectory* const t = trajectories[sourceIndex].getResource().get();
+    if (!t || t->hrirData != hrirData || t->quality != quality)
+        return false;
+    int k = (int)std::lround((posSec - t->begin) * t->rate);
+    if (k < 0 || k > t->numPositions)
+        return false;
+    if (k == t->numPositions) // the end of the loop region is its beginning
+        k = 0;
+    // the source may not be where it was when this was baked (if its path was just changed, or it isn't on its path at all)
+    float xyz[3];
+    RAEtoXYZ(rae, xyz);
+    const float* const bakedXYZ = &t->xyzs[3*k];
+    const float dx = xyz[0] - bakedXYZ[0], dy = xyz[1] - bakedXYZ[1], dz = xyz[2] - bakedXYZ[2];
+    if (!(dx*dx + dy*dy + dz*dz <= maxPositionError*maxPositionError)) // nan for muted positions
+        return false;
+    const int length = hrirData->getLength();
+    std::copy_n(&t->hrirs[k*2*maxNumTimeSteps],                length, hrir);
+    std::copy_n(&t->hrirs[k*2*maxNumTimeSteps + maxNumTimeSteps], length, hrir + maxNumTimeSteps);
+    scaling[0] = t->scaling[2*k];
+    scaling[1] = t->scaling[2*k+1];
+    if (delays && hrirData->hasDelays()) {
+        delays[0] = t->delays[2*k];
+        delays[1] = t->delays[2*k+1];
+    }
+    return true;
+}
+
+std::size_t HRIRBaker::getMemorySize() const noexcept
+{
+    return memorySize;
+}
+
+void HRIRBaker::run()
+{
+    Job job;
+    while (!shouldExit) {
+        if (getJob(job))
+            bake(job);
+        else
+            for (int s = 0; s < (int)trajectories.size(); ++s)
+                publish(s, nullptr);
+        std::unique_lock<std::mutex> lock (wakeLock);
+        wake.wait_for(lock, std::chrono::milliseconds(bakeInterval), [this] { return shouldExit.load(); });
+    }
+}
+
+void HRIRBaker::bake(Job& job)
+{
+    if (job.hrirData != interpolatorHRIRData) {
+        interpolator.setHRIRData(job.hrirData);
+        interpolatorHRIRData = job.hrirData;
+    }
+    interpolator.setInterpolationQuality(job.quality);
+    interpolator.setHRIRSphericalHarmonics(job.sphericalHarmonics);
+    const float loopLength = job.loopRegionEnd - job.loopRegionBegin;
+    const int numPositions = std::max(1, std::min(maxNumPositions, (int)std::ceil(loopLength * controlRate)));
+    const float rate = numPositions / loopLength;
+    std::vector<float> raes (3*numPositions), xyzs (3*numPositions);
+    std::vector<bool> changed (numPositions);
+    for (int s = 0; s < (int)trajectories.size() && !shouldExit; ++s) {
+        // only the sources moving on their paths by their path automation (and not by the host's automation) can be baked
+        if (s >= (int)job.sources.size() || job.sources[s].getNumPathPoints() < 2 || job.sources[s].getNumPathAutomationPoints() == 0) {
+            publish(s, nullptr);
+            continue;
+        }
+        // where the source is at each position, sampled the same way processBlock() moves it
+        SoundSource& source = job.sources[s];
+        int prevPathPosIndex = 0;
+        for (int k = 0; k < numPositions; ++k) {
+            float* const rae = &raes[3*k];
+            float* const xyz = &xyzs[3*k];
+            if (source.setParametricPosition(job.loopRegionBegin + k / rate, prevPathPosIndex) && !source.getSourceMuted()) {
+                const auto posRAE = source.getPosRAE();
+                std::copy(posRAE.begin(), posRAE.end(), rae);
+                RAEtoXYZ(rae, xyz);
+            } else {
+                std::fill_n(xyz, 3, std::numeric_limits<float>::quiet_NaN());
+            }
+        }
+        // only the hrirs at positions that moved need interpolating again, unless the whole thing has to be redone
+        const Trajectory* const old = trajectories[s].getResource().get(); // only this thread changes it
+        const bool reuse = old && old->numPositions == numPositions && old->begin == job.loopRegionBegin && old->rate == rate
+                        && old->hrirData == job.hrirData && old->quality == job.quality && old->sphericalHarmonics == job.sphericalHarmonics;
+        bool anyChanged = false;
+        for (int k = 0; k < numPositions; ++k) {
+            changed[k] = !reuse || std::memcmp(&xyzs[3*k], &old->xyzs[3*k], 3*sizeof(float)) != 0;
+            anyChanged |= changed[k];
+        }
+        if (!anyChanged)
+            continue;
+        std::unique_ptr<Trajectory> t;
+        if (reuse) {
+            t.reset(new Trajectory(*old));
+        } else {
+            t.reset(new Trajectory());
+            t->begin = job.loopRegionBegin;
+            t->rate = rate;
+            t->numPositions = numPositions;
+            t->hrirData = job.hrirData;
+            t->quality = job.quality;
+            t->sphericalHarmonics = job.sphericalHarmonics;
+            t->hrirs.resize(numPositions*2*maxNumTimeSteps);
+            t->delays.resize(2*numPositions);
+            t->scaling.resize(2*numPositions);
+        }
+        t->xyzs = xyzs;
+        // interpolate each run of changed (unmuted) positions in one go
+        for (int k = 0; k < numPositions;) {
+            if (!changed[k] || xyzs[3*k] != xyzs[3*k]) {
+                ++k;
+                continue;
+            }
+            int end = k + 1;
+            while (end < numPositions && changed[end] && xyzs[3*end] == xyzs[3*end])
+                ++end;
+            interpolator.interpolateHRIRs(&raes[3*k], end - k, &t->hrirs[k*2*maxNumTimeSteps], &t->delays[2*k], &t->scaling[2*k]);
+            k = end;
+        }
+        publish(s, std::move(t));
+    }
+}
+
+void HRIRBaker::publish(const int sourceIndex, std::unique_ptr<Trajectory> trajectory)
+{
+    auto& slot = trajectories[sourceIndex];
+    if (!trajectory && !slot.getResource())
+        return;
+    const auto sizeOf = [] (const Trajectory* t) -> std::size_t
+    {
+        return t ? (t->xyzs.size() + t->hrirs.size() + t->delays.size() + t->scaling.size()) * sizeof(float) : 0;
+    };
+    memorySize += sizeOf(trajectory.get());
+    {
+        const std::lock_guard<Mutex> lock (slot.getLock());
+        std::swap(slot.getResource(), trajectory);
+    }
+    memorySize -= sizeOf(trajectory.get());
+    // the old trajectory is freed here, outside of the lock
+}
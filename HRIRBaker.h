@@ -0,0 +1,105 @@
+//
+//  HRIRBaker.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __HRIRBaker__
+#define __HRIRBaker__
+
+#include "SoundSource.h"
+#include "ConcurrentResource.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// when looping, a source moving on its path (driven by its path automation) goes through the same hrirs every time around the loop region, so a background
+// thread interpolates them ahead of time at a fixed control rate over the loop region for each source and the audio thread just copies out the nearest one.
+// the baking thread wakes up every so often and samples each source's path again, only the hrirs at positions that changed since the last bake get interpolated
+// again. a baked hrir is only handed out if its position is close to where the source actually is, so until a (re)bake is done the audio thread just
+// interpolates the hrirs itself like usual.
+class HRIRBaker
+{
+public:
+    // what there is to bake, sources is a private copy the baker is free to move around
+    struct Job
+    {
+        std::vector<SoundSource> sources;
+        float loopRegionBegin = 0;
+        float loopRegionEnd = 0;
+        const HRIRData* hrirData = nullptr;
+        HRIRInterpolationQuality quality = HRIRInterpolationQuality::FULL;
+        const HRIRSphericalHarmonics* sphericalHarmonics = nullptr;
+    };
+    // hrirs are baked at this many positions per second of the loop region, less for long loop regions to keep the memory bounded
+    static constexpr float controlRate = 200;
+    static constexpr int maxNumPositions = 4096;
+    // a baked hrir is used only if its position is within this distance (in meters) of the source's actual position
+    static constexpr float maxPositionError = 0.03f;
+    // how long the baking thread sleeps between bakes, in milliseconds
+    static constexpr int bakeInterval = 250;
+
+    /** starts the baking thread for up to numSources sources, which calls getJob() (on itself) before each bake to see what to bake. getJob() returns false
+        if baking is off or there is nothing to bake, and then the baked hrirs are thrown out */
+    HRIRBaker(int numSources, std::function<bool(Job&)> getJob);
+    ~HRIRBaker();
+    HRIRBaker(const HRIRBaker&) = delete;
+    HRIRBaker& operator=(const HRIRBaker&) = delete;
+    /** for the audio thread, copies out the hrir pair (at strides of maxNumTimeSteps like interpolateHRIR()), onset delays, and scaling baked for sourceIndex at
+        posSec into the loop region, returns false (without blocking) if there isn't one baked with the same hrir data and quality close to rae */
+    bool getHRIR(int sourceIndex, float posSec, const float* rae, const HRIRData* hrirData, HRIRInterpolationQuality quality,
+                 float* hrir, float* delays, float* scaling) const noexcept;
+    /** bytes taken up by all the baked hrirs */
+    std::size_t getMemorySize() const noexcept;
+
+private:
+    struct Trajectory
+    {
+        float begin = 0;
+        float rate = 0;
+        int numPositions = 0;
+        const HRIRData* hrirData = nullptr;
+        HRIRInterpolationQuality quality = HRIRInterpolationQuality::FULL;
+        const HRIRSphericalHarmonics* sphericalHarmonics = nullptr;
+        std::vector<float> xyzs; // nan for positions where the source is muted
+        std::vector<float> hrirs, delays, scaling; // laid out like interpolateHRIRs()
+    };
+    void run();
+    void bake(Job& job);
+    void publish(int sourceIndex, std::unique_ptr<Trajectory> trajectory);
+    std::function<bool(Job&)> getJob;
+    // the audio thread only try locks these, the baking thread locks one just long enough to swap in a new trajectory
+    std::vector<Lockable<std::unique_ptr<Trajectory>>> trajectories;
+    std::atomic<std::size_t> memorySize {0};
+    // does the interpolating
+    PlayableSoundSource interpolator;
+    const HRIRData* interpolatorHRIRData = nullptr;
+    std::atomic<bool> shouldExit {false};
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::thread thread;
+};
+
+#endif /* defined(__HRIRBaker__) */
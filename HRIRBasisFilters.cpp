@@ -0,0 +1,221 @@
+//
+//  HRIRBasisFilters.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "HRIRBasisFilters.h"
+#include "Functions.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+
+constexpr int HRIRBasisFilters::maxNumFilters;
+constexpr int HRIRBasisFilters::defaultNumFilters;
+
+HRIRBasisFilters::HRIRBasisFilters(std::shared_ptr<HRIRData> data, const int numFilters)
+    : data (std::move(data)),
+      numFilters ((std::max(4, std::min(numFilters, maxNumFilters)) + 3) / 4 * 4)
+{
+    finder = std::thread([this] { findFilters(); });
+}
+
+HRIRBasisFilters::~HRIRBasisFilters()
+{
+    shouldExit = true;
+    if (finder.joinable())
+        finder.join();
+}
+
+std::shared_ptr<HRIRBasisFilters> HRIRBasisFilters::getShared(std::shared_ptr<HRIRData> data, const int numFilters)
+{
+    // one set of filters per hrir data set and number of filters, which only lives as long as someone holds a reference to it
+    static std::mutex lock;
+    static std::vector<std::weak_ptr<HRIRBasisFilters>> shared;
+    const std::lock_guard<std::mutex> guard (lock);
+    shared.erase(std::remove_if(shared.begin(), shared.end(), [] (const std::weak_ptr<HRIRBasisFilters>& p) { return p.expired(); }), shared.end());
+    for (const auto& p : shared) {
+        auto basis = p.lock();
+        if (basis && basis->getHRIRData() == data.get() && basis->getNumFilters() == (std::max(4, std::min(numFilters, maxNumFilters)) + 3) / 4 * 4)
+            return basis;
+    }
+    auto basis = std::make_shared<HRIRBasisFilters>(std::move(data), numFilters);
+    shared.push_back(basis);
+    return basis;
+}
+
+void HRIRBasisFilters::project(const float* hrir, const float scale, float* weights) const noexcept
+{
+    for (int k = 0; k < numFilters; ++k)
+        weights[k] = scale * simd::dot(hrir, &filters[k * length], length);
+}
+
+void HRIRBasisFilters::findFilters()
+{
+    while (!data->isReady()) {
+        if (shouldExit)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    length = data->getLength();
+
+    // every stored direction weighted by the patch of sphere around it (like HRIRSphericalHarmonics' fit), the azimuths off of the median plane also stand in
+    // for their mirror images on the other side of the head
+    std::vector<std::pair<int, float>> directions; // direction index, weight
+    const double dTheta = M_PI / numElevationSteps, dPhi = 2 * M_PI / numAzimuthSteps;
+    for (int a = 0; a < HRIRData::numAzimuths; ++a)
+        for (int e = 1; e < numElevationSteps; ++e)
+            directions.emplace_back(a * HRIRData::numElevations + e - 1, float(std::sin(e * dTheta) * dTheta * dPhi * (a == 0 || a == HRIRData::numAzimuths - 1 ? 1 : 2)));
+    const double capArea = 2 * M_PI * (1 - std::cos(dTheta / 2));
+    directions.emplace_back(HRIRData::numDirections - 2, float(capArea));
+    directions.emplace_back(HRIRData::numDirections - 1, float(capArea));
+
+    // the correlation matrix of all the (weighted) hrirs of both ears at every distance, a row at a time done by HRIRData::weightedSum() over blocks of
+    // hrirs small enough to stay in cache while all the rows are worked out from them
+    constexpr int blockSize = 64;
+    const HRIRData::Sample* block[blockSize];
+    std::vector<float> weightedTaps (length * blockSize); // [tap][hrir]
+    std::vector<float> partial (length);
+    std::vector<double> correlation (length * length, 0.0);
+    for (int d = 0; d < numDistanceSteps; ++d) {
+        for (int begin = 0; begin < (int)directions.size(); begin += blockSize / 2) {
+            if (shouldExit)
+                return;
+            const int size = 2 * std::min(blockSize / 2, (int)directions.size() - begin);
+            for (int i = 0; i < size; ++i) {
+                const auto& direction = directions[begin + i / 2];
+                block[i] = data->getHRIR(d, direction.first) + (i & 1) * length;
+                for (int t = 0; t < length; ++t)
+                    weightedTaps[t * blockSize + i] = direction.second * simd::toFloat(block[i][t]);
+            }
+            for (int t = 0; t < length; ++t) {
+                HRIRData::weightedSum(block, &weightedTaps[t * blockSize], size, length, &partial[0]);
+                for (int u = 0; u < length; ++u)
+                    correlation[t * length + u] += partial[u];
+            }
+        }
+    }
+
+    // its eigenvectors with the largest eigenvalues are the principal components, found by cyclic jacobi rotations
+    std::vector<double> a (correlation), v (length * length, 0.0);
+    for (int i = 0; i < length; ++i)
+        v[i * length + i] = 1;
+    double trace = 0;
+    for (int i = 0; i < length; ++i)
+        trace += a[i * length + i];
+    for (int sweep = 0; sweep < 50; ++sweep) {
+        double offDiagonal = 0;
+        for (int p = 0; p < length; ++p)
+            for (int q = p + 1; q < length; ++q)
+                offDiagonal += a[p * length + q] * a[p * length + q];
+        if (offDiagonal <= 1e-24 * trace * trace)
+            break;
+        for (int p = 0; p < length; ++p) {
+            for (int q = p + 1; q < length; ++q) {
+                const double apq = a[p * length + q];
+                if (std::abs(apq) <= 1e-300)
+                    continue;
+                const double theta = (a[q * length + q] - a[p * length + p]) / (2 * apq);
+                const double t = (theta >= 0 ? 1 : -1) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                const double c = 1 / std::sqrt(t * t + 1), s = t * c;
+                for (int k = 0; k < length; ++k) {
+                    const double akp = a[k * length + p], akq = a[k * length + q];
+                    a[k * length + p] = c * akp - s * akq;
+                    a[k * length + q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < length; ++k) {
+                    const double apk = a[p * length + k], aqk = a[q * length + k];
+                    a[p * length + k] = c * apk - s * aqk;
+                    a[q * length + k] = s * apk + c * aqk;
+                    const double vkp = v[k * length + p], vkq = v[k * length + q];
+                    v[k * length + p] = c * vkp - s * vkq;
+                    v[k * length + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    std::vector<int> order (length);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&] (const int i, const int j) { return a[i * length + i] > a[j * length + j]; });
+
+    const int numUsed = std::min(numFilters, length); // any filters past the hrir length stay silent
+    filters.assign(numFilters * length, 0.0f);
+    reversedFilters.assign(numFilters * length, 0.0f);
+    double captured = 0;
+    for (int k = 0; k < numUsed; ++k) {
+        captured += a[order[k] * length + order[k]];
+        for (int t = 0; t < length; ++t) {
+            filters[k * length + t] = (float)v[t * length + order[k]];
+            reversedFilters[k * length + length - 1 - t] = filters[k * length + t];
+        }
+    }
+    capturedEnergy = trace > 0 ? float(captured / trace) : 1;
+    ready.store(true, std::memory_order_release);
+}
+
+void HRIRBasisConvolver::allocate(const int maxBlockSize)
+{
+    inputBufferSize = maxBlockSize + maxNumTimeSteps;
+    inputBuffer.assign(2 * inputBufferSize, 0.0f);
+    inputBufferInPos = 0;
+    outputs.assign(HRIRBasisFilters::maxNumFilters * maxBlockSize, 0.0f);
+}
+
+void HRIRBasisConvolver::reset() noexcept
+{
+    std::fill(inputBuffer.begin(), inputBuffer.end(), 0.0f);
+    inputBufferInPos = 0;
+}
+
+void HRIRBasisConvolver::write(const float* in, const int N) noexcept
+{
+    for (int n = 0; n < N; ++n) {
+        inputBuffer[inputBufferInPos] = inputBuffer[inputBufferInPos + inputBufferSize] = in[n];
+        if (++inputBufferInPos == inputBufferSize)
+            inputBufferInPos = 0;
+    }
+}
+
+const float* HRIRBasisConvolver::convolve(const HRIRBasisFilters& basis, const int N) noexcept
+{
+    const int numFilters = basis.getNumFilters();
+    const int Nh = basis.getLength();
+    const float* hsReversed[HRIRBasisFilters::maxNumFilters];
+    for (int k = 0; k < numFilters; ++k)
+        hsReversed[k] = basis.getReversedFilter(k);
+    // each input window is loaded once for 4 filters at a time
+    int i = (inputBufferInPos - N + inputBufferSize) % inputBufferSize;
+    for (int n = 0; n < N; ++n) {
+        const float* const x = &inputBuffer[i + inputBufferSize - (Nh - 1)];
+        for (int k = 0; k < numFilters; k += 4) {
+            float sums[4];
+            dotsTaps<4>(x, &hsReversed[k], Nh, sums);
+            for (int j = 0; j < 4; ++j)
+                outputs[n * numFilters + k + j] = sums[j];
+        }
+        if (++i == inputBufferSize)
+            i = 0;
+    }
+    return &outputs[0];
+}
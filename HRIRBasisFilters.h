@@ -0,0 +1,102 @@
+//
+//  HRIRBasisFilters.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __HRIRBasisFilters__
+#define __HRIRBasisFilters__
+
+#include "HRIRData.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// the principal components of all the hrirs in an hrir data set (both ears, every direction and distance), the orthonormal filters that best approximate
+// them in the least squares sense. every source plays the same input, so instead of convolving it with each source's own hrirs the input can be convolved
+// with the basis filters once (see HRIRBasisConvolver) and each source just mixes those outputs with its hrirs' weights on the filters, which costs about
+// as much as a gain per filter. working out the components takes a second or so, so it is done on a background thread.
+class HRIRBasisFilters
+{
+public:
+    // the number of filters is rounded up to a multiple of 4 (the convolver does 4 at a time)
+    static constexpr int maxNumFilters = 64;
+    static constexpr int defaultNumFilters = 16;
+
+    /** starts finding the numFilters principal components of the hrir data (once it is ready) on a background thread, isReady() becomes true once it is done */
+    HRIRBasisFilters(std::shared_ptr<HRIRData> data, int numFilters);
+    ~HRIRBasisFilters();
+    HRIRBasisFilters(const HRIRBasisFilters&) = delete;
+    HRIRBasisFilters& operator=(const HRIRBasisFilters&) = delete;
+    /** get the basis filters of an hrir data set shared by all plugin instances, the first call (or the first after all previous references were released) starts finding them */
+    static std::shared_ptr<HRIRBasisFilters> getShared(std::shared_ptr<HRIRData> data, int numFilters = defaultNumFilters);
+    /** true once the filters are ready to be used from any thread */
+    bool isReady() const noexcept { return ready.load(std::memory_order_acquire); }
+    /** the hrir data the filters were found for */
+    const HRIRData* getHRIRData() const noexcept { return data.get(); }
+    int getNumFilters() const noexcept { return numFilters; }
+    /** number of taps in each filter, the same as the hrir data's */
+    int getLength() const noexcept { return length; }
+    /** fraction of the hrir data's energy the filters capture (once ready) */
+    float getCapturedEnergy() const noexcept { return capturedEnergy; }
+    /** filter k, time reversed for the convolution */
+    const float* getReversedFilter(const int k) const noexcept { return &reversedFilters[k * length]; }
+    /** weights[k] = scale * the dot product of an hrir (getLength() taps) with filter k, the filters weighted by these are the hrir's best approximation */
+    void project(const float* hrir, float scale, float* weights) const noexcept;
+
+private:
+    void findFilters();
+    std::shared_ptr<HRIRData> data;
+    const int numFilters;
+    int length = 0;
+    // [filter][tap], and each one time reversed
+    std::vector<float> filters, reversedFilters;
+    float capturedEnergy = 0;
+    std::atomic<bool> ready {false};
+    std::atomic<bool> shouldExit {false};
+    std::thread finder;
+};
+
+// convolves the input with each of an HRIRBasisFilters' filters, once per block for all the sources
+class HRIRBasisConvolver
+{
+public:
+    /** allocate for blocks of up to maxBlockSize samples, not realtime safe */
+    void allocate(int maxBlockSize);
+    /** forget the input history */
+    void reset() noexcept;
+    /** add a block of input to the history, done for every block so the history is there whenever the basis filters get used */
+    void write(const float* in, int N) noexcept;
+    /** convolve the last N samples written with each of the basis filters, returns the outputs of all the filters for sample n at [n*getNumFilters()] until
+        the next call (so mixing them for a sample is one dot product) */
+    const float* convolve(const HRIRBasisFilters& basis, int N) noexcept;
+
+private:
+    // circular buffer of the inputs, mirrored into its second half so the taps for any output are contiguous (like PlayableSoundSource's)
+    std::vector<float> inputBuffer;
+    int inputBufferSize = 0;
+    int inputBufferInPos = 0;
+    std::vector<float> outputs;
+};
+
+#endif /* defined(__HRIRBasisFilters__) */
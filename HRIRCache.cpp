@@ -0,0 +1,148 @@
+//
+//  HRIRCache.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+     
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+     
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+     
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+     
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "HRIRCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+HRIRCache::HRIRCache(const int capacity)
+    : radiusStep (Quantization().radius),
+      angleStep (Quantization().angle)
+{
+    setBits = 1;
+    while ((numWays << setBits) < capacity)
+        ++setBits;
+    numSets = 1 << setBits;
+    slots.reset(new Slot[numSets * numWays]);
+    entries.resize(std::size_t(numSets) * numWays * entrySize, 0.0f);
+}
+
+std::uint64_t HRIRCache::quantize(const float* rae, float* quantizedRAE) const noexcept
+{
+    const float rStep = radiusStep.load(std::memory_order_relaxed);
+    const float aStep = angleStep.load(std::memory_order_relaxed);
+    // 21 bits for each coordinate
+    constexpr std::int64_t mask = (1 << 21) - 1;
+    const std::int64_t numAzimuths = std::max<std::int64_t>(1, std::llround(2 * M_PI / aStep));
+    const std::int64_t r = std::min(mask, std::max<std::int64_t>(1, std::llround(rae[0] / rStep)));
+    const std::int64_t a = ((std::llround(rae[1] / aStep) % numAzimuths) + numAzimuths) % numAzimuths;
+    const std::int64_t e = std::min(mask, std::max<std::int64_t>(0, std::llround(rae[2] / aStep)));
+    quantizedRAE[0] = r * rStep;
+    quantizedRAE[1] = a * (float)(2 * M_PI / numAzimuths);
+    quantizedRAE[2] = std::min((float)M_PI, e * aStep);
+    return std::uint64_t(r << 42 | (a & mask) << 21 | e);
+}
+
+bool HRIRCache::find(const std::uint64_t key, const int length, float* hrir, float* delays, float* scaling) noexcept
+{
+    const std::uint32_t currentGeneration = generation.load(std::memory_order_acquire);
+    const int set = (int)((key * 0x9e3779b97f4a7c15ull) >> (64 - setBits)) & (numSets - 1);
+    for (int way = 0; way < numWays; ++way) {
+        Slot& slot = slots[set * numWays + way];
+        const std::uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) || slot.key.load(std::memory_order_relaxed) != key || slot.generation.load(std::memory_order_relaxed) != currentGeneration)
+            continue;
+        const float* const entry = &entries[std::size_t(set * numWays + way) * entrySize];
+        std::memcpy(hrir, entry, length * sizeof(float));
+        std::memcpy(hrir + maxNumTimeSteps, entry + maxNumTimeSteps, length * sizeof(float));
+        std::memcpy(scaling, entry + 2 * maxNumTimeSteps, 2 * sizeof(float));
+        if (delays)
+            std::memcpy(delays, entry + 2 * maxNumTimeSteps + 2, 2 * sizeof(float));
+        // if a writer got in while we were copying then what we copied may be torn, just call it a miss
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+            break;
+        slot.lastUsed.store(clock.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void HRIRCache::insert(const std::uint64_t key, const int length, const float* hrir, const float* delays, const float* scaling) noexcept
+{
+    const std::uint32_t currentGeneration = generation.load(std::memory_order_acquire);
+    const int set = (int)((key * 0x9e3779b97f4a7c15ull) >> (64 - setBits)) & (numSets - 1);
+    // replace an empty (old generation) slot, otherwise the least recently used one
+    const std::uint32_t now = clock.load(std::memory_order_relaxed);
+    int victim = 0;
+    std::uint32_t oldest = 0;
+    for (int way = 0; way < numWays; ++way) {
+        const Slot& slot = slots[set * numWays + way];
+        if (slot.generation.load(std::memory_order_relaxed) != currentGeneration) {
+            victim = way;
+            break;
+        }
+        const std::uint32_t age = now - slot.lastUsed.load(std::memory_order_relaxed);
+        if (age >= oldest) {
+            oldest = age;
+            victim = way;
+        }
+    }
+    Slot& slot = slots[set * numWays + victim];
+    std::uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) || !slot.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+        return;
+    std::atomic_thread_fence(std::memory_order_release);
+    float* const entry = &entries[std::size_t(set * numWays + victim) * entrySize];
+    std::memcpy(entry, hrir, length * sizeof(float));
+    std::memcpy(entry + maxNumTimeSteps, hrir + maxNumTimeSteps, length * sizeof(float));
+    std::memcpy(entry + 2 * maxNumTimeSteps, scaling, 2 * sizeof(float));
+    if (delays)
+        std::memcpy(entry + 2 * maxNumTimeSteps + 2, delays, 2 * sizeof(float));
+    slot.key.store(key, std::memory_order_relaxed);
+    slot.generation.store(currentGeneration, std::memory_order_relaxed);
+    slot.lastUsed.store(clock.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void HRIRCache::clear() noexcept
+{
+    // every slot's generation is now out of date, the slots' generations start at 0 so skip that one if this ever wraps around
+    if (generation.fetch_add(1, std::memory_order_acq_rel) + 1 == 0)
+        generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void HRIRCache::setQuantization(const Quantization newQuantization) noexcept
+{
+    radiusStep.store(newQuantization.radius, std::memory_order_relaxed);
+    angleStep.store(newQuantization.angle, std::memory_order_relaxed);
+    clear();
+}
+
+HRIRCache::Quantization HRIRCache::getQuantization() const noexcept
+{
+    Quantization quantization;
+    quantization.radius = radiusStep.load(std::memory_order_relaxed);
+    quantization.angle = angleStep.load(std::memory_order_relaxed);
+    return quantization;
+}
+
+std::size_t HRIRCache::getMemorySize() const noexcept
+{
+    return entries.size() * sizeof(float) + std::size_t(numSets) * numWays * sizeof(Slot);
+}
@@ -0,0 +1,92 @@
+//
+//  HRIRCache.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+     
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+     
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+     
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+     
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __HRIRCache__
+#define __HRIRCache__
+
+#include "Data.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// a fixed size cache of interpolated (and normalized) hrir pairs along with their scaling factors and onset delays, keyed by the
+// direction and distance they were interpolated for after snapping those to a quantization grid. sources that sit still while the
+// host jitters their position, or that go around the same path over and over, keep landing on the same quantized positions.
+// lookups and inserts never block or allocate so any number of audio threads can share one, each slot is guarded by a sequence
+// number that a reader checks before and after copying out of it (a seqlock), and an insert just gives up if its slot is busy.
+// the slots are 4 way set associative and the least recently used one in a set is replaced.
+class HRIRCache
+{
+public:
+    // grid that positions are snapped to before being looked up
+    struct Quantization
+    {
+        float radius = 0.002f; // meters
+        float angle = 0.001f;  // radians, for both azimuth and elevation
+    };
+    /** a cache holding at least capacity hrir pairs (rounded up to a power of 2) with the default quantization, see setQuantization() */
+    explicit HRIRCache(int capacity = 256);
+    HRIRCache(const HRIRCache&) = delete;
+    HRIRCache& operator=(const HRIRCache&) = delete;
+    /** snap a position (rae) to the quantization grid, quantizedRAE gets the snapped position to interpolate the hrirs for and the key for it is returned */
+    std::uint64_t quantize(const float* rae, float* quantizedRAE) const noexcept;
+    /** copy out the hrir pair (length samples for each ear, with the right ear at +maxNumTimeSteps), scaling factors, and onset delays (if delays isn't null) cached for key, returns false if it isn't there */
+    bool find(std::uint64_t key, int length, float* hrir, float* delays, float* scaling) noexcept;
+    /** cache an hrir pair (laid out like find()) for key, unless another thread is writing to the slot it would go into */
+    void insert(std::uint64_t key, int length, const float* hrir, const float* delays, const float* scaling) noexcept;
+    /** drop everything, for when the hrir data being interpolated changes */
+    void clear() noexcept;
+    /** change the quantization grid, this also clears the cache */
+    void setQuantization(Quantization newQuantization) noexcept;
+    Quantization getQuantization() const noexcept;
+    /** lookup statistics since the cache was made */
+    std::uint64_t getHits() const noexcept { return hits.load(std::memory_order_relaxed); }
+    std::uint64_t getMisses() const noexcept { return misses.load(std::memory_order_relaxed); }
+    /** memory used by the cached hrirs and their bookkeeping, in bytes */
+    std::size_t getMemorySize() const noexcept;
+private:
+    static constexpr int numWays = 4;
+    // hrir pair + 2 scaling factors + 2 delays
+    static constexpr int entrySize = 2 * maxNumTimeSteps + 4;
+    struct Slot
+    {
+        // odd while being written
+        std::atomic<std::uint32_t> sequence {0};
+        // the slot holds key's hrirs if generation matches the cache's
+        std::atomic<std::uint64_t> key {0};
+        std::atomic<std::uint32_t> generation {0};
+        std::atomic<std::uint32_t> lastUsed {0};
+    };
+    int numSets, setBits;
+    std::unique_ptr<Slot[]> slots;
+    std::vector<float> entries;
+    std::atomic<std::uint32_t> generation {1};
+    std::atomic<std::uint32_t> clock {0};
+    std::atomic<float> radiusStep, angleStep;
+    std::atomic<std::uint64_t> hits {0}, misses {0};
+};
+
+#endif /* defined(__HRIRCache__) */
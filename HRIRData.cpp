@@ -0,0 +1,760 @@
+//
+//  HRIRData.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "HRIRData.h"
+#include "FFT.h"
+#include "Resampler.h"
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <vector>
+#ifdef _WIN32
+  #include <malloc.h>
+#endif
+
+constexpr int HRIRData::minimumPhaseLength;
+constexpr std::size_t HRIRData::alignment;
+constexpr bool HRIRData::halfPrecision;
+
+using Sample = HRIRData::Sample;
+
+// number of hrirs in a file, the poles are only stored once for both channels
+static constexpr int64 numFileHRIRs = numDistanceSteps * (HRIRData::numAzimuths * HRIRData::numElevations * 2 + 2);
+
+// what is in a file, full length hrirs or minimum phase hrirs followed by a (float) onset delay for each hrir
+struct FileFormat
+{
+    int length;
+    std::size_t sampleSize;
+    bool delays;
+};
+
+// the file's hrir length and whether its samples are floats or halfs, which we can tell by its size in bytes given how long the full and minimum phase hrirs
+// are at the data's sample rate
+static bool getFileFormat(const int64 fileSizeInBytes, const int fullLength, const int minimumPhaseLength, FileFormat& format) noexcept
+{
+    const auto minimumPhaseSize = [=] (const std::size_t sampleSize)
+    {
+        return numFileHRIRs * int64(minimumPhaseLength * sampleSize + sizeof(float));
+    };
+    if (fileSizeInBytes == minimumPhaseSize(sizeof(float)))
+        format = {minimumPhaseLength, sizeof(float), true};
+    else if (fileSizeInBytes == minimumPhaseSize(sizeof(std::uint16_t)))
+        format = {minimumPhaseLength, sizeof(std::uint16_t), true};
+    else if (fileSizeInBytes >= numFileHRIRs * int64(fullLength * sizeof(float)))
+        format = {fullLength, sizeof(float), false};
+    else if (fileSizeInBytes >= numFileHRIRs * int64(fullLength * sizeof(std::uint16_t)))
+        format = {fullLength, sizeof(std::uint16_t), false};
+    else
+        return false;
+    return true;
+}
+
+// a converted cache has this after its samples, so the error from converting the original file is still known on later runs that just map the cache
+struct ConversionErrorTrailer
+{
+    std::uint32_t tag;
+    float maxAbsError;
+    float maxAbsValue;
+    float signalToErrorDB;
+};
+static constexpr std::uint32_t conversionErrorTag = 0x45433344; // "D3CE"
+
+// the bytes in a full format file before any trailer
+static int64 getFullSizeInBytes(const FileFormat& format) noexcept
+{
+    return numFileHRIRs * int64(format.length * format.sampleSize);
+}
+
+// reads the conversion error out of a file's trailer bytes, if they are one
+static bool readConversionError(const char* trailerBytes, HRIRData::ConversionError& error) noexcept
+{
+    ConversionErrorTrailer trailer;
+    std::memcpy(&trailer, trailerBytes, sizeof(trailer));
+    if (trailer.tag != conversionErrorTag)
+        return false;
+    error.maxAbsError = trailer.maxAbsError;
+    error.maxAbsValue = trailer.maxAbsValue;
+    error.signalToErrorDB = trailer.signalToErrorDB;
+    error.lossy = true;
+    return true;
+}
+
+// calls f(i) for i = 0 to count-1, split up between all the cores
+template <typename F>
+static void parallelFor(const std::size_t count, const F& f)
+{
+    const std::size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t]
+        {
+            for (std::size_t i = count * t / numThreads; i < count * (t + 1) / numThreads; ++i)
+                f(i);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+static Sample* alignedAllocate(const std::size_t numSamples) noexcept
+{
+#ifdef _WIN32
+    return static_cast<Sample*>(_aligned_malloc(numSamples * sizeof(Sample), HRIRData::alignment));
+#else
+    void* memory = nullptr;
+    if (posix_memalign(&memory, HRIRData::alignment, numSamples * sizeof(Sample)) != 0)
+        return nullptr;
+    return static_cast<Sample*>(memory);
+#endif
+}
+
+static void alignedFree(Sample* memory) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+HRIRData::HRIRData() noexcept
+{
+    setLength(numTimeSteps);
+}
+
+HRIRData::~HRIRData()
+{
+    waitForLoader();
+    free();
+}
+
+int HRIRData::scaleLength(const int length, const double fromSampleRate, const double toSampleRate) noexcept
+{
+    return ((int)std::ceil(length * toSampleRate / fromSampleRate - 1.0e-6) + 31) / 32 * 32;
+}
+
+void HRIRData::setLength(const int newLength) noexcept
+{
+    length = newLength;
+    channelStride = newLength;
+    elevationStride = 2 * channelStride;
+    azimuthStride = numElevations * elevationStride;
+    distanceStride = numAzimuths * azimuthStride;
+    dataSize = numDistanceSteps * distanceStride;
+    poleStride = 2 * channelStride;
+    poleDistanceStride = 2 * poleStride;
+    polesSize = numDistanceSteps * poleDistanceStride;
+}
+
+std::shared_ptr<HRIRData> HRIRData::getShared(const char* path, const bool memoryMap, const char* cachePath)
+{
+    // the shared data only lives as long as someone holds a reference to it
+    static std::mutex lock;
+    static std::weak_ptr<HRIRData> shared;
+    const std::lock_guard<std::mutex> guard (lock);
+    auto data = shared.lock();
+    if (!data) {
+        data = std::make_shared<HRIRData>();
+        if (cachePath) {
+            data->state.store(State::LOADING, std::memory_order_release);
+            data->loader = std::thread([data = data.get(), filePath = std::string(path), cacheFilePath = std::string(cachePath), memoryMap]
+                                       { data->loadConverted(filePath, cacheFilePath, memoryMap); });
+        } else {
+            data->loadAsync(path, memoryMap);
+        }
+        shared = data;
+    }
+    return data;
+}
+
+std::shared_ptr<HRIRData> HRIRData::getSharedMinimumPhase(std::shared_ptr<HRIRData> full, const char* cachePath, const bool memoryMap)
+{
+    // one for each sample rate
+    static std::mutex lock;
+    static std::map<long, std::weak_ptr<HRIRData>> shared;
+    const std::lock_guard<std::mutex> guard (lock);
+    auto& weak = shared[std::lround(full->getSampleRate())];
+    auto data = weak.lock();
+    if (!data) {
+        data = std::make_shared<HRIRData>();
+        data->sampleRate = full->getSampleRate();
+        data->state.store(State::LOADING, std::memory_order_release);
+        data->loader = std::thread([data = data.get(), full, path = std::string(cachePath), memoryMap]
+                                   { data->loadMinimumPhase(full, path, memoryMap); });
+        weak = data;
+    }
+    return data;
+}
+
+std::shared_ptr<HRIRData> HRIRData::getSharedResampled(std::shared_ptr<HRIRData> full, const double sampleRate, const char* cachePath, const bool memoryMap)
+{
+    // one for each sample rate
+    static std::mutex lock;
+    static std::map<long, std::weak_ptr<HRIRData>> shared;
+    const std::lock_guard<std::mutex> guard (lock);
+    auto& weak = shared[std::lround(sampleRate)];
+    auto data = weak.lock();
+    if (!data) {
+        data = std::make_shared<HRIRData>();
+        data->sampleRate = sampleRate;
+        data->setLength(scaleLength(numTimeSteps, sampleRate_HRTF, sampleRate));
+        data->state.store(State::LOADING, std::memory_order_release);
+        data->loader = std::thread([data = data.get(), full, path = std::string(cachePath), memoryMap]
+                                   { data->loadResampled(full, path, memoryMap); });
+        weak = data;
+    }
+    return data;
+}
+
+void HRIRData::loadAsync(const char* path, const bool memoryMap)
+{
+    waitForLoader();
+    state.store(State::LOADING, std::memory_order_release);
+    loader = std::thread([this, filePath = std::string(path), memoryMap] { load(filePath.c_str(), memoryMap); });
+}
+
+void HRIRData::waitForLoader()
+{
+    if (loader.joinable())
+        loader.join();
+}
+
+bool HRIRData::allocate()
+{
+    if (!ownedData)
+        ownedData = alignedAllocate(dataSize);
+    if (!poles)
+        poles = alignedAllocate(polesSize);
+    data = ownedData;
+    return ownedData && poles;
+}
+
+bool HRIRData::load(const char* path, const bool memoryMap)
+{
+    free();
+    state.store(State::LOADING, std::memory_order_release);
+    if (loadFile(path, memoryMap)) {
+        state.store(State::LOADED, std::memory_order_release);
+        return true;
+    }
+    // failed to open/read the hrtf binary file
+    setLength(scaleLength(numTimeSteps, sampleRate_HRTF, sampleRate));
+    loadZeros();
+    state.store(State::FAILED, std::memory_order_release);
+    return false;
+}
+
+bool HRIRData::loadFile(const char* path, const bool memoryMap)
+{
+    clear();
+    if ((memoryMap && map(path)) || read(path))
+        return true;
+    clear();
+    return false;
+}
+
+void HRIRData::loadConverted(const std::string& path, const std::string& cachePath, const bool memoryMap)
+{
+    // map the converted copy saved by a previous run, unless the file has changed since then
+    const File file (path);
+    const File cacheFile (cachePath);
+    if (memoryMap && cacheFile.getLastModificationTime() >= file.getLastModificationTime() && map(cachePath.c_str()) && length == numTimeSteps && !hasDelays()) {
+        state.store(State::LOADED, std::memory_order_release);
+        return;
+    }
+    clear();
+    if (!loadFile(path.c_str(), memoryMap)) {
+        setLength(numTimeSteps);
+        loadZeros();
+        state.store(State::FAILED, std::memory_order_release);
+        return;
+    }
+    // the file was read into private memory, swap that for a mapping of the converted copy (which keeps the conversion error in its trailer)
+    if (memoryMap && !isMemoryMapped()) {
+        saveCache(cachePath);
+        clear();
+        if (!map(cachePath.c_str())) {
+            clear();
+            loadFile(path.c_str(), false);
+        }
+    }
+    state.store(State::LOADED, std::memory_order_release);
+}
+
+void HRIRData::loadMinimumPhase(const std::shared_ptr<HRIRData>& full, const std::string& cachePath, const bool memoryMap)
+{
+    // making them takes a few seconds, so use the ones cached by a previous run if we can
+    const int newLength = scaleLength(minimumPhaseLength, sampleRate_HRTF, sampleRate);
+    if (loadFile(cachePath.c_str(), memoryMap) && length == newLength && hasDelays()) {
+        state.store(State::LOADED, std::memory_order_release);
+        return;
+    }
+    while (!full->isReady())
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (full->getState() == State::FAILED) {
+        setLength(newLength);
+        loadZeros();
+        state.store(State::FAILED, std::memory_order_release);
+        return;
+    }
+    makeMinimumPhase(*full, newLength);
+    saveCache(cachePath);
+    state.store(State::LOADED, std::memory_order_release);
+}
+
+void HRIRData::loadResampled(const std::shared_ptr<HRIRData>& full, const std::string& cachePath, const bool memoryMap)
+{
+    const int newLength = scaleLength(numTimeSteps, sampleRate_HRTF, sampleRate);
+    if (loadFile(cachePath.c_str(), memoryMap) && length == newLength && !hasDelays()) {
+        state.store(State::LOADED, std::memory_order_release);
+        return;
+    }
+    while (!full->isReady())
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (full->getState() == State::FAILED) {
+        setLength(newLength);
+        loadZeros();
+        state.store(State::FAILED, std::memory_order_release);
+        return;
+    }
+    makeResampled(*full);
+    saveCache(cachePath);
+    state.store(State::LOADED, std::memory_order_release);
+}
+
+void HRIRData::saveCache(const std::string& cachePath) const
+{
+    const File cacheFile (cachePath);
+    const File tempFile (cachePath + ".tmp");
+    cacheFile.getParentDirectory().createDirectory();
+    bool saved = save(tempFile.getFullPathName().toRawUTF8());
+    if (saved && conversionError.lossy && !hasDelays()) {
+        std::ofstream os(tempFile.getFullPathName().toRawUTF8(), std::ios::binary | std::ios::app);
+        const ConversionErrorTrailer trailer {conversionErrorTag, conversionError.maxAbsError, conversionError.maxAbsValue, conversionError.signalToErrorDB};
+        os.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+        saved = bool(os);
+    }
+    if (saved)
+        tempFile.moveFileTo(cacheFile);
+    else
+        tempFile.deleteFile();
+}
+
+bool HRIRData::map(const char* path)
+{
+    // read-only and non-exclusive, so all processes mapping the file share the same physical pages from the page cache and pages never touched are never read from disk
+    std::unique_ptr<MemoryMappedFile> file (new MemoryMappedFile(File(path), MemoryMappedFile::readOnly));
+    FileFormat format;
+    if (file->getData() == nullptr || !getFileFormat(file->getSize(), scaleLength(numTimeSteps, sampleRate_HRTF, sampleRate),
+                                                     scaleLength(minimumPhaseLength, sampleRate_HRTF, sampleRate), format) || format.sampleSize != sizeof(Sample))
+        return false;
+    setLength(format.length);
+    poles = alignedAllocate(polesSize);
+    if (!poles)
+        return false;
+    // mapping starts at the beginning of the file and so is page (and therefore cache line) aligned
+    mappedFile = std::move(file);
+    data = static_cast<const Sample*>(mappedFile->getData());
+    conversionError = ConversionError();
+    if (!format.delays && mappedFile->getSize() == getFullSizeInBytes(format) + int64(sizeof(ConversionErrorTrailer)))
+        readConversionError(static_cast<const char*>(mappedFile->getData()) + getFullSizeInBytes(format), conversionError);
+    // pole data is the same for both channels, but we store it for both so that poles can be indexed just like the rest of the data
+    const Sample* filePoles = data + dataSize;
+    for (int d = 0; d < numDistanceSteps; ++d) {
+        for (int pole = 0; pole < 2; ++pole, filePoles += length) {
+            Sample* const left = &poles[d * poleDistanceStride + pole * poleStride];
+            std::copy(filePoles, filePoles + length, left);
+            std::copy(filePoles, filePoles + length, left + channelStride);
+        }
+    }
+    // the delays follow the samples, which always leaves them 4 byte aligned
+    if (format.delays) {
+        delays = reinterpret_cast<const float*>(filePoles);
+        const float* const filePoleDelays = delays + dataSize / length;
+        poleDelays.assign(filePoleDelays, filePoleDelays + 2 * numDistanceSteps);
+    }
+    return true;
+}
+
+bool HRIRData::read(const char* path)
+{
+    std::ifstream is(path, std::ios::binary);
+    FileFormat format;
+    if (!is.good() || !getFileFormat(File(path).getSize(), scaleLength(numTimeSteps, sampleRate_HRTF, sampleRate),
+                                     scaleLength(minimumPhaseLength, sampleRate_HRTF, sampleRate), format))
+        return false;
+    setLength(format.length);
+    if (!allocate())
+        return false;
+    const bool ok = format.sampleSize == sizeof(float) ? read<float>(is, format.delays) : read<std::uint16_t>(is, format.delays);
+    // a cache already in the stored precision converts losslessly, but its trailer has the error from converting the original file
+    if (ok && !conversionError.lossy && !format.delays && File(path).getSize() == getFullSizeInBytes(format) + int64(sizeof(ConversionErrorTrailer))) {
+        char trailerBytes[sizeof(ConversionErrorTrailer)];
+        if (is.read(trailerBytes, sizeof(trailerBytes)))
+            readConversionError(trailerBytes, conversionError);
+    }
+    return ok;
+}
+
+template <typename FileSample>
+bool HRIRData::read(std::istream& is, const bool withDelays)
+{
+    conversionError = ConversionError();
+    const bool lossy = sizeof(FileSample) > sizeof(Sample);
+    double signalPower = 0, errorPower = 0;
+    // reads in a chunk of the file's samples and converts them to our stored precision
+    std::vector<FileSample> chunk (azimuthStride);
+    const auto readConverted = [&] (Sample* const out, const std::size_t numSamples)
+    {
+        is.read(reinterpret_cast<char*>(chunk.data()), numSamples * sizeof(FileSample));
+        for (std::size_t i = 0; i < numSamples; ++i) {
+            simd::convert(chunk[i], out[i]);
+            if (lossy) {
+                const float x = simd::toFloat(chunk[i]);
+                const float error = std::abs(simd::toFloat(out[i]) - x);
+                conversionError.maxAbsError = std::max(conversionError.maxAbsError, error);
+                conversionError.maxAbsValue = std::max(conversionError.maxAbsValue, std::abs(x));
+                signalPower += double(x) * x;
+                errorPower += double(error) * error;
+            }
+        }
+    };
+    // the file's layout for the non-pole data is the same as ours
+    for (std::size_t i = 0; i < dataSize; i += azimuthStride)
+        readConverted(&ownedData[i], azimuthStride);
+    // pole data is the same for both channels, but we store it for both so that poles can be indexed just like the rest of the data
+    for (int d = 0; d < numDistanceSteps; ++d) {
+        for (int pole = 0; pole < 2; ++pole) {
+            Sample* const left = &poles[d * poleDistanceStride + pole * poleStride];
+            readConverted(left, length);
+            std::copy(left, left + length, left + channelStride);
+        }
+    }
+    if (withDelays) {
+        ownedDelays.resize(dataSize / length);
+        poleDelays.resize(2 * numDistanceSteps);
+        is.read(reinterpret_cast<char*>(ownedDelays.data()), ownedDelays.size() * sizeof(float));
+        is.read(reinterpret_cast<char*>(poleDelays.data()), poleDelays.size() * sizeof(float));
+        delays = ownedDelays.data();
+    }
+    if (lossy) {
+        conversionError.lossy = true;
+        conversionError.signalToErrorDB = errorPower > 0 ? float(10 * std::log10(signalPower / errorPower)) : INFINITY;
+    }
+    return bool(is);
+}
+
+bool HRIRData::save(const char* path) const
+{
+    if (!isLoaded())
+        return false;
+    std::ofstream os(path, std::ios::binary);
+    os.write(reinterpret_cast<const char*>(data), dataSize * sizeof(Sample));
+    for (int d = 0; d < numDistanceSteps; ++d)
+        for (int pole = 0; pole < 2; ++pole)
+            os.write(reinterpret_cast<const char*>(getPole(d, pole)), length * sizeof(Sample));
+    if (hasDelays()) {
+        os.write(reinterpret_cast<const char*>(delays), (dataSize / length) * sizeof(float));
+        os.write(reinterpret_cast<const char*>(poleDelays.data()), poleDelays.size() * sizeof(float));
+    }
+    return bool(os);
+}
+
+void HRIRData::makeMinimumPhase(const HRIRData& full, const int newLength)
+{
+    clear();
+    sampleRate = full.sampleRate;
+    setLength(newLength);
+    if (!allocate())
+        return;
+    ownedDelays.resize(dataSize / length);
+    poleDelays.resize(2 * numDistanceSteps);
+    delays = ownedDelays.data();
+    // zero padded to 4x the hrir length so the cepstrum has little time aliasing
+    int order = 1;
+    while ((1 << order) < 4 * full.length)
+        ++order;
+    const FFT fft (order);
+    const int N = fft.getSize();
+    const auto makeOne = [&] (const Sample* const h, Sample* const out, float& delay)
+    {
+        // scratch space for each thread doing this
+        thread_local std::vector<std::complex<float>> spectrum, cepstrum, minimumPhase, correlation;
+        spectrum.resize(N);
+        cepstrum.resize(N);
+        minimumPhase.resize(N);
+        correlation.resize(N);
+        for (int n = 0; n < N; ++n)
+            spectrum[n] = n < full.length ? simd::toFloat(h[n]) : 0.0f;
+        fft.perform(spectrum.data(), false);
+        // magnitudes go in the cepstrum's buffer for now
+        float maxMagnitude = 0;
+        for (int k = 0; k < N; ++k) {
+            cepstrum[k] = std::sqrt(std::norm(spectrum[k]));
+            maxMagnitude = std::max(maxMagnitude, cepstrum[k].real());
+        }
+        if (maxMagnitude == 0) {
+            std::fill(out, out + length, Sample(0));
+            delay = 0;
+            return;
+        }
+        // real cepstrum, with spectral nulls floored at -100 dB so the log stays finite
+        const float floor = maxMagnitude * 1.0e-5f;
+        for (int k = 0; k < N; ++k)
+            cepstrum[k] = std::log(std::max(cepstrum[k].real(), floor));
+        fft.perform(cepstrum.data(), true);
+        // fold the anticausal part of the cepstrum onto the causal part
+        for (int n = 1; n < N / 2; ++n)
+            cepstrum[n] = 2.0f * cepstrum[n].real();
+        cepstrum[0] = cepstrum[0].real();
+        cepstrum[N / 2] = cepstrum[N / 2].real();
+        for (int n = N / 2 + 1; n < N; ++n)
+            cepstrum[n] = 0;
+        fft.perform(cepstrum.data(), false);
+        for (int k = 0; k < N; ++k)
+            minimumPhase[k] = std::polar(std::exp(cepstrum[k].real()), cepstrum[k].imag());
+        // the onset delay is the lag of the peak cross-correlation between the hrir and its minimum phase version
+        for (int k = 0; k < N; ++k)
+            correlation[k] = {spectrum[k].real() * minimumPhase[k].real() + spectrum[k].imag() * minimumPhase[k].imag(),
+                              spectrum[k].imag() * minimumPhase[k].real() - spectrum[k].real() * minimumPhase[k].imag()};
+        fft.perform(correlation.data(), true);
+        int peak = 0;
+        for (int lag = 1; lag < full.length; ++lag)
+            if (correlation[lag].real() > correlation[peak].real())
+                peak = lag;
+        // parabolic interpolation between the neighboring lags for a fractional delay
+        const float before = correlation[(peak + N - 1) % N].real();
+        const float at = correlation[peak].real();
+        const float after = correlation[peak + 1].real();
+        const float curvature = before - 2 * at + after;
+        const float offset = curvature < 0 ? 0.5f * (before - after) / curvature : 0;
+        delay = std::max(0.0f, peak + std::max(-0.5f, std::min(0.5f, offset)));
+        fft.perform(minimumPhase.data(), true);
+        for (int n = 0; n < length; ++n)
+            simd::convert(minimumPhase[n].real(), out[n]);
+    };
+    // every hrir is independent, so split them up between all the cores
+    parallelFor(dataSize / length, [&] (const std::size_t i) { makeOne(&full.data[i * full.length], &ownedData[i * length], ownedDelays[i]); });
+    for (int d = 0; d < numDistanceSteps; ++d) {
+        for (int pole = 0; pole < 2; ++pole) {
+            Sample* const left = &poles[d * poleDistanceStride + pole * poleStride];
+            makeOne(full.getPole(d, pole), left, poleDelays[d * 2 + pole]);
+            std::copy(left, left + length, left + channelStride);
+        }
+    }
+}
+
+void HRIRData::makeResampled(const HRIRData& full)
+{
+    clear();
+    setLength(scaleLength(full.length, full.sampleRate, sampleRate));
+    if (!allocate())
+        return;
+    // latency doesn't matter here, so the best quality there is
+    const Resampler resampler (full.sampleRate, 0, sampleRate, true, 1, ResamplerQuality::HIGH);
+    // the same impulse response at a higher sample rate has more samples adding up, so they're scaled down to filter with the same gain
+    const float gain = float(full.sampleRate / sampleRate);
+    const auto makeOne = [&] (const Sample* const h, Sample* const out)
+    {
+        thread_local std::vector<float> in, resampled;
+        in.resize(full.length);
+        resampled.resize(length);
+        for (int n = 0; n < full.length; ++n)
+            in[n] = simd::toFloat(h[n]);
+        resampler.convert(in.data(), full.length, resampled.data(), length);
+        for (int n = 0; n < length; ++n)
+            simd::convert(gain * resampled[n], out[n]);
+    };
+    parallelFor(dataSize / length, [&] (const std::size_t i) { makeOne(&full.data[i * full.length], &ownedData[i * length]); });
+    for (int d = 0; d < numDistanceSteps; ++d) {
+        for (int pole = 0; pole < 2; ++pole) {
+            Sample* const left = &poles[d * poleDistanceStride + pole * poleStride];
+            makeOne(full.getPole(d, pole), left);
+            std::copy(left, left + length, left + channelStride);
+        }
+    }
+}
+
+void HRIRData::loadZeros()
+{
+    clear();
+    if (allocate()) {
+        // a zero half is all zero bits just like a zero float
+        std::fill(ownedData, ownedData + dataSize, Sample(0));
+        std::fill(poles, poles + polesSize, Sample(0));
+    }
+}
+
+void HRIRData::free() noexcept
+{
+    state.store(State::NOT_LOADED, std::memory_order_release);
+    clear();
+}
+
+void HRIRData::clear() noexcept
+{
+    mappedFile = nullptr;
+    alignedFree(ownedData);
+    alignedFree(poles);
+    data = nullptr;
+    ownedData = nullptr;
+    poles = nullptr;
+    delays = nullptr;
+    ownedDelays.clear();
+    poleDelays.clear();
+    conversionError = ConversionError();
+}
+
+template <typename T>
+float HRIRData::weightedSum(const T* const* hrirs, const float* weights, const int numHRIRs, const int length, float* out, const bool normalize) noexcept
+{
+    float absSum;
+#if SIMD_AVX512
+    // 64 outputs at a time in 4 registers (then 32 in 2 for the rest), so each hrir is streamed through in cache line sized pieces
+    __m512 absSum16 = _mm512_setzero_ps();
+    int n = 0;
+    for (; n + 64 <= length; n += 64) {
+        __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps(), sum2 = _mm512_setzero_ps(), sum3 = _mm512_setzero_ps();
+        for (int i = 0; i < numHRIRs; ++i) {
+            const __m512 w = _mm512_set1_ps(weights[i]);
+            const T* const x = hrirs[i] + n;
+            sum0 = _mm512_fmadd_ps(w, simd::load16(x     ), sum0);
+            sum1 = _mm512_fmadd_ps(w, simd::load16(x + 16), sum1);
+            sum2 = _mm512_fmadd_ps(w, simd::load16(x + 32), sum2);
+            sum3 = _mm512_fmadd_ps(w, simd::load16(x + 48), sum3);
+        }
+        _mm512_storeu_ps(out + n     , sum0);
+        _mm512_storeu_ps(out + n + 16, sum1);
+        _mm512_storeu_ps(out + n + 32, sum2);
+        _mm512_storeu_ps(out + n + 48, sum3);
+        absSum16 = _mm512_add_ps(absSum16, _mm512_add_ps(_mm512_add_ps(_mm512_abs_ps(sum0), _mm512_abs_ps(sum1)),
+                                                         _mm512_add_ps(_mm512_abs_ps(sum2), _mm512_abs_ps(sum3))));
+    }
+    for (; n < length; n += 32) {
+        __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+        for (int i = 0; i < numHRIRs; ++i) {
+            const __m512 w = _mm512_set1_ps(weights[i]);
+            const T* const x = hrirs[i] + n;
+            sum0 = _mm512_fmadd_ps(w, simd::load16(x     ), sum0);
+            sum1 = _mm512_fmadd_ps(w, simd::load16(x + 16), sum1);
+        }
+        _mm512_storeu_ps(out + n     , sum0);
+        _mm512_storeu_ps(out + n + 16, sum1);
+        absSum16 = _mm512_add_ps(absSum16, _mm512_add_ps(_mm512_abs_ps(sum0), _mm512_abs_ps(sum1)));
+    }
+    absSum = _mm512_reduce_add_ps(absSum16);
+#elif SIMD_AVX
+    // 32 outputs at a time in 4 registers, so each hrir is streamed through in cache line sized pieces
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 absSum8 = _mm256_setzero_ps();
+    for (int n = 0; n < length; n += 32) {
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps(), sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+        for (int i = 0; i < numHRIRs; ++i) {
+            const __m256 w = _mm256_set1_ps(weights[i]);
+            const T* const x = hrirs[i] + n;
+            sum0 = simd::multiplyAdd(w, simd::load8(x     ), sum0);
+            sum1 = simd::multiplyAdd(w, simd::load8(x +  8), sum1);
+            sum2 = simd::multiplyAdd(w, simd::load8(x + 16), sum2);
+            sum3 = simd::multiplyAdd(w, simd::load8(x + 24), sum3);
+        }
+        _mm256_storeu_ps(out + n     , sum0);
+        _mm256_storeu_ps(out + n +  8, sum1);
+        _mm256_storeu_ps(out + n + 16, sum2);
+        _mm256_storeu_ps(out + n + 24, sum3);
+        absSum8 = _mm256_add_ps(absSum8, _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(signMask, sum0), _mm256_andnot_ps(signMask, sum1)),
+                                                       _mm256_add_ps(_mm256_andnot_ps(signMask, sum2), _mm256_andnot_ps(signMask, sum3))));
+    }
+    absSum = simd::horizontalSum(absSum8);
+#elif SIMD_SSE
+    // 16 outputs at a time in 4 registers
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 absSum4 = _mm_setzero_ps();
+    for (int n = 0; n < length; n += 16) {
+        __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+        for (int i = 0; i < numHRIRs; ++i) {
+            const __m128 w = _mm_set1_ps(weights[i]);
+            const T* const x = hrirs[i] + n;
+            sum0 = _mm_add_ps(_mm_mul_ps(w, simd::load4(x     )), sum0);
+            sum1 = _mm_add_ps(_mm_mul_ps(w, simd::load4(x +  4)), sum1);
+            sum2 = _mm_add_ps(_mm_mul_ps(w, simd::load4(x +  8)), sum2);
+            sum3 = _mm_add_ps(_mm_mul_ps(w, simd::load4(x + 12)), sum3);
+        }
+        _mm_storeu_ps(out + n     , sum0);
+        _mm_storeu_ps(out + n +  4, sum1);
+        _mm_storeu_ps(out + n +  8, sum2);
+        _mm_storeu_ps(out + n + 12, sum3);
+        absSum4 = _mm_add_ps(absSum4, _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, sum0), _mm_andnot_ps(signMask, sum1)),
+                                                 _mm_add_ps(_mm_andnot_ps(signMask, sum2), _mm_andnot_ps(signMask, sum3))));
+    }
+    absSum = simd::horizontalSum(absSum4);
+#elif SIMD_NEON
+    float32x4_t absSum4 = vdupq_n_f32(0);
+    for (int n = 0; n < length; n += 16) {
+        float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0), sum2 = vdupq_n_f32(0), sum3 = vdupq_n_f32(0);
+        for (int i = 0; i < numHRIRs; ++i) {
+            const float32x4_t w = vdupq_n_f32(weights[i]);
+            const T* const x = hrirs[i] + n;
+            sum0 = vfmaq_f32(sum0, w, simd::load4(x     ));
+            sum1 = vfmaq_f32(sum1, w, simd::load4(x +  4));
+            sum2 = vfmaq_f32(sum2, w, simd::load4(x +  8));
+            sum3 = vfmaq_f32(sum3, w, simd::load4(x + 12));
+        }
+        vst1q_f32(out + n     , sum0);
+        vst1q_f32(out + n +  4, sum1);
+        vst1q_f32(out + n +  8, sum2);
+        vst1q_f32(out + n + 12, sum3);
+        absSum4 = vaddq_f32(absSum4, vaddq_f32(vaddq_f32(vabsq_f32(sum0), vabsq_f32(sum1)), vaddq_f32(vabsq_f32(sum2), vabsq_f32(sum3))));
+    }
+    absSum = vaddvq_f32(absSum4);
+#else
+    for (int n = 0; n < length; ++n)
+        out[n] = 0;
+    for (int i = 0; i < numHRIRs; ++i) {
+        const float w = weights[i];
+        const T* const x = hrirs[i];
+        for (int n = 0; n < length; ++n)
+            out[n] += w * simd::toFloat(x[n]);
+    }
+    absSum = 0;
+    for (int n = 0; n < length; ++n)
+        absSum += std::abs(out[n]);
+#endif
+    // the outputs were just written so this is all in cache
+    if (normalize && absSum > 0) {
+        const float scale = 1.0f / absSum;
+        for (int n = 0; n < length; ++n)
+            out[n] *= scale;
+    }
+    return absSum;
+}
+
+template float HRIRData::weightedSum(const std::uint16_t* const*, const float*, int, int, float*, bool) noexcept;
+template float HRIRData::weightedSum(const float* const*, const float*, int, int, float*, bool) noexcept;
@@ -0,0 +1,184 @@
+//
+//  HRIRData.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __HRIRData__
+#define __HRIRData__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Data.h"
+#include "SIMD.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// the hrir data set held in one contiguous, cache line aligned block of memory indexed with computed strides.
+// only one azimuth side is stored (the other side is the same data with the ear channels swapped) and the two
+// poles are stored separately since they are shared by all azimuths. the data can either be read into private
+// memory or mapped read-only straight from the file so that the os can share one copy between all processes.
+// samples are stored as half precision floats (unless halfPrecision is turned off), files of either precision can
+// be loaded and are converted if needed, but only a file that matches the stored precision can be memory mapped.
+// plugin instances share one reference counted copy via getShared(), which loads the data on a background thread.
+// a minimum phase version of the data set, with shorter hrirs and each hrir's onset delay split off, can be made
+// from the full one and is shared and cached to disk the same way via getSharedMinimumPhase(). so can the full data
+// resampled to another sample rate (with hrirs as much longer or shorter as the rate is) via getSharedResampled().
+class HRIRData
+{
+public:
+    // NOT_LOADED -> LOADING -> LOADED, or FAILED if the file could not be read and silent hrirs were loaded instead
+    enum class State { NOT_LOADED, LOADING, LOADED, FAILED };
+    // number of azimuths and (non-pole) elevations actually stored
+    static constexpr int numAzimuths = numAzimuthSteps / 2 + 1;
+    static constexpr int numElevations = numElevationSteps - 1;
+    // number of stored directions, direction index a * numElevations + e-1 for the hrirs followed by the two poles
+    static constexpr int numDirections = numAzimuths * numElevations + 2;
+    // length of the minimum phase hrirs, the onset delays carry the rest
+    static constexpr int minimumPhaseLength = 64;
+    // in bytes, one cache line
+    static constexpr std::size_t alignment = 64;
+    // store the hrirs as half precision floats, halves the memory footprint and the bytes streamed for each hrir interpolation
+    static constexpr bool halfPrecision = true;
+    using Sample = std::conditional<halfPrecision, std::uint16_t, float>::type;
+    // error introduced by converting the file's samples to the stored precision (all zeros if no conversion was lossy)
+    struct ConversionError
+    {
+        float maxAbsError = 0;
+        float maxAbsValue = 0;
+        float signalToErrorDB = 0;
+        bool lossy = false;
+    };
+
+    HRIRData() noexcept;
+    ~HRIRData();
+    HRIRData(const HRIRData&) = delete;
+    HRIRData& operator=(const HRIRData&) = delete;
+    /** get the hrir data shared by all plugin instances, the first call (or the first after all previous references were released) starts loading the file at path on a background thread. check isReady() before reading any hrirs.
+        a file that isn't in the stored precision can't be memory mapped, so given a cachePath it is converted once and saved there in the stored precision to be mapped from then on */
+    static std::shared_ptr<HRIRData> getShared(const char* path, bool memoryMap = true, const char* cachePath = nullptr);
+    /** get the minimum phase hrir data (at full's sample rate) shared by all plugin instances, loaded from the cache file at cachePath if it is there, otherwise made from the full data on a background thread and then saved to cachePath */
+    static std::shared_ptr<HRIRData> getSharedMinimumPhase(std::shared_ptr<HRIRData> full, const char* cachePath, bool memoryMap = true);
+    /** get the full hrir data resampled to sampleRate shared by all plugin instances, loaded from the cache file at cachePath if it is there, otherwise made from the full data on a background thread and then saved to cachePath */
+    static std::shared_ptr<HRIRData> getSharedResampled(std::shared_ptr<HRIRData> full, double sampleRate, const char* cachePath, bool memoryMap = true);
+    /** load the binary hrir data file on a background thread, isReady() becomes true once it is done */
+    void loadAsync(const char* path, bool memoryMap = true);
+    /** load a binary hrir data file (full or minimum phase), either by memory mapping it or with one bulk read (also the fallback if mapping fails), returns false and loads zeros if the file could not be read */
+    bool load(const char* path, bool memoryMap = true);
+    /** save the data in its stored precision with the same layout as the original file followed by the onset delays if there are any, a file saved with half precision can then be memory mapped */
+    bool save(const char* path) const;
+    /** make minimum phase hrirs of the given length from the (loaded) full data by folding each hrir's real cepstrum, each hrir's onset delay is taken from the peak of its cross-correlation with its minimum phase version */
+    void makeMinimumPhase(const HRIRData& full, int newLength);
+    /** make full hrirs at this data's sample rate from the (loaded) full data at its own by windowed sinc interpolation, scaled so they filter with the same gain */
+    void makeResampled(const HRIRData& full);
+    /** the error from converting the loaded file's samples to the stored precision, for checking the quality of half precision storage against full precision data (also known when a converted cache was loaded instead, it is saved along with it) */
+    const ConversionError& getConversionError() const noexcept { return conversionError; }
+    /** load up silent hrirs */
+    void loadZeros();
+    /** free all memory */
+    void free() noexcept;
+    /** the loading state, safe to call from any thread */
+    State getState() const noexcept { return state.load(std::memory_order_acquire); }
+    /** true once loading is done (zeros or otherwise) and the hrirs may be read from any thread */
+    bool isReady() const noexcept { const auto s = getState(); return s == State::LOADED || s == State::FAILED; }
+    /** true if there is data (zeros or otherwise) to read from */
+    bool isLoaded() const noexcept { return data != nullptr; }
+    /** true if the data is read straight from a memory mapped file */
+    bool isMemoryMapped() const noexcept { return mappedFile != nullptr; }
+    /** number of samples in each hrir */
+    int getLength() const noexcept { return length; }
+    /** the sample rate the hrirs are at, sampleRate_HRTF unless they were resampled */
+    double getSampleRate() const noexcept { return sampleRate; }
+    /** the length of hrirs at toSampleRate that last as long as length samples at fromSampleRate, rounded up to a multiple of 32 for weightedSum() */
+    static int scaleLength(int length, double fromSampleRate, double toSampleRate) noexcept;
+    /** true for minimum phase data whose onset delays must be applied separately */
+    bool hasDelays() const noexcept { return delays != nullptr; }
+    /** the left ear's hrir for a distance, azimuth, and elevation index, the right ear's follows it at +getLength(). note that elevation index e (1 to numElevationSteps-1) is stored at e-1 */
+    const Sample* getHRIR(const int d, const int a, const int e) const noexcept
+    {
+        return &data[d * distanceStride + a * azimuthStride + e * elevationStride];
+    }
+    /** the left ear's hrir for a distance index and pole (0 -> ele = 0, 1 -> ele = 180), the right ear's follows it at +getLength() */
+    const Sample* getPole(const int d, const int pole) const noexcept
+    {
+        return &poles[d * poleDistanceStride + pole * poleStride];
+    }
+    /** the left ear's hrir for a distance index and a direction index (see numDirections), the right ear's follows it at +getLength() */
+    const Sample* getHRIR(const int d, const int direction) const noexcept
+    {
+        if (direction < numDirections - 2)
+            return &data[d * distanceStride + direction * elevationStride];
+        return getPole(d, direction - (numDirections - 2));
+    }
+    /** the onset delay (in samples) of an hrir (either ear) from getHRIR() or getPole(), only if hasDelays() */
+    float getDelay(const Sample* hrir) const noexcept
+    {
+        if (hrir >= data && hrir < data + dataSize)
+            return delays[(hrir - data) / channelStride];
+        return poleDelays[(hrir - poles) / poleStride];
+    }
+    /** out[n] = sum of weights[i] * hrirs[i][n] for n = 0 to length-1 (a multiple of 32), with the samples decoded to floats using simd instructions where available.
+        returns the sum of |out[n]| found along the way, and if normalize is set out is divided by it (unless it is 0). works on half (std::uint16_t) or float samples */
+    template <typename T>
+    static float weightedSum(const T* const* hrirs, const float* weights, int numHRIRs, int length, float* out, bool normalize = false) noexcept;
+private:
+    void setLength(int newLength) noexcept;
+    void clear() noexcept;
+    bool allocate();
+    bool loadFile(const char* path, bool memoryMap);
+    bool map(const char* path);
+    bool read(const char* path);
+    template <typename FileSample>
+    bool read(std::istream& is, bool withDelays);
+    void loadConverted(const std::string& path, const std::string& cachePath, bool memoryMap);
+    void loadMinimumPhase(const std::shared_ptr<HRIRData>& full, const std::string& cachePath, bool memoryMap);
+    void loadResampled(const std::shared_ptr<HRIRData>& full, const std::string& cachePath, bool memoryMap);
+    // save to a temporary file first so that no other process ever loads a partially written cache
+    void saveCache(const std::string& cachePath) const;
+    void waitForLoader();
+    double sampleRate = sampleRate_HRTF;
+    // strides (in samples) between neighboring hrirs, the left ear's hrir is always followed by the right ear's
+    int length;
+    std::size_t channelStride, elevationStride, azimuthStride, distanceStride, dataSize;
+    // each distance has two poles (ele = 0 and ele = 180) of one hrir pair each
+    std::size_t poleStride, poleDistanceStride, polesSize;
+    // the data used for processing, either points to ownedData or the mapped file
+    const Sample* data = nullptr;
+    Sample* ownedData = nullptr;
+    Sample* poles = nullptr;
+    // onset delay for each of the data's hrirs (in the same order), either points to ownedDelays or the mapped file, and one for each pole
+    const float* delays = nullptr;
+    std::vector<float> ownedDelays;
+    std::vector<float> poleDelays;
+    std::unique_ptr<MemoryMappedFile> mappedFile;
+    ConversionError conversionError;
+    std::atomic<State> state {State::NOT_LOADED};
+    std::thread loader;
+};
+
+#endif /* defined(__HRIRData__) */
@@ -0,0 +1,315 @@
+//
+//  HRIRSphericalHarmonics.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "HRIRSphericalHarmonics.h"
+#include "HRIRStencils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+constexpr int HRIRSphericalHarmonics::maxOrder;
+constexpr int HRIRSphericalHarmonics::maxNumCoefficients;
+constexpr int HRIRSphericalHarmonics::defaultOrder;
+
+HRIRSphericalHarmonics::HRIRSphericalHarmonics(std::shared_ptr<HRIRData> data, const int order)
+    : data (std::move(data)),
+      order (std::max(0, std::min(order, maxOrder))),
+      numCoefficients ((this->order + 1) * (this->order + 1))
+{
+    fitter = std::thread([this] { fit(); });
+}
+
+HRIRSphericalHarmonics::~HRIRSphericalHarmonics()
+{
+    shouldExit = true;
+    if (fitter.joinable())
+        fitter.join();
+}
+
+std::shared_ptr<HRIRSphericalHarmonics> HRIRSphericalHarmonics::getShared(std::shared_ptr<HRIRData> data, const int order)
+{
+    // one fit per hrir data set and order, which only lives as long as someone holds a reference to it
+    static std::mutex lock;
+    static std::vector<std::weak_ptr<HRIRSphericalHarmonics>> shared;
+    const std::lock_guard<std::mutex> guard (lock);
+    shared.erase(std::remove_if(shared.begin(), shared.end(), [] (const std::weak_ptr<HRIRSphericalHarmonics>& p) { return p.expired(); }), shared.end());
+    for (const auto& p : shared) {
+        auto sh = p.lock();
+        if (sh && sh->getHRIRData() == data.get() && sh->getOrder() == order)
+            return sh;
+    }
+    auto sh = std::make_shared<HRIRSphericalHarmonics>(std::move(data), order);
+    shared.push_back(sh);
+    return sh;
+}
+
+template <typename T>
+void HRIRSphericalHarmonics::evaluateBasis(const int order, const T theta, const T phi, T* y) noexcept
+{
+    // fully normalized associated legendre functions by the usual (stable) recurrences along l for each m, times sqrt(2)*cos(m*phi) for m > 0 and sqrt(2)*sin(|m|*phi) for m < 0
+    const T x = std::cos(theta), s = std::sin(theta);
+    const T cos1 = std::cos(phi), sin1 = std::sin(phi);
+    const T sqrt2 = std::sqrt(T(2));
+    T pmm = T(1) / std::sqrt(T(4 * M_PI));
+    T cosm = 1, sinm = 0;
+    for (int m = 0; m <= order; ++m) {
+        if (m > 0) {
+            pmm *= std::sqrt(T(2*m + 1) / T(2*m)) * s;
+            const T c = cosm * cos1 - sinm * sin1;
+            sinm = sinm * cos1 + cosm * sin1;
+            cosm = c;
+        }
+        const T cosWeight = m == 0 ? T(1) : sqrt2 * cosm;
+        const T sinWeight = sqrt2 * sinm;
+        T p2 = 0, p1 = 0;
+        for (int l = m; l <= order; ++l) {
+            T p;
+            if (l == m)
+                p = pmm;
+            else if (l == m + 1)
+                p = std::sqrt(T(2*m + 3)) * x * pmm;
+            else
+                p = std::sqrt(T(4*l*l - 1) / T(l*l - m*m)) * (x * p1 - std::sqrt(T((l-1)*(l-1) - m*m) / T(4*(l-1)*(l-1) - 1)) * p2);
+            p2 = p1;
+            p1 = p;
+            y[l*l + l + m] = p * cosWeight;
+            if (m > 0)
+                y[l*l + l - m] = p * sinWeight;
+        }
+    }
+}
+
+template void HRIRSphericalHarmonics::evaluateBasis(int, float, float, float*) noexcept;
+template void HRIRSphericalHarmonics::evaluateBasis(int, double, double, double*) noexcept;
+
+void HRIRSphericalHarmonics::fit()
+{
+    while (!data->isReady()) {
+        if (shouldExit)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    length = data->getLength();
+    const int n = numCoefficients;
+    const bool withDelays = data->hasDelays();
+
+    // sample at every grid direction over the whole sphere (reversed azimuth indexing like the hrir data and stencils, the stored side with its channels swapped
+    // for the other side) plus the two poles, each weighted by the patch of sphere around it so the dense rings near the poles don't dominate the fit
+    struct Point
+    {
+        int direction;
+        int channel; // the stored channel for the left ear
+        double area;
+    };
+    std::vector<Point> points;
+    std::vector<double> basis; // [point][coefficient]
+    const double dTheta = M_PI / numElevationSteps, dPhi = 2 * M_PI / numAzimuthSteps;
+    const auto addPoint = [&] (const int direction, const int channel, const double area, const double theta, const double phi)
+    {
+        points.push_back({direction, channel, area});
+        basis.resize(basis.size() + n);
+        evaluateBasis(order, theta, phi, &basis[basis.size() - n]);
+    };
+    for (int a = 0; a < numAzimuthSteps; ++a) {
+        const bool otherSide = a > numAzimuthSteps / 2;
+        const int storedA = otherSide ? numAzimuthSteps - a : a;
+        for (int e = 1; e < numElevationSteps; ++e)
+            addPoint(storedA * HRIRData::numElevations + e - 1, otherSide, std::sin(e * dTheta) * dTheta * dPhi, e * dTheta, a * dPhi);
+    }
+    const double capArea = 2 * M_PI * (1 - std::cos(dTheta / 2));
+    addPoint(HRIRData::numDirections - 2, 0, capArea, 0, 0);
+    addPoint(HRIRData::numDirections - 1, 0, capArea, M_PI, 0);
+    const int numPoints = (int)points.size();
+
+    // least squares, coefficients = G^-1 * Y^T * W * hrirs with the gram matrix G = Y^T * W * Y. the projection onto the coefficients is the same for every
+    // shell, ear, and tap so it is worked out once up front (with a touch of regularization in case the order is too high for the grid)
+    std::vector<double> gram (n * n, 0.0);
+    for (int i = 0; i < numPoints; ++i) {
+        const double* const y = &basis[i*n];
+        for (int j = 0; j < n; ++j)
+            for (int k = 0; k <= j; ++k)
+                gram[j*n + k] += points[i].area * y[j] * y[k];
+    }
+    for (int j = 0; j < n; ++j)
+        for (int k = 0; k < j; ++k)
+            gram[k*n + j] = gram[j*n + k];
+    std::vector<double> cholesky (gram);
+    for (int k = 0; k < n; ++k)
+        cholesky[k*n + k] += 1e-9 * 4 * M_PI;
+    for (int j = 0; j < n; ++j) {
+        for (int k = 0; k < j; ++k)
+            cholesky[j*n + j] -= cholesky[j*n + k] * cholesky[j*n + k];
+        cholesky[j*n + j] = std::sqrt(cholesky[j*n + j]);
+        for (int i = j + 1; i < n; ++i) {
+            for (int k = 0; k < j; ++k)
+                cholesky[i*n + j] -= cholesky[i*n + k] * cholesky[j*n + k];
+            cholesky[i*n + j] /= cholesky[j*n + j];
+        }
+    }
+    std::vector<float> projection (n * numPoints); // [coefficient][point]
+    std::vector<double> column (n);
+    for (int i = 0; i < numPoints; ++i) {
+        for (int j = 0; j < n; ++j) {
+            double v = points[i].area * basis[i*n + j];
+            for (int k = 0; k < j; ++k)
+                v -= cholesky[j*n + k] * column[k];
+            column[j] = v / cholesky[j*n + j];
+        }
+        for (int j = n - 1; j >= 0; --j) {
+            double v = column[j];
+            for (int k = j + 1; k < n; ++k)
+                v -= cholesky[k*n + j] * column[k];
+            column[j] = v / cholesky[j*n + j];
+        }
+        for (int j = 0; j < n; ++j)
+            projection[j*numPoints + i] = (float)column[j];
+    }
+
+    // each coefficient's filter is a weighted sum of the shell's hrirs, done by HRIRData::weightedSum() over blocks of points small enough to stay in cache
+    // while all the coefficients are worked out from them
+    constexpr int blockSize = 64;
+    const HRIRData::Sample* block[2][blockSize]; // [ear][point]
+    std::vector<float> coefficients (2 * n * length), partial (length);
+    std::vector<double> delaySums (2 * n);
+    filters.resize(2 * numDistanceSteps * n * length);
+    if (withDelays)
+        delayCoefficients.resize(2 * numDistanceSteps * n);
+    double energy = 0, fittedEnergy = 0;
+    for (int d = 0; d < numDistanceSteps; ++d) {
+        if (shouldExit)
+            return;
+        std::fill(coefficients.begin(), coefficients.end(), 0.0f);
+        std::fill(delaySums.begin(), delaySums.end(), 0.0);
+        for (int begin = 0; begin < numPoints; begin += blockSize) {
+            const int size = std::min(blockSize, numPoints - begin);
+            for (int j = 0; j < size; ++j) {
+                const Point& point = points[begin + j];
+                const HRIRData::Sample* const stored = data->getHRIR(d, point.direction);
+                block[0][j] = stored +      point.channel  * length;
+                block[1][j] = stored + (1 - point.channel) * length;
+                double hrirEnergy = 0;
+                for (int t = 0; t < 2 * length; ++t) {
+                    const double x = simd::toFloat(stored[t]);
+                    hrirEnergy += x * x;
+                }
+                energy += point.area * hrirEnergy;
+            }
+            for (int ear = 0; ear < 2; ++ear) {
+                for (int k = 0; k < n; ++k) {
+                    const float* const weights = &projection[k*numPoints + begin];
+                    HRIRData::weightedSum(block[ear], weights, size, length, &partial[0]);
+                    float* const row = &coefficients[(ear*n + k) * length];
+                    for (int t = 0; t < length; ++t)
+                        row[t] += partial[t];
+                    if (withDelays)
+                        for (int j = 0; j < size; ++j)
+                            delaySums[ear*n + k] += weights[j] * data->getDelay(block[ear][j]);
+                }
+            }
+        }
+        for (int ear = 0; ear < 2; ++ear) {
+            const float* const c = &coefficients[ear * n * length];
+            // the least squares residual is whatever energy the fit (c^T * G * c) doesn't account for
+            for (int j = 0; j < n; ++j) {
+                for (int k = 0; k < n; ++k) {
+                    double dot = 0;
+                    for (int t = 0; t < length; ++t)
+                        dot += c[j*length + t] * c[k*length + t];
+                    fittedEnergy += gram[j*n + k] * dot;
+                }
+            }
+            HRIRData::Sample* const out = &filters[(ear * numDistanceSteps + d) * n * length];
+            for (int i = 0; i < n * length; ++i)
+                simd::convert(c[i], out[i]);
+            if (withDelays)
+                for (int k = 0; k < n; ++k)
+                    delayCoefficients[(ear * numDistanceSteps + d) * n + k] = (float)delaySums[ear*n + k];
+        }
+    }
+    fitError = energy > 0 ? (float)std::sqrt(std::max(0.0, energy - fittedEnergy) / energy) : 0;
+
+    rows.resize(2 * numDistanceSteps * n);
+    for (int r = 0; r < (int)rows.size(); ++r)
+        rows[r] = &filters[r * length];
+    ready.store(true, std::memory_order_release);
+}
+
+void HRIRSphericalHarmonics::interpolateHRIR(const float* rae, float* hrir, float* delays, float* scaling) const noexcept
+{
+    const HRIRStencils& stencils = HRIRStencils::get();
+    const int n = numCoefficients;
+    const int innerRadiusIndex = stencils.getInnerRadiusIndex(rae[0]);
+    const float rIn  = stencils.getRadius(innerRadiusIndex);
+    const float rOut = stencils.getRadius(innerRadiusIndex + 1);
+    // for making close/far more loud/quiet
+    const float intensity_factor = 0.1f / std::sqrt(rae[0]);
+    const float mu3 = std::min((rae[0]-rIn)/(rOut-rIn), 1.0f);
+
+    // the basis is periodic in azimuth, so no wrapping of the reversed azimuth needed
+    float y[maxNumCoefficients];
+    evaluateBasis(order, rae[2], (float)(2*M_PI) - rae[1], y);
+    // the inner and outer shell's basis filters are weighted in one go, the matrix-vector product is done by HRIRData::weightedSum() with the filters as rows
+    float weights[2 * maxNumCoefficients];
+    for (int k = 0; k < n; ++k) {
+        weights[k]     = (1 - mu3) * intensity_factor * y[k];
+        weights[n + k] =       mu3 * intensity_factor * y[k];
+    }
+    for (int ear = 0; ear < 2; ++ear) {
+        const float sum = HRIRData::weightedSum(&rows[(ear * numDistanceSteps + innerRadiusIndex) * n], weights, 2 * n, length, &hrir[ear * maxNumTimeSteps], scaling != nullptr);
+        if (scaling)
+            scaling[ear] = sum;
+    }
+    if (delays && !delayCoefficients.empty()) {
+        for (int ear = 0; ear < 2; ++ear) {
+            const float* const c = &delayCoefficients[(ear * numDistanceSteps + innerRadiusIndex) * n];
+            float delay = 0;
+            for (int k = 0; k < n; ++k)
+                delay += ((1 - mu3) * c[k] + mu3 * c[n + k]) * y[k];
+            delays[ear] = delay;
+        }
+    }
+}
+
+void HRIRSphericalHarmonics::interpolateBasisFilters(const float r, float* basisFilters) const noexcept
+{
+    const HRIRStencils& stencils = HRIRStencils::get();
+    const int n = numCoefficients;
+    const int innerRadiusIndex = stencils.getInnerRadiusIndex(r);
+    const float rIn  = stencils.getRadius(innerRadiusIndex);
+    const float rOut = stencils.getRadius(innerRadiusIndex + 1);
+    const float intensity_factor = 0.1f / std::sqrt(r);
+    const float mu3 = std::min((r-rIn)/(rOut-rIn), 1.0f);
+    for (int k = 0; k < n; ++k) {
+        for (int ear = 0; ear < 2; ++ear) {
+            const HRIRData::Sample* const inner = rows[(ear * numDistanceSteps + innerRadiusIndex) * n + k];
+            const HRIRData::Sample* const outer = rows[(ear * numDistanceSteps + innerRadiusIndex) * n + n + k];
+            float* const filter = &basisFilters[(2 * k + ear) * maxNumTimeSteps];
+            for (int t = 0; t < length; ++t)
+                filter[t] = intensity_factor * ((1 - mu3) * simd::toFloat(inner[t]) + mu3 * simd::toFloat(outer[t]));
+            std::fill(filter + length, filter + maxNumTimeSteps, 0.0f);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+//
+//  HRIRSphericalHarmonics.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __HRIRSphericalHarmonics__
+#define __HRIRSphericalHarmonics__
+
+#include "HRIRData.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// each distance shell of the hrir data (and its onset delays, if it has them) least squares fitted to real spherical harmonics up to some order, so each ear
+// of a shell is just (order+1)^2 basis filters. an hrir for any direction is then the basis filters weighted by the spherical harmonics evaluated at that
+// direction (blended between the inner and outer shell like the grid interpolation), which costs the same anywhere on the sphere no matter how dense the
+// grid is and has no seams at the poles or where the azimuth wraps around. the fit takes a few seconds so it is done on a background thread.
+class HRIRSphericalHarmonics
+{
+public:
+    // the fit goes up to order 15 (past that the 2 degree grid doesn't pin the higher orders down well and evaluating gets pricey)
+    static constexpr int maxOrder = 15;
+    static constexpr int maxNumCoefficients = (maxOrder + 1) * (maxOrder + 1);
+    // what the plugin uses, 81 basis filters per shell and ear
+    static constexpr int defaultOrder = 8;
+
+    /** starts fitting the hrir data (once it is ready) up to order on a background thread, isReady() becomes true once it is done */
+    HRIRSphericalHarmonics(std::shared_ptr<HRIRData> data, int order);
+    ~HRIRSphericalHarmonics();
+    HRIRSphericalHarmonics(const HRIRSphericalHarmonics&) = delete;
+    HRIRSphericalHarmonics& operator=(const HRIRSphericalHarmonics&) = delete;
+    /** get the fit of an hrir data set at an order shared by all plugin instances, the first call (or the first after all previous references were released) starts fitting it */
+    static std::shared_ptr<HRIRSphericalHarmonics> getShared(std::shared_ptr<HRIRData> data, int order = defaultOrder);
+    /** true once the fit is done and interpolateHRIR() may be called from any thread */
+    bool isReady() const noexcept { return ready.load(std::memory_order_acquire); }
+    /** the hrir data that was fitted */
+    const HRIRData* getHRIRData() const noexcept { return data.get(); }
+    int getOrder() const noexcept { return order; }
+    int getNumCoefficients() const noexcept { return numCoefficients; }
+    /** bytes taken up by the basis filters and delay coefficients */
+    std::size_t getMemorySize() const noexcept { return filters.size() * sizeof(HRIRData::Sample) + delayCoefficients.size() * sizeof(float); }
+    /** rms error of the fitted hrirs relative to the rms of the hrir data, over the whole sphere and all distances (once ready) */
+    float getFitError() const noexcept { return fitError; }
+    /** same as PlayableSoundSource::interpolateHRIR() (without the cache), except the hrir comes from the fit */
+    void interpolateHRIR(const float* rae, float* hrir, float* delays = nullptr, float* scaling = nullptr) const noexcept;
+    /** the basis filters of the shells around distance r blended (and scaled for distance) like interpolateHRIR() does, [coefficient][ear][maxNumTimeSteps]. the
+        hrir for a direction is these weighted by the spherical harmonics at it, so they also decode an ambisonic sound field to binaural */
+    void interpolateBasisFilters(float r, float* basisFilters) const noexcept;
+    /** the real spherical harmonics up to order at polar angle theta and azimuth phi, indexed l*l + l + m, orthonormal over the sphere */
+    template <typename T>
+    static void evaluateBasis(int order, T theta, T phi, T* y) noexcept;
+
+private:
+    void fit();
+    std::shared_ptr<HRIRData> data;
+    const int order;
+    const int numCoefficients;
+    int length = 0;
+    // the basis filters [ear][distance][coefficient][length] stored at the same precision as the hrir data, and their row pointers in the same order so the
+    // inner and outer shell's rows of an ear are contiguous
+    std::vector<HRIRData::Sample> filters;
+    std::vector<const HRIRData::Sample*> rows;
+    // fitted onset delays [ear][distance][coefficient] (only if the hrir data has them)
+    std::vector<float> delayCoefficients;
+    float fitError = 0;
+    std::atomic<bool> ready {false};
+    std::atomic<bool> shouldExit {false};
+    std::thread fitter;
+};
+
+#endif /* defined(__HRIRSphericalHarmonics__) */
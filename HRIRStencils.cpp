@@ -0,0 +1,91 @@
+//
+//  HRIRStencils.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+     
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+     
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+     
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+     
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "HRIRStencils.h"
+#include "HRIRData.h"
+#include <algorithm>
+#include <cmath>
+
+const HRIRStencils& HRIRStencils::get()
+{
+    static const HRIRStencils instance;
+    return instance;
+}
+
+HRIRStencils::HRIRStencils()
+    : stencils (numAzimuthSteps * numElevationSteps * 2 * 2 * numNeighbors)
+{
+    for (int d = 0; d < numDistanceSteps; ++d)
+        radii[d] = distanceBegin * std::pow(distanceEnd / distanceBegin, ((float)d) / (numDistanceSteps - 1));
+    
+    // the stored neighbor for an azimuth index around the whole circle and an elevation index that may have gone past a pole (and then
+    // comes back down on the opposite azimuth), only one azimuth side is stored so the other side uses the other channel
+    const auto neighbor = [] (int a, int e) -> Neighbor
+    {
+        if (e < 0 || e > numElevationSteps) {
+            e = e < 0 ? -e : 2 * numElevationSteps - e;
+            a += numAzimuthSteps / 2;
+        }
+        if (e == 0 || e == numElevationSteps)
+            return (HRIRData::numDirections - 2 + e / numElevationSteps) << 1;
+        a = (a % numAzimuthSteps + numAzimuthSteps) % numAzimuthSteps;
+        int channel = 0;
+        if (a > numAzimuthSteps / 2) {
+            a = numAzimuthSteps - a;
+            channel = 1;
+        }
+        return (a * HRIRData::numElevations + e - 1) << 1 | channel;
+    };
+    
+    for (int a = 0; a < numAzimuthSteps; ++a) {
+        for (int e = 0; e < numElevationSteps; ++e) {
+            for (int azimuthHalf = 0; azimuthHalf < 2; ++azimuthHalf) {
+                for (int elevationHalf = 0; elevationHalf < 2; ++elevationHalf) {
+                    Neighbor* stencil = &stencils[(((a * numElevationSteps + e) * 2 + azimuthHalf) * 2 + elevationHalf) * numNeighbors];
+                    // the nearby interpolations are shifted one index towards the closer side of the cell
+                    const int nearbyA = azimuthHalf ? a : a - 2;
+                    const int nearbyE = elevationHalf ? e : e - 2;
+                    for (const int azimuth : {a + 1, a}) {
+                        for (int k = 0; k < 4; ++k)
+                            *stencil++ = neighbor(azimuth, nearbyE + k);
+                        for (int k = 0; k < 4; ++k)
+                            *stencil++ = neighbor(azimuth, e - 1 + k);
+                    }
+                    for (const int elevation : {e + 1, e}) {
+                        for (int k = 0; k < 4; ++k)
+                            *stencil++ = neighbor(nearbyA + k, elevation);
+                        for (int k = 0; k < 4; ++k)
+                            *stencil++ = neighbor(a - 1 + k, elevation);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int HRIRStencils::getInnerRadiusIndex(const float r) const noexcept
+{
+    return (int)(std::upper_bound(&radii[1], &radii[numDistanceSteps - 1], r) - &radii[1]);
+}
@@ -0,0 +1,61 @@
+//
+//  HRIRStencils.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+     
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+     
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+     
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+     
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __HRIRStencils__
+#define __HRIRStencils__
+
+#include "Data.h"
+#include <cstdint>
+#include <vector>
+
+// the 64 neighboring hrirs that an interpolated hrir is a weighted sum of (see PlayableSoundSource::interpolateHRIR()) only depend on the
+// azimuth/elevation cell of the grid that the direction is in, which half of that cell it is in along azimuth and along elevation, and the
+// distance cell. the angular part (which stored hrirs and which of their channels) is worked out once here for every cell and half instead
+// of for every interpolation, the inner and outer distance just pick which distance index to read the stencil's hrirs at.
+class HRIRStencils
+{
+public:
+    // along each of the 2 bounding azimuths 4 elevation neighbors for the nearby and 4 for the in-region interpolation, then the same along each of the 2 bounding elevations
+    static constexpr int numNeighbors = 32;
+    // HRIRData direction index << 1 | the stored channel to use for the left ear (the right ear uses the other one)
+    using Neighbor = std::uint16_t;
+    /** the stencils shared by everyone, built by the first call (so make that one off the audio thread) */
+    static const HRIRStencils& get();
+    /** the numNeighbors neighbors for an azimuth cell (0 to numAzimuthSteps-1, counting reversed azimuths like the hrir data does), an elevation cell (0 to numElevationSteps-1), and which half of the cell the direction is in */
+    const Neighbor* getStencil(const int azimuthCell, const int elevationCell, const bool upperAzimuthHalf, const bool upperElevationHalf) const noexcept
+    {
+        return &stencils[(((azimuthCell * numElevationSteps + elevationCell) * 2 + upperAzimuthHalf) * 2 + upperElevationHalf) * numNeighbors];
+    }
+    /** the radius (in meters) of a distance index */
+    float getRadius(const int d) const noexcept { return radii[d]; }
+    /** the inner distance index (0 to numDistanceSteps-2) of the distance cell a radius is in, radii outside of the grid get the closest cell */
+    int getInnerRadiusIndex(float r) const noexcept;
+private:
+    HRIRStencils();
+    std::vector<Neighbor> stencils;
+    float radii[numDistanceSteps];
+};
+
+#endif /* defined(__HRIRStencils__) */
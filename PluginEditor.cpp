@@ -110,6 +110,29 @@ ThreeDAudioProcessorEditor::ThreeDAudioProcessorEditor (ThreeDAudioProcessor* ow
     processingModeHelpLook.just = Justification::topLeft;
     processingModeHelp.setLook(&processingModeHelpLook);
     
+    hrirQualityNormalLook = processingModeNormalLook;
+    hrirQualitySelectedLook = processingModeSelectedLook;
+    hrirQualitySelectAnimationBeginLook = processingModeSelectAnimationBeginLook;
+    hrirQualityMouseOverLook = processingModeMouseOverLook;
+    for (auto* options : {&realTimeHRIRQualityOptions, &offlineHRIRQualityOptions, &renderingEngineOptions, &ambisonicOrderOptions, &sourceCapacityOptions, &resamplerQualityOptions, &dopplerModeOptions}) {
+        options->setNormalLook(&hrirQualityNormalLook);
+        options->setSelectedLook(&hrirQualitySelectedLook, &hrirQualitySelectAnimationBeginLook);
+        options->setMouseOverLook(&hrirQualityMouseOverLook);
+        options->setMouseOverAutoDetectLook(&hrirQualityMouseOverLook); // no auto-detect option, but setFontSize() needs one
+    }
+    realTimeHRIRQualityOptions.setSelected(static_cast<int>(processor->realTimeHRIRInterpolationQuality.load()), false);
+    offlineHRIRQualityOptions.setSelected(static_cast<int>(processor->offlineHRIRInterpolationQuality.load()), false);
+    renderingEngineOptions.setSelected(static_cast<int>(processor->renderingEngine.load()), false);
+    ambisonicOrderOptions.setSelected(processor->ambisonicOrder - 1, false);
+    sourceCapacityOptions.setSelected(getSourceCapacityOption(), false);
+    resamplerQualityOptions.setSelected(static_cast<int>(processor->resamplerQuality.load()), false);
+    dopplerModeOptions.setSelected(static_cast<int>(processor->dopplerMode.load()), false);
+    hrirQualityCostLook.color = popsicleGreen;
+    hrirQualityCostText.setLook(&hrirQualityCostLook);
+    
+    hrirDataStateLook.color = popsicleGreen;
+    hrirDataStateText.setLook(&hrirDataStateLook);
+    
     tabs.setSelected(static_cast<int>(processor->displayState.load()), false);
     loadHelpText();
     
@@ -169,6 +192,16 @@ ThreeDAudioProcessorEditor::ThreeDAudioProcessorEditor (ThreeDAudioProcessor* ow
    
     websiteButton.showsState = false;
     websiteButton.drawBoundary = false;
+    TextLook minimumPhaseLook;
+    minimumPhaseLook.fontSize = 18 * displayScale;
+    minimumPhaseButton.setTextLook(minimumPhaseLook);
+    minimumPhaseButton.setColor(popsicleGreen);
+    if (processor->minimumPhaseHRIRs)
+        minimumPhaseButton.press();
+    bakeLoopedPathHRIRsButton.setTextLook(minimumPhaseLook);
+    bakeLoopedPathHRIRsButton.setColor(popsicleGreen);
+    if (processor->bakeLoopedPathHRIRs)
+        bakeLoopedPathHRIRsButton.press();
 //    websiteMessageLook.multiLine = true;
 //    websiteMessage.setLook(&websiteMessageLook);
     //websiteMessage.setDrawMultiLine(true);
@@ -422,6 +455,14 @@ void ThreeDAudioProcessorEditor::resized()
 ////    }
 //}
 
+int ThreeDAudioProcessorEditor::getSourceCapacityOption() const
+{
+    int option = 0;
+    while ((2 << option) <= processor->sourceCapacity)
+        ++option;
+    return option;
+}
+
 void ThreeDAudioProcessorEditor::drawHelp()
 {
     if (helpButton.isDown() || helpButton.getPressAnimation().isPlaying()) {
@@ -2631,6 +2672,50 @@ void ThreeDAudioProcessorEditor::myResized()
     cauto right = len * 0.5f;
     websiteButton.setBoundary({top, bottom, left, right});
 }
+{
+    cauto fontSize = 18*displayScale;
+    cauto look = minimumPhaseButton.getTextLook();
+    cauto bottom = websiteButton.getBoundary().getTop() + pixelsToNormalized(15, getHeight());
+    cauto top = bottom + pixelsToNormalized(fontSize / look.verticalPad, getHeight()*displayScale);
+    cauto len = pixelsToNormalized(look.getFontWithSize(fontSize).getStringWidthFloat(minimumPhaseButton.getText()) / look.horizontalPad, getWidth()*displayScale);
+    cauto left = len * -0.5f;
+    cauto right = len * 0.5f;
+    minimumPhaseButton.setBoundary({top, bottom, left, right});
+}
+{
+    cauto fontSize = 18*displayScale;
+    cauto look = bakeLoopedPathHRIRsButton.getTextLook();
+    cauto bottom = minimumPhaseButton.getBoundary().getTop() + pixelsToNormalized(10, getHeight());
+    cauto top = bottom + pixelsToNormalized(fontSize / look.verticalPad, getHeight()*displayScale);
+    cauto len = pixelsToNormalized(look.getFontWithSize(fontSize).getStringWidthFloat(bakeLoopedPathHRIRsButton.getText()) / look.horizontalPad, getWidth()*displayScale);
+    cauto left = len * -0.5f;
+    cauto right = len * 0.5f;
+    bakeLoopedPathHRIRsButton.setBoundary({top, bottom, left, right});
+}
+{
+    // from the bottom up above the bake button: the cost of each hrir interpolation quality, then the quality options for each processing mode, then the
+    // rendering engine, ambisonic order, source capacity, resampling, and doppler options
+    cauto fontSize = 18*displayScale;
+    cauto rowHeight = pixelsToNormalized(fontSize / hrirQualityNormalLook.verticalPad, getHeight()*displayScale);
+    auto bottom = bakeLoopedPathHRIRsButton.getBoundary().getTop() + pixelsToNormalized(10, getHeight());
+    hrirQualityCostLook.fontSize = fontSize;
+    hrirQualityCostText.setLook(&hrirQualityCostLook);
+    hrirQualityCostText.setBoundary({bottom + rowHeight, bottom, -1 + pixelsToNormalized(50, getWidth()), 1 - pixelsToNormalized(50, getWidth())});
+    bottom += rowHeight + pixelsToNormalized(5, getHeight());
+    for (auto* options : {&offlineHRIRQualityOptions, &realTimeHRIRQualityOptions, &renderingEngineOptions, &ambisonicOrderOptions, &sourceCapacityOptions, &resamplerQualityOptions, &dopplerModeOptions}) {
+        options->setFontSize(fontSize);
+        cauto font = hrirQualityNormalLook.getFontWithSize(fontSize);
+        cauto titleLen = pixelsToNormalized(font.getStringWidthFloat(options->title.getText()) / hrirQualityNormalLook.horizontalPad, getWidth()*displayScale);
+        float optionsLen = 0;
+        for (const auto& b : options->getTextBoxes())
+            optionsLen += pixelsToNormalized(font.getStringWidthFloat(b.getText()) / hrirQualityNormalLook.horizontalPad, getWidth()*displayScale);
+        cauto top = bottom + rowHeight;
+        cauto left = -0.5f * (titleLen + optionsLen);
+        options->title.setBoundary({top, bottom, left, left + titleLen});
+        options->setBoundary({top, bottom, left + titleLen, left + titleLen + optionsLen});
+        bottom = top;
+    }
+}
 //    b = positionerText.getBoundary();
 //    b.setTop(b.getBottom() + pixelsToNormalized(16, getHeight()) / positionerText.getLook()->verticalPad);
 //    positionerText.setBoundary(b);
@@ -2723,6 +2808,10 @@ void ThreeDAudioProcessorEditor::renderOpenGL()
         if (processor->presetJustLoaded) {
             if (processor->dopplerOn != dopplerButton.isDown())
                 dopplerButton.press();
+            if (processor->minimumPhaseHRIRs != minimumPhaseButton.isDown())
+                minimumPhaseButton.press();
+            if (processor->bakeLoopedPathHRIRs != bakeLoopedPathHRIRsButton.isDown())
+                bakeLoopedPathHRIRsButton.press();
             resizePathPtsPrevState();
             reindexPathIndexTexts();
             tryHidePositioner3D();
@@ -2808,6 +2897,68 @@ void ThreeDAudioProcessorEditor::renderOpenGL()
 
                 //etb.draw(glWindow, mousePos);
 
+                for (auto* options : {&realTimeHRIRQualityOptions, &offlineHRIRQualityOptions}) {
+                    options->setSelected((int)(options == &realTimeHRIRQualityOptions ? processor->realTimeHRIRInterpolationQuality.load()
+                                                                                        : processor->offlineHRIRInterpolationQuality.load()), false);
+                    options->draw(glWindow, mousePos);
+                    glColor3f(1, 1, 1);
+                    options->getTextBoxes()[options->getSelected()].getBoundary().drawOutline();
+                }
+                renderingEngineOptions.setSelected((int)processor->renderingEngine.load(), false);
+                renderingEngineOptions.draw(glWindow, mousePos);
+                glColor3f(1, 1, 1);
+                renderingEngineOptions.getTextBoxes()[renderingEngineOptions.getSelected()].getBoundary().drawOutline();
+                ambisonicOrderOptions.setSelected(processor->ambisonicOrder - 1, false);
+                ambisonicOrderOptions.draw(glWindow, mousePos);
+                glColor3f(1, 1, 1);
+                ambisonicOrderOptions.getTextBoxes()[ambisonicOrderOptions.getSelected()].getBoundary().drawOutline();
+                sourceCapacityOptions.setSelected(getSourceCapacityOption(), false);
+                sourceCapacityOptions.draw(glWindow, mousePos);
+                glColor3f(1, 1, 1);
+                sourceCapacityOptions.getTextBoxes()[sourceCapacityOptions.getSelected()].getBoundary().drawOutline();
+                resamplerQualityOptions.setSelected((int)processor->resamplerQuality.load(), false);
+                resamplerQualityOptions.draw(glWindow, mousePos);
+                glColor3f(1, 1, 1);
+                resamplerQualityOptions.getTextBoxes()[resamplerQualityOptions.getSelected()].getBoundary().drawOutline();
+                dopplerModeOptions.setSelected((int)processor->dopplerMode.load(), false);
+                dopplerModeOptions.draw(glWindow, mousePos);
+                glColor3f(1, 1, 1);
+                dopplerModeOptions.getTextBoxes()[dopplerModeOptions.getSelected()].getBoundary().drawOutline();
+                // only actually measures the first time with each hrir data (it takes a few milliseconds)
+                processor->measureHRIRInterpolationCosts();
+                if (processor->hrirInterpolationCosts[0] < 0) {
+                    hrirQualityCostText.setText("HRIR interpolation cost: waiting for the HRTF data to load");
+                } else {
+                    std::string text = "HRIR interpolation cost:";
+                    for (int q = 0; q < (int)processor->hrirInterpolationCosts.size(); ++q) {
+                        cauto cost = processor->hrirInterpolationCosts[q].load();
+                        text += "  " + realTimeHRIRQualityOptions.getTextBoxes()[q].getText() + " " + (cost < 0 ? std::string("-") : StrFuncs::roundedFloatString(cost, 2) + " us");
+                    }
+                    if (processor->bakeLoopedPathHRIRs)
+                        text += "  (baked: " + StrFuncs::roundedFloatString(processor->getBakedHRIRsMemorySize() / (1024.0f*1024.0f), 1) + " MB)";
+                    if (processor->dopplerOn) {
+                        std::size_t dopplerMemory = 0, maxDopplerMemory = 0;
+                        for (int s = 0; s < processor->sourceCapacity; ++s) {
+                            cauto sourceDopplerMemory = processor->getDopplerMemorySize(s);
+                            dopplerMemory += sourceDopplerMemory;
+                            maxDopplerMemory = std::max(maxDopplerMemory, sourceDopplerMemory);
+                        }
+                        text += "  (doppler: " + StrFuncs::roundedFloatString(maxDopplerMemory / 1024.0f, 0) + " KB per source at most, "
+                              + StrFuncs::roundedFloatString(dopplerMemory / 1024.0f, 0) + " KB total)";
+                    }
+                    if (cauto conversionError = processor->getHRIRConversionError()) {
+                        if (conversionError->lossy)
+                            text += "  (hrtf data: " + (std::isinf(conversionError->signalToErrorDB) ? std::string("lossless")
+                                  : StrFuncs::roundedFloatString(conversionError->signalToErrorDB, 1) + " dB signal to error") + ")";
+                    }
+                    if (processor->getLatencySamples() > 0)
+                        text += "  (resampling latency: " + std::to_string(processor->getLatencySamples()) + " samples)";
+                    hrirQualityCostText.setText(text);
+                }
+                hrirQualityCostText.draw(glWindow);
+
+                bakeLoopedPathHRIRsButton.draw(glWindow, mousePos);
+                minimumPhaseButton.draw(glWindow, mousePos);
                 websiteButton.draw(glWindow, mousePos);
                 //websiteMessage.draw(glWindow);
 
@@ -2836,6 +2987,19 @@ void ThreeDAudioProcessorEditor::renderOpenGL()
         tabs.mouseOverEnabled = !selectionBox.isActive()/*mouseDragging*/ && !loopRegionBeginSelected && !loopRegionEndSelected && !pathAutomationPointsGrabbedWithMouse;
         tabs.draw(glWindow, mousePos);
 
+        switch (processor->getHRIRDataState()) {
+            case HRIRData::State::LOADED:
+                break;
+            case HRIRData::State::FAILED:
+                hrirDataStateText.setText("HRTF data failed to load, try reinstalling the plugin");
+                hrirDataStateText.draw(glWindow);
+                break;
+            default:
+                hrirDataStateText.setText("Loading HRTF data...");
+                hrirDataStateText.draw(glWindow);
+                break;
+        }
+
         if (processor->displayState != DisplayState::SETTINGS) {
             cauto mouseOverEnabled =
             dopplerButton.mouseOverEnabled = !selectionBox.isActive()/*mouseDragging*/
@@ -3614,6 +3778,24 @@ void ThreeDAudioProcessorEditor::mouseUp(const MouseEvent & event)
                 if (selectedMode >= 0) {
                     processor->setProcessingMode((ProcessingMode)selectedMode);
                     processingModeOptions.setAutoDetected(processor->isHostRealTime ? 0 : 1);
+                } else if ((selectedMode = realTimeHRIRQualityOptions.mouseClicked()) >= 0) {
+                    processor->setHRIRInterpolationQuality(true, (HRIRInterpolationQuality)selectedMode);
+                } else if ((selectedMode = offlineHRIRQualityOptions.mouseClicked()) >= 0) {
+                    processor->setHRIRInterpolationQuality(false, (HRIRInterpolationQuality)selectedMode);
+                } else if ((selectedMode = renderingEngineOptions.mouseClicked()) >= 0) {
+                    processor->setRenderingEngine((RenderingEngine)selectedMode);
+                } else if ((selectedMode = ambisonicOrderOptions.mouseClicked()) >= 0) {
+                    processor->setAmbisonicOrder(selectedMode + 1);
+                } else if ((selectedMode = sourceCapacityOptions.mouseClicked()) >= 0) {
+                    processor->setSourceCapacity(1 << selectedMode);
+                } else if ((selectedMode = resamplerQualityOptions.mouseClicked()) >= 0) {
+                    processor->setResamplerQuality((ResamplerQuality)selectedMode);
+                } else if ((selectedMode = dopplerModeOptions.mouseClicked()) >= 0) {
+                    processor->setDopplerMode((DopplerMode)selectedMode);
+                } else if (minimumPhaseButton.mouseClicked()) {
+                    processor->setMinimumPhaseHRIRs(minimumPhaseButton.isDown());
+                } else if (bakeLoopedPathHRIRsButton.mouseClicked()) {
+                    processor->bakeLoopedPathHRIRs = bakeLoopedPathHRIRsButton.isDown();
                 } else if (websiteButton.mouseClicked()) {
                     const URL url ("http://www.freedomaudioplugins.com");
                     url.launchInDefaultBrowser();
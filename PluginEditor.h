@@ -183,6 +183,8 @@ public:
     //void drawStringBitmap(void *font, char *s, float x, float y, float z) const;
     //void drawStringStroke(char *s, float x, float y, float z) const;
     std::string getFormattedTimeString(float timeInSec) const;
+    // which of sourceCapacityOptions the processor's source capacity is
+    int getSourceCapacityOption() const;
     //void getFormattedTime(float timeInSec, char* str) const;
     void timerCallback(int timerID) override;
     //void drawMouseDragging();
@@ -323,6 +325,12 @@ private:
     TextBoxGroup helpText {{}, 0, {.95f, -.95f, -1.0f, 1.0f}, &helpTextLook};
     
     GLTextButton websiteButton {"made by Freedom Audio", {-.85f, -.95f, -.5f, .5f}};
+    GLTextButton minimumPhaseButton {"Minimum Phase HRIRs", {-.75f, -.83f, -.5f, .5f}};
+    GLTextButton bakeLoopedPathHRIRsButton {"Bake Looped Path HRIRs", {-.67f, -.75f, -.5f, .5f}};
+    
+    // lets the user know why there is no 3d audio yet if the hrir data is still loading or failed to load
+    TextLook hrirDataStateLook;
+    TextBox hrirDataStateText {"", {0.91f, 0.85f, -0.6f, 0.6f}, &hrirDataStateLook};
 
 //    TextLook etbLook;
 //    EditableTextBox etb {{"Dear Dasvidania,    I love you.  Regards,    Bob", {-.1f, -.7f, -.5f, .9f}, &etbLook}, &glWindow};
@@ -351,6 +359,31 @@ private:
     TextBox processingModeHelp {"", {0.65f, websiteButton.getBoundary().getTop(), -0.85f, 0.85f}, &processingModeHelpLook};
     //MultiLineTextBox processingModeHelp {"", {0.65, 0, -0.85, 0.85}};
     int currentProcessingModeHelpIndex = -1;
+    // the hrir interpolation quality used by each processing mode, and what each quality costs on this machine
+    TextLook hrirQualityNormalLook;
+    TextLook hrirQualitySelectedLook;
+    TextLook hrirQualitySelectAnimationBeginLook;
+    TextLook hrirQualityMouseOverLook;
+    GLTitledRadioButton realTimeHRIRQualityOptions {{"Realtime HRIRs:", {-.5f, -.55f, -.9f, -.3f}, &hrirQualityNormalLook},
+        {{{"Nearest", "Trilinear", "Full", "Spherical"}, 1, {-.5f, -.55f, -.3f, .9f}, &hrirQualityNormalLook, true}}};
+    GLTitledRadioButton offlineHRIRQualityOptions {{"HighQuality HRIRs:", {-.55f, -.6f, -.9f, -.3f}, &hrirQualityNormalLook},
+        {{{"Nearest", "Trilinear", "Full", "Spherical"}, 1, {-.55f, -.6f, -.3f, .9f}, &hrirQualityNormalLook, true}}};
+    // how the realtime processing renders the sources, uses the hrir quality looks
+    GLTitledRadioButton renderingEngineOptions {{"Rendering:", {-.45f, -.5f, -.9f, -.3f}, &hrirQualityNormalLook},
+        {{{"HRIR Convolution", "Basis Filters", "Virtual Speakers", "Ambisonics"}, 1, {-.45f, -.5f, -.3f, .9f}, &hrirQualityNormalLook, true}}};
+    GLTitledRadioButton ambisonicOrderOptions {{"Ambisonic Order:", {-.4f, -.45f, -.9f, -.3f}, &hrirQualityNormalLook},
+        {{{"1", "2", "3", "4", "5", "6", "7"}, 1, {-.4f, -.45f, -.3f, .9f}, &hrirQualityNormalLook, true}}};
+    // the processor's source capacity, a power of 2
+    GLTitledRadioButton sourceCapacityOptions {{"Max Sources:", {-.35f, -.4f, -.9f, -.3f}, &hrirQualityNormalLook},
+        {{{"1", "2", "4", "8", "16", "32", "64", "128"}, 1, {-.35f, -.4f, -.3f, .9f}, &hrirQualityNormalLook, true}}};
+    // how well the processor resamples to and from the hrir data's sample rate
+    GLTitledRadioButton resamplerQualityOptions {{"Resampling:", {-.3f, -.35f, -.9f, -.3f}, &hrirQualityNormalLook},
+        {{{"Low Latency", "Normal", "High"}, 1, {-.3f, -.35f, -.3f, .9f}, &hrirQualityNormalLook, true}}};
+    // where the processor's doppler effect goes, see DopplerMode
+    GLTitledRadioButton dopplerModeOptions {{"Doppler:", {-.25f, -.3f, -.9f, -.3f}, &hrirQualityNormalLook},
+        {{{"Delay Line", "Per Ear"}, 1, {-.25f, -.3f, -.3f, .9f}, &hrirQualityNormalLook, true}}};
+    TextLook hrirQualityCostLook;
+    TextBox hrirQualityCostText {"", {-.6f, -.65f, -.85f, .85f}, &hrirQualityCostLook};
     // *** stuff that the plugin instance should own ***
     // eye position
     float upDir = 1;  // y component of eyeUp
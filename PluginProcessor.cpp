@@ -22,7 +22,13 @@
 
 #include "PluginEditor.h"
 #include "Data.h"
-#include <fstream>
+#include "HRIRData.h"
+#include <chrono>
+#include <limits>
+
+constexpr int ThreeDAudioProcessor::dopplerResizeInterval;
+constexpr std::size_t ThreeDAudioProcessor::workerStackBaseSize;
+constexpr std::size_t ThreeDAudioProcessor::workerStackSizePerSample;
 
 #ifdef DEMO // Demo version only
 class BuyMeWindowContents : public Component, public TextButton::Listener
@@ -67,168 +73,39 @@ void ThreeDAudioProcessor::timerCallback()
 }
 #endif
 
-// the global hrir data that gets one instance across multiple plugin instances
-float***** HRIRdata;
-float****  HRIRdataPoles;
+// where the hrir data made from the file is cached for next time, named for the sample rate it is at unless that's the file's own
+static File getHRIRDataCacheFile(const String& name, const double sampleRate)
+{
+    cauto fileName = name + (sampleRate == sampleRate_HRTF ? String() : String((int)std::lround(sampleRate))) + ".bin";
+  #ifdef __APPLE__
+    return File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("Application Support/3DAudio/" + fileName);
+  #else
+    return File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("3DAudio/" + fileName);
+  #endif
+}
 
 //==============================================================================
 ThreeDAudioProcessor::ThreeDAudioProcessor()
 {
-	// if there are no instances going, load the global hrir data for all possible future instances
-	if (numRefs == 0) {
-		// unified poles, compact data
-		// binary hrtf file name
-		String path;
+	// unified poles, compact data
+	// binary hrtf file name
+	String path;
 #ifdef __APPLE__
-        path = File::getSpecialLocation(File::currentApplicationFile).getFullPathName();
-        path += "/Contents/3DAudioData.bin";
+    path = File::getSpecialLocation(File::currentApplicationFile).getFullPathName();
+    path += "/Contents/3DAudioData.bin";
 #elif _WIN32
-		path = File::getSpecialLocation(File::currentApplicationFile).getParentDirectory().getFullPathName();
-		path += "/3DAudioData.bin";
+	path = File::getSpecialLocation(File::currentApplicationFile).getParentDirectory().getFullPathName();
+	path += "/3DAudioData.bin";
 #endif
-		// basic read (should be cross platform)
-		// open the stream
-		std::ifstream is(path.getCharPointer(), std::ios::binary);
-		if (is.good()) {
-			HRIRdata = new float****[numDistanceSteps];
-			for (int d = 0; d < numDistanceSteps; ++d) {
-				HRIRdata[d] = new float***[numAzimuthSteps / 2 + 1];
-				for (int a = 0; a < numAzimuthSteps / 2 + 1; ++a) {
-					HRIRdata[d][a] = new float**[numElevationSteps - 1];
-					for (int e = 0; e < numElevationSteps - 1; ++e) {
-						HRIRdata[d][a][e] = new float*[2];
-						for (int ch = 0; ch < 2; ++ch) {
-							HRIRdata[d][a][e][ch] = new float[numTimeSteps];
-							is.read((char*)HRIRdata[d][a][e][ch], numTimeSteps * sizeof(float));
-						}
-					}
-				}
-			}
-			// pole data is the same for both channels
-			HRIRdataPoles = new float***[numDistanceSteps];
-			std::array<float, numTimeSteps> poleDataBuffer;
-			for (int d = 0; d < numDistanceSteps; ++d) {
-				HRIRdataPoles[d] = new float**[2];
-				HRIRdataPoles[d][0] = new float*[2]; // ele = 0 pole
-				HRIRdataPoles[d][1] = new float*[2]; // ele = 180 pole
-				HRIRdataPoles[d][0][0] = new float[numTimeSteps];
-				HRIRdataPoles[d][0][1] = new float[numTimeSteps];
-				is.read((char*)&poleDataBuffer[0], numTimeSteps * sizeof(float));
-				for (int t = 0; t < numTimeSteps; ++t)
-					HRIRdataPoles[d][0][1][t] = HRIRdataPoles[d][0][0][t] = poleDataBuffer[t];
-				HRIRdataPoles[d][1][0] = new float[numTimeSteps];
-				HRIRdataPoles[d][1][1] = new float[numTimeSteps];
-				is.read((char*)&poleDataBuffer[0], numTimeSteps * sizeof(float));
-				for (int t = 0; t < numTimeSteps; ++t)
-					HRIRdataPoles[d][1][1][t] = HRIRdataPoles[d][1][0][t] = poleDataBuffer[t];
-			}
-			is.close();
-		}
-	//// MAC ONLY
- //   // if there are no instances going, load the global hrir data for all possible future instances
- //   if (numRefs == 0) {
- //       // unified poles, compact data
- //       // binary hrtf file name
- //       String path = File::getSpecialLocation(File::currentApplicationFile).getParentDirectory().getFullPathName();
- //       path += "/3dAudioData.bin"; // the compact, unified poles data that is
- //       // basic read (should be cross platform)
- //       // open the stream
- //       std::ifstream is(path.getCharPointer());
- //       if (is.good()) {
- //           // determine the file length
- //           is.seekg(0, is.end);
- //           size_t size = is.tellg();
- //           is.seekg(0, is.beg);
- //           // create a temp array to store the data
- //           char* dataBuffer = new char[size];
- //           // load the data
- //           is.read(dataBuffer, size);
- //           // close the file
- //           is.close();
- //           // pack data into HRIR array
- //           int index = 0;
- //           HRIRdata = new float****[numDistanceSteps];
- //           for (int d = 0; d < numDistanceSteps; ++d) {
- //               HRIRdata[d] = new float***[numAzimuthSteps/2+1];
- //               for (int a = 0; a < numAzimuthSteps/2+1; ++a) {
- //                   HRIRdata[d][a] = new float**[numElevationSteps-1];
- //                   for (int e = 0; e < numElevationSteps-1; ++e) {
- //                       HRIRdata[d][a][e] = new float*[2];
- //                       for (int ch = 0; ch < 2; ++ch) {
- //                           HRIRdata[d][a][e][ch] = new float[numTimeSteps];
- //                           for (int t = 0; t < numTimeSteps; ++t) {
- //                               HRIRdata[d][a][e][ch][t] = *((float*) &dataBuffer[index*sizeof(float)]);
- //                               ++index;
- //                           }
- //                       }
- //                   }
- //               }
- //           }
- //           // pole data is the same for both channels
- //           HRIRdataPoles = new float***[numDistanceSteps];
- //           for (int d = 0; d < numDistanceSteps; ++d) {
- //               HRIRdataPoles[d] = new float**[2];
- //               HRIRdataPoles[d][0] = new float*[2]; // ele = 0 pole
- //               HRIRdataPoles[d][1] = new float*[2]; // ele = 180 pole
- //               HRIRdataPoles[d][0][0] = new float[numTimeSteps];
- //               HRIRdataPoles[d][0][1] = new float[numTimeSteps];
- //               for (int t = 0; t < numTimeSteps; ++t) {
- //                   HRIRdataPoles[d][0][1][t] = HRIRdataPoles[d][0][0][t] = *((float*) &dataBuffer[index*sizeof(float)]);
- //                   ++index;
- //               }
- //               HRIRdataPoles[d][1][0] = new float[numTimeSteps];
- //               HRIRdataPoles[d][1][1] = new float[numTimeSteps];
- //               for (int t = 0; t < numTimeSteps; ++t) {
- //                   HRIRdataPoles[d][1][1][t] = HRIRdataPoles[d][1][0][t] = *((float*) &dataBuffer[index*sizeof(float)]);
- //                   ++index;
- //               }
- //           }
- //           // cleanup the temp array
- //           delete[] dataBuffer;
- //       } 
-		else {
-            // failed to open hrtf binary file, load up zeros
-            HRIRdata = new float****[numDistanceSteps];
-            for (int d = 0; d < numDistanceSteps; ++d) {
-                HRIRdata[d] = new float***[numAzimuthSteps];
-                for (int a = 0; a < numAzimuthSteps; ++a) {
-                    HRIRdata[d][a] = new float**[numElevationSteps];
-                    for (int e = 0; e < numElevationSteps; ++e) {
-                        HRIRdata[d][a][e] = new float*[2];
-                        for (int ch = 0; ch < 2; ++ch) {
-                            HRIRdata[d][a][e][ch] = new float[numTimeSteps];
-                            for (int t = 0; t < numTimeSteps; ++t) {
-                                HRIRdata[d][a][e][ch][t] = 0;
-                            }
-                        }
-                    }
-                }
-            }
-            // pole data is the same for both channels
-            HRIRdataPoles = new float***[numDistanceSteps];
-            for (int d = 0; d < numDistanceSteps; ++d) {
-                HRIRdataPoles[d] = new float**[2];
-                HRIRdataPoles[d][0] = new float*[2]; // ele = 0 pole
-                HRIRdataPoles[d][0][0] = new float[numTimeSteps];
-                HRIRdataPoles[d][0][1] = new float[numTimeSteps];
-                HRIRdataPoles[d][1] = new float*[2]; // ele = 180 pole
-                HRIRdataPoles[d][1][0] = new float[numTimeSteps];
-                HRIRdataPoles[d][1][1] = new float[numTimeSteps];
-                for (int t = 0; t < numTimeSteps; ++t) {
-                    HRIRdataPoles[d][0][0][t] = 0;
-                    HRIRdataPoles[d][0][1][t] = 0;
-                    HRIRdataPoles[d][1][0][t] = 0;
-                    HRIRdataPoles[d][1][1][t] = 0;
-                }
-            }
-        }
-    }
-
-    // increment plugin reference count
-    ++numRefs;
+    // get the hrir data shared by all plugin instances, if there are no other instances going it starts loading in the background so we don't block the host while it is read.
+    // the file is mapped read-only so that all processes hosting the plugin share one copy of the data in the os's page cache, falls back to one bulk read into private memory and loads up zeros if the file fails to open.
+    // the shipped file is full precision, so the first run saves a copy in the stored precision that gets mapped from then on
+    fileHRIRData = HRIRData::getShared(path.getCharPointer(), hrirDataMemoryMapped, getHRIRDataCacheFile("3DAudioData", sampleRate_HRTF).getFullPathName().toRawUTF8());
+    hrirData = fileHRIRData;
     
-    // pre-allocate space for maximum number of playableSources, so we don't have to in processBlock()
-    playableSources.resize(maxNumSources);
+    // pre-allocate space for as many playableSources as there can be sources, so we don't have to in processBlock()
+    preparePlayableSources();
+    dopplerResizer = std::thread([this] { resizeDopplerDelayLines(); });
     
     // load up one source as the default
     sources.load(std::vector<SoundSource>(1));
@@ -259,41 +136,241 @@ ThreeDAudioProcessor::~ThreeDAudioProcessor()
 		buyMeWindow->exitModalState(0);
 	}
   #endif
+    
+    {
+        const std::lock_guard<std::mutex> lock (dopplerResizerWakeLock);
+        dopplerResizerShouldExit = true;
+    }
+    dopplerResizerWake.notify_all();
+    dopplerResizer.join();
   
     // cleanup memeory for undo's
     clearUndoHistory();
+    
+    // the hrir data gets cleaned up when the last plugin instance releases its reference to it
+}
 
-    // cleanup hrir data if we are closing the only plugin instance
-    if (numRefs == 1) {
-        for (int d = numDistanceSteps-1; d >= 0; --d) {
-            //for (int a = numAzimuthSteps-1; a >= 0; --a) {
-            for (int a = numAzimuthSteps/2; a >= 0; --a) {
-                //for (int e = numElevationSteps-1; e >= 0; --e) {
-                for (int e = numElevationSteps-2; e >= 0; --e) {
-                    for (int ch = 1; ch >= 0; --ch) {
-                        delete[] HRIRdata[d][a][e][ch];
-                    }
-                    delete[] HRIRdata[d][a][e];
-                }
-                delete[] HRIRdata[d][a];
-            }
-            delete[] HRIRdata[d];
+HRIRData::State ThreeDAudioProcessor::getHRIRDataState() const noexcept
+{
+    const std::lock_guard<std::mutex> lock (hrirDataLock);
+    if (minimumPhaseHRIRs && minimumPhaseHRIRData && hrirData->getState() == HRIRData::State::LOADED)
+        return minimumPhaseHRIRData->getState();
+    return hrirData->getState();
+}
+
+const HRIRData::ConversionError* ThreeDAudioProcessor::getHRIRConversionError() const noexcept
+{
+    // only the file's data is converted, the resampled and minimum phase data are made from it
+    if (fileHRIRData->getState() != HRIRData::State::LOADED)
+        return nullptr;
+    return &fileHRIRData->getConversionError();
+}
+
+const HRIRData* ThreeDAudioProcessor::getHRIRDataToProcessWith() const noexcept
+{
+    // the minimum phase hrirs are used once they are made, until then stick with the full ones
+    if (minimumPhaseHRIRs) {
+        const HRIRData* minimumPhase = minimumPhaseHRIRDataForAudio.load(std::memory_order_acquire);
+        if (minimumPhase && minimumPhase->getState() == HRIRData::State::LOADED)
+            return minimumPhase;
+    }
+    return hrirData.get();
+}
+
+void ThreeDAudioProcessor::fitHRIRSphericalHarmonics()
+{
+    if (!hrirSphericalHarmonics) {
+        hrirSphericalHarmonics = HRIRSphericalHarmonics::getShared(hrirData);
+        hrirSphericalHarmonicsForAudio.store(hrirSphericalHarmonics.get(), std::memory_order_release);
+    }
+    if (minimumPhaseHRIRData && !minimumPhaseHRIRSphericalHarmonics) {
+        minimumPhaseHRIRSphericalHarmonics = HRIRSphericalHarmonics::getShared(minimumPhaseHRIRData);
+        minimumPhaseHRIRSphericalHarmonicsForAudio.store(minimumPhaseHRIRSphericalHarmonics.get(), std::memory_order_release);
+    }
+}
+
+const HRIRSphericalHarmonics* ThreeDAudioProcessor::getHRIRSphericalHarmonicsFor(const HRIRData* data) const noexcept
+{
+    for (const HRIRSphericalHarmonics* sh : {hrirSphericalHarmonicsForAudio.load(std::memory_order_acquire), minimumPhaseHRIRSphericalHarmonicsForAudio.load(std::memory_order_acquire)})
+        if (sh && sh->getHRIRData() == data && sh->isReady())
+            return sh;
+    return nullptr;
+}
+
+void ThreeDAudioProcessor::setHRIRInterpolationQuality(const bool forRealTime, const HRIRInterpolationQuality newQuality)
+{
+    (forRealTime ? realTimeHRIRInterpolationQuality : offlineHRIRInterpolationQuality) = newQuality;
+    if (newQuality == HRIRInterpolationQuality::SPHERICAL_HARMONICS) {
+        const std::lock_guard<std::mutex> lock (hrirDataLock);
+        fitHRIRSphericalHarmonics();
+    }
+}
+
+void ThreeDAudioProcessor::findHRIRBasisFilters()
+{
+    if (!hrirBasisFilters) {
+        hrirBasisFilters = HRIRBasisFilters::getShared(hrirData);
+        hrirBasisFiltersForAudio.store(hrirBasisFilters.get(), std::memory_order_release);
+    }
+    if (minimumPhaseHRIRData && !minimumPhaseHRIRBasisFilters) {
+        minimumPhaseHRIRBasisFilters = HRIRBasisFilters::getShared(minimumPhaseHRIRData);
+        minimumPhaseHRIRBasisFiltersForAudio.store(minimumPhaseHRIRBasisFilters.get(), std::memory_order_release);
+    }
+}
+
+const HRIRBasisFilters* ThreeDAudioProcessor::getHRIRBasisFiltersFor(const HRIRData* data) const noexcept
+{
+    for (const HRIRBasisFilters* basis : {hrirBasisFiltersForAudio.load(std::memory_order_acquire), minimumPhaseHRIRBasisFiltersForAudio.load(std::memory_order_acquire)})
+        if (basis && basis->getHRIRData() == data && basis->isReady())
+            return basis;
+    return nullptr;
+}
+
+void ThreeDAudioProcessor::setRenderingEngine(const RenderingEngine newEngine)
+{
+    const std::lock_guard<std::mutex> lock (hrirDataLock);
+    renderingEngine = newEngine;
+    if (newEngine == RenderingEngine::BASIS_FILTERS)
+        findHRIRBasisFilters();
+    else if (newEngine == RenderingEngine::AMBISONICS)
+        fitAmbisonicDecoder();
+}
+
+void ThreeDAudioProcessor::setAmbisonicOrder(const int newOrder)
+{
+    const std::lock_guard<std::mutex> lock (hrirDataLock);
+    ambisonicOrder = std::max(1, std::min(newOrder, AmbisonicBus::maxOrder));
+    if (renderingEngine == RenderingEngine::AMBISONICS)
+        fitAmbisonicDecoder();
+}
+
+void ThreeDAudioProcessor::fitAmbisonicDecoder()
+{
+    auto& decoder = ambisonicDecoders[ambisonicOrder];
+    if (!decoder)
+        decoder = HRIRSphericalHarmonics::getShared(hrirData, ambisonicOrder);
+    ambisonicDecoderForAudio.store(decoder.get(), std::memory_order_release);
+}
+
+void ThreeDAudioProcessor::measureHRIRInterpolationCosts()
+{
+    const HRIRData* data;
+    const HRIRSphericalHarmonics* sh;
+    {
+        const std::lock_guard<std::mutex> lock (hrirDataLock);
+        if (!hrirData->isReady())
+            return;
+        data = getHRIRDataToProcessWith();
+        sh = getHRIRSphericalHarmonicsFor(data);
+    }
+    if (data == hrirInterpolationCostsHRIRData && sh == hrirInterpolationCostsHRIRSphericalHarmonics)
+        return;
+    hrirInterpolationCostsHRIRData = data;
+    hrirInterpolationCostsHRIRSphericalHarmonics = sh;
+    // a source spiraling through a few hundred cells, interpolated without the cache like the high quality processing does for moving sources
+    constexpr int numPositions = 256;
+    std::vector<float> raes (3*numPositions), hrirs (2*maxNumTimeSteps*numPositions), delays (2*numPositions), scaling (2*numPositions);
+    for (int i = 0; i < numPositions; ++i) {
+        cauto t = i / (float)numPositions;
+        raes[3*i  ] = 0.5f + 1.5f*t;
+        raes[3*i+1] = std::fmod(6*M_PI*t, 2*M_PI);
+        raes[3*i+2] = M_PI/2 + std::sin(2*M_PI*t);
+    }
+    auto probe = std::make_unique<PlayableSoundSource>();
+    probe->setHRIRData(data);
+    probe->setHRIRSphericalHarmonics(sh);
+    for (int q = 0; q < (int)hrirInterpolationCosts.size(); ++q) {
+        if ((HRIRInterpolationQuality)q == HRIRInterpolationQuality::SPHERICAL_HARMONICS && !sh) {
+            hrirInterpolationCosts[q] = -1;
+            continue;
+        }
+        probe->setInterpolationQuality((HRIRInterpolationQuality)q);
+        // best of a few runs to keep other threads' interruptions out of it
+        double best = std::numeric_limits<double>::max();
+        for (int run = 0; run < 4; ++run) {
+            cauto begin = std::chrono::steady_clock::now();
+            probe->interpolateHRIRs(&raes[0], numPositions, &hrirs[0], &delays[0], &scaling[0]);
+            best = std::min(best, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
         }
-        delete[] HRIRdata;
-        for (int d = numDistanceSteps-1; d >= 0; --d) {
-            for (int e = 1; e >= 0; --e) {
-                for (int ch = 1; ch >= 0; --ch) {
-                    delete[] HRIRdataPoles[d][e][ch];
+        hrirInterpolationCosts[q] = best / numPositions;
+    }
+}
+
+bool ThreeDAudioProcessor::getHRIRBakingJob(HRIRBaker::Job& job)
+{
+    const std::lock_guard<std::mutex> lock (hrirDataLock);
+    if (!bakeLoopedPathHRIRs || !loopingEnabled || !lockSourcesToPaths || !hrirData->isReady() || loopRegionEnd <= loopRegionBegin)
+        return false;
+    {
+        Sources* copy = nullptr;
+        const Locker lock (sources.get(copy));
+        if (!copy)
+            return false;
+        job.sources = *copy;
+    }
+    job.loopRegionBegin = loopRegionBegin;
+    job.loopRegionEnd = loopRegionEnd;
+    job.hrirData = getHRIRDataToProcessWith();
+    // only the realtime processing uses the baked hrirs
+    job.quality = realTimeHRIRInterpolationQuality;
+    job.sphericalHarmonics = getHRIRSphericalHarmonicsFor(job.hrirData);
+    return true;
+}
+
+std::size_t ThreeDAudioProcessor::getBakedHRIRsMemorySize() const noexcept
+{
+    return hrirBaker.getMemorySize();
+}
+
+std::size_t ThreeDAudioProcessor::getDopplerMemorySize(const int sourceIndex) const
+{
+    const std::lock_guard<std::mutex> lock (playableSourcesLock);
+    if (sourceIndex < 0 || sourceIndex >= (int)playableSources.size())
+        return 0;
+    return playableSources[sourceIndex].getDopplerMemorySize();
+}
+
+void ThreeDAudioProcessor::resizeDopplerDelayLines()
+{
+    struct Resize
+    {
+        int source, buffer, size;
+        std::vector<float>* retired;
+        std::vector<float>* resized;
+    };
+    std::vector<Resize> resizes;
+    std::unique_lock<std::mutex> wakeLock (dopplerResizerWakeLock);
+    while (!dopplerResizerShouldExit) {
+        // just look at which ones need resizing with the lock held
+        resizes.clear();
+        {
+            const std::lock_guard<std::mutex> lock (playableSourcesLock);
+            for (int s = 0; s < (int)playableSources.size(); ++s) {
+                for (int b = 0; b < PlayableSoundSource::numDopplerBuffers; ++b) {
+                    auto& buffer = playableSources[s].getDopplerBuffer(b);
+                    const int size = buffer.getResizeSize();
+                    std::vector<float>* const retired = buffer.takeRetiredBuffer();
+                    if (size > 0 || retired)
+                        resizes.push_back({s, b, size, retired, nullptr});
                 }
-                delete[] HRIRdataPoles[d][e];
             }
-            delete[] HRIRdataPoles[d];
         }
-        delete[] HRIRdataPoles;
+        for (auto& r : resizes) {
+            delete r.retired;
+            if (r.size > 0)
+                r.resized = new std::vector<float>(r.size, 0.0f);
+        }
+        // the sources may have been reallocated or gone farther in the meantime, the ones that won't do anymore are freed and tried again next time
+        {
+            const std::lock_guard<std::mutex> lock (playableSourcesLock);
+            for (auto& r : resizes)
+                if (r.resized && r.source < (int)playableSources.size() && playableSources[r.source].getDopplerBuffer(r.buffer).setResizedBuffer(r.resized))
+                    r.resized = nullptr;
+        }
+        for (auto& r : resizes)
+            delete r.resized;
+        dopplerResizerWake.wait_for(wakeLock, std::chrono::milliseconds(dopplerResizeInterval), [this] { return dopplerResizerShouldExit.load(); });
     }
-    
-    // decrement plugin reference count
-    --numRefs;
 }
 
 // saves the current sources state beforeOrAfter == -1 -> before edit w/ reset,
@@ -411,7 +488,7 @@ bool ThreeDAudioProcessor::addSourceAtXYZ(const float (&xyz)[3])
 {
     Sources* copy = nullptr;
     const Locker lock (sources.get(copy));
-    if (copy && copy->size() < maxNumSources) {
+    if (copy && (int)copy->size() < sourceCapacity) {
         // get the sources before adding the new source
         saveCurrentState(-1);
         // add a new source at this xyz pos
@@ -450,7 +527,7 @@ void ThreeDAudioProcessor::copySelectedSources()
                     // if no path points are selected, then copy the whole source
                     // deselect the source we are copying
                     (*copy)[s].setSourceSelected(false);
-                    if (copy->size() < maxNumSources) {
+                    if ((int)copy->size() < sourceCapacity) {
                         // get the sources before copying
                         if (!doUndoableAction) {
                             saveCurrentState(1);
@@ -628,6 +705,21 @@ void ThreeDAudioProcessor::toggleDoppler()
     // TODO: detect largest latency of dopplers for each source and adjust (along with resampling) with setLatencySamples()
 }
 
+void ThreeDAudioProcessor::setDopplerMode(const DopplerMode newMode)
+{
+    if (newMode == dopplerMode)
+        return;
+    const bool wasSuspended = isSuspended();
+    suspendProcessing(true);
+    dopplerMode = newMode;
+    {
+        const std::lock_guard<std::mutex> lock (playableSourcesLock);
+        for (auto& s : playableSources)
+            s.setDopplerMode(newMode);
+    }
+    suspendProcessing(wasSuspended);
+}
+
 int ThreeDAudioProcessor::moveSelectedSourcesXYZ(const float dx, const float dy, const float dz, const bool moveSource)
 {
     int movedStuff = 0;
@@ -1332,6 +1424,72 @@ void ThreeDAudioProcessor::setProcessingMode(const ProcessingMode newMode) noexc
         realTime = (processingMode == ProcessingMode::REALTIME);
 }
 
+void ThreeDAudioProcessor::setMinimumPhaseHRIRs(const bool enabled)
+{
+    const std::lock_guard<std::mutex> lock (hrirDataLock);
+    minimumPhaseHRIRs = enabled;
+    if (enabled)
+        makeMinimumPhaseHRIRData();
+}
+
+void ThreeDAudioProcessor::makeMinimumPhaseHRIRData()
+{
+    if (minimumPhaseHRIRData)
+        return;
+    // making the minimum phase hrirs takes a while, so they are cached to a file for next time
+    cauto cacheFile = getHRIRDataCacheFile("3DAudioMinimumPhaseData", hrirDataSampleRate);
+    minimumPhaseHRIRData = HRIRData::getSharedMinimumPhase(hrirData, cacheFile.getFullPathName().toRawUTF8(), hrirDataMemoryMapped);
+    minimumPhaseHRIRDataForAudio.store(minimumPhaseHRIRData.get(), std::memory_order_release);
+    if (hrirSphericalHarmonics)
+        fitHRIRSphericalHarmonics();
+    if (hrirBasisFilters)
+        findHRIRBasisFilters();
+}
+
+void ThreeDAudioProcessor::setHRIRDataSampleRate(const double sampleRate)
+{
+    const std::lock_guard<std::mutex> lock (hrirDataLock);
+    if (sampleRate == hrirDataSampleRate)
+        return;
+    // put away what was made at the old sample rate and pick up whatever was made at the new one before
+    hrirDataSets[std::lround(hrirDataSampleRate)] = {hrirData, minimumPhaseHRIRData, hrirSphericalHarmonics, minimumPhaseHRIRSphericalHarmonics,
+                                                     hrirBasisFilters, minimumPhaseHRIRBasisFilters, ambisonicDecoders};
+    const bool fitted = hrirSphericalHarmonics != nullptr;
+    const bool foundBasis = hrirBasisFilters != nullptr;
+    hrirDataSampleRate = sampleRate;
+    maxHRIRLength = HRIRData::scaleLength(numTimeSteps, sampleRate_HRTF, sampleRate);
+    auto& set = hrirDataSets[std::lround(sampleRate)];
+    if (!set.hrirData) {
+        if (sampleRate == sampleRate_HRTF)
+            set.hrirData = fileHRIRData;
+        else
+            set.hrirData = HRIRData::getSharedResampled(fileHRIRData, sampleRate, getHRIRDataCacheFile("3DAudioData", sampleRate).getFullPathName().toRawUTF8(),
+                                                        hrirDataMemoryMapped);
+    }
+    hrirData = set.hrirData;
+    minimumPhaseHRIRData = set.minimumPhaseHRIRData;
+    hrirSphericalHarmonics = set.hrirSphericalHarmonics;
+    minimumPhaseHRIRSphericalHarmonics = set.minimumPhaseHRIRSphericalHarmonics;
+    hrirBasisFilters = set.hrirBasisFilters;
+    minimumPhaseHRIRBasisFilters = set.minimumPhaseHRIRBasisFilters;
+    ambisonicDecoders = set.ambisonicDecoders;
+    minimumPhaseHRIRDataForAudio.store(minimumPhaseHRIRData.get(), std::memory_order_release);
+    hrirSphericalHarmonicsForAudio.store(hrirSphericalHarmonics.get(), std::memory_order_release);
+    minimumPhaseHRIRSphericalHarmonicsForAudio.store(minimumPhaseHRIRSphericalHarmonics.get(), std::memory_order_release);
+    hrirBasisFiltersForAudio.store(hrirBasisFilters.get(), std::memory_order_release);
+    minimumPhaseHRIRBasisFiltersForAudio.store(minimumPhaseHRIRBasisFilters.get(), std::memory_order_release);
+    ambisonicDecoderForAudio.store(ambisonicDecoders[ambisonicOrder].get(), std::memory_order_release);
+    // and start making what was in use at the old one
+    if (minimumPhaseHRIRs)
+        makeMinimumPhaseHRIRData();
+    if (fitted)
+        fitHRIRSphericalHarmonics();
+    if (foundBasis)
+        findHRIRBasisFilters();
+    if (renderingEngine == RenderingEngine::AMBISONICS)
+        fitAmbisonicDecoder();
+}
+
 std::string ThreeDAudioProcessor::getCurrentTimeString(const int opt) const
 {
     switch (opt)
@@ -1434,11 +1592,7 @@ bool ThreeDAudioProcessor::silenceInProducesSilenceOut() const
 double ThreeDAudioProcessor::getTailLengthSeconds() const
 {
     // not sure if the tail length reported here should include latency due to resampling
-    if (fs != sampleRate_HRTF) {
-        return (numTimeSteps+1.0) / getSampleRate();
-    } else {
-        return numTimeSteps / getSampleRate();
-    }
+    return maxHRIRLength / hrirDataSampleRate + getLatencySamples() / getSampleRate();
 }
 
 int ThreeDAudioProcessor::getNumPrograms()
@@ -1471,19 +1625,17 @@ void ThreeDAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock
     N = samplesPerBlock;
     if (fs != sampleRate) {
         fs = sampleRate;
+        // the hrir data is converted to the new sample rate (up to maxSampleRate_HRTF, above that an even fraction of it which the audio is resampled to),
+        // until that's done processBlock() passes the audio through like while it's loading
+        setHRIRDataSampleRate(sampleRate / std::ceil(sampleRate / maxSampleRate_HRTF - 1.0e-6));
         // set doppler(s) to the new sample rate, reallocation for this change happens in allocateForMaxBufferSize() below
+        const std::lock_guard<std::mutex> lock (playableSourcesLock);
         for (auto& s : playableSources)
-            s.setDopplerSampleRate(sampleRate_HRTF/*fs*/); // doppler processing is done @ sample rate of hrtf data
+            s.setDopplerSampleRate(hrirDataSampleRate); // doppler processing is done @ sample rate of hrtf data
         // TODO: detect largest latency of doppler and factor that in to the setLatencySamples() call below
     }
 	maxBufferSizePreparedFor = N;
-    if (fs != sampleRate_HRTF) {
-        resampler = Resampler(fs, N, sampleRate_HRTF, true);
-        unsamplerCh1 = Resampler(sampleRate_HRTF, N, fs, false);
-        unsamplerCh2 = Resampler(sampleRate_HRTF, N, fs, false);
-        setLatencySamples(1);
-		maxBufferSizePreparedFor = std::max(resampler.getNoutMax(), N.load());
-    }
+    prepareResamplers();
 //    {
 //        sources.load(std::vector<SoundSource>(1));
 //        if (displayState == DisplayState::PATH_AUTOMATION)
@@ -1501,14 +1653,126 @@ void ThreeDAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock
     // update all the real time state
     isHostRealTime = !isNonRealtime();
     realTime = (processingMode == ProcessingMode::AUTO_DETECT) ? isHostRealTime.load() : processingMode == ProcessingMode::REALTIME;
-    // allocate space in each PlayableSoundSource for processing
-    for (auto& s : playableSources) {
-        s.allocateForMaxBufferSize(maxBufferSizePreparedFor);
+    // allocate space in each PlayableSoundSource for processing, the dopplerResizer resizes their delay lines under the same lock
+    {
+        const std::lock_guard<std::mutex> lock (playableSourcesLock);
+        for (auto& s : playableSources)
+            s.allocateForMaxBufferSize(maxBufferSizePreparedFor, maxHRIRLength);
     }
+    hrirBasisConvolver.allocate(maxBufferSizePreparedFor);
+    virtualSpeakers.allocate(maxBufferSizePreparedFor);
+    ambisonicBus.allocate(maxBufferSizePreparedFor);
+    preparePlayableSources();
     // now we are setup for processing
     inited = true;
 }
 
+void ThreeDAudioProcessor::setSourceCapacity(const int newCapacity)
+{
+    int capacity = 1;
+    while (capacity < std::min(newCapacity, (int)maxNumSources))
+        capacity *= 2;
+    {
+        Sources* copy = nullptr;
+        const Locker lock (sources.get(copy));
+        if (copy)
+            while (capacity < std::min((int)copy->size(), (int)maxNumSources))
+                capacity *= 2;
+    }
+    if (capacity == sourceCapacity)
+        return;
+    // the host holds off on calling processBlock() while suspended
+    const bool wasSuspended = isSuspended();
+    suspendProcessing(true);
+    sourceCapacity = capacity;
+    preparePlayableSources();
+    suspendProcessing(wasSuspended);
+}
+
+void ThreeDAudioProcessor::setResamplerQuality(const ResamplerQuality newQuality)
+{
+    if (newQuality == resamplerQuality)
+        return;
+    const bool wasSuspended = isSuspended();
+    suspendProcessing(true);
+    resamplerQuality = newQuality;
+    if (maxBufferSizePreparedFor > 0)
+        prepareResamplers();
+    suspendProcessing(wasSuspended);
+}
+
+void ThreeDAudioProcessor::prepareResamplers()
+{
+    int latency = 0;
+    if (fs != hrirDataSampleRate) {
+        resampler = Resampler(fs, N, hrirDataSampleRate, true, 1, resamplerQuality);
+        unsampler = Resampler(hrirDataSampleRate, N, fs, false, 2, resamplerQuality);
+        latency = resampler.getLatency() + unsampler.getLatency();
+		maxBufferSizePreparedFor = std::max(resampler.getNoutMax(), N.load());
+    }
+    dryDelay.assign(2 * latency, 0.0f);
+    dryDelayPos = 0;
+    setLatencySamples(latency);
+}
+
+void ThreeDAudioProcessor::preparePlayableSources()
+{
+    const std::lock_guard<std::mutex> lock (playableSourcesLock);
+    const int oldSize = (int)playableSources.size();
+    playableSources.resize(sourceCapacity);
+    prevSourcesSize = std::min(prevSourcesSize, (int)sourceCapacity);
+    for (int s = oldSize; s < (int)playableSources.size(); ++s) {
+        auto& source = playableSources[s];
+        source.setHRIRCache(&hrirCache);
+        source.setDopplerSampleRate(hrirDataSampleRate);
+        source.setDopplerMode(dopplerMode);
+        source.setInterpolationQuality(currentHRIRInterpolationQuality);
+        source.setHRIRSphericalHarmonics(currentHRIRSphericalHarmonics);
+        if (maxBufferSizePreparedFor > 0)
+            source.allocateForMaxBufferSize(maxBufferSizePreparedFor, maxHRIRLength);
+        if (currentHRIRData)
+            source.setHRIRData(currentHRIRData);
+    }
+    // the worker threads start with the first prepareToPlay(), there is no point in more of them than sources and one core is the host's
+    if (maxBufferSizePreparedFor > 0) {
+        sourceRenderingPool.start(std::min<int>(std::thread::hardware_concurrency() - 1, sourceCapacity - 1),
+                                  workerStackBaseSize + workerStackSizePerSample * maxBufferSizePreparedFor);
+        workerMaxBlockSize = maxBufferSizePreparedFor;
+        workerOutputs.assign(sourceRenderingPool.getNumWorkers() * 2 * maxBufferSizePreparedFor, 0.0f);
+    }
+}
+
+void ThreeDAudioProcessor::renderSources(const int* sourceIndices, const int count, const float* in, const int N, float* out, const bool realTime,
+                                         const bool parallel) noexcept
+{
+    if (!parallel || sourceRenderingPool.getNumWorkers() == 0 || N > workerMaxBlockSize) {
+        for (int i = 0; i < count; ++i)
+            playableSources[sourceIndices[i]].processAudio(in, N, out, realTime);
+        return;
+    }
+    // each thread sums the sources it gets into its own output, which is cleared the first time it gets one
+    std::array<bool, WorkerPool::maxNumWorkers + 1> workerUsed {};
+    auto render = [&] (const int i, const int worker)
+    {
+        float* workerOut = out;
+        if (worker > 0) {
+            workerOut = &workerOutputs[(worker - 1) * 2 * maxBufferSizePreparedFor];
+            if (!workerUsed[worker])
+                std::fill_n(workerOut, 2*N, 0.0f);
+        }
+        workerUsed[worker] = true;
+        playableSources[sourceIndices[i]].processAudio(in, N, workerOut, realTime);
+    };
+    sourceRenderingPool.run(count, render);
+    for (int w = 1; w <= sourceRenderingPool.getNumWorkers(); ++w) {
+        if (!workerUsed[w])
+            continue;
+        const float* workerOut = &workerOutputs[(w - 1) * 2 * maxBufferSizePreparedFor];
+        for (int n = 0; n < 2*N; ++n)
+            out[n] += workerOut[n];
+    }
+}
+
 void ThreeDAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
@@ -1523,21 +1787,51 @@ void ThreeDAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer&
     for (int i = getTotalNumInputChannels(); i < getTotalNumOutputChannels(); ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
     
+    // the hrir data loads on a background thread, until it is ready just pass the audio through unprocessed
+    if (!hrirData->isReady())
+        return;
+    // the cached hrirs were interpolated at the old quality
+    const HRIRInterpolationQuality newHRIRInterpolationQuality = realTime ? realTimeHRIRInterpolationQuality : offlineHRIRInterpolationQuality;
+    if (newHRIRInterpolationQuality != currentHRIRInterpolationQuality) {
+        hrirCache.clear();
+        for (auto& s : playableSources)
+            s.setInterpolationQuality(newHRIRInterpolationQuality);
+        currentHRIRInterpolationQuality = newHRIRInterpolationQuality;
+    }
+    const HRIRData* newHRIRData = getHRIRDataToProcessWith();
+    if (newHRIRData != currentHRIRData) {
+        hrirCache.clear();
+        for (auto& s : playableSources)
+            s.setHRIRData(newHRIRData);
+        currentHRIRData = newHRIRData;
+    }
+    // until the spherical harmonic fit is done the sources fall back to (and cache) the full stencil interpolation
+    const HRIRSphericalHarmonics* newHRIRSphericalHarmonics = getHRIRSphericalHarmonicsFor(newHRIRData);
+    if (newHRIRSphericalHarmonics != currentHRIRSphericalHarmonics) {
+        hrirCache.clear();
+        for (auto& s : playableSources)
+            s.setHRIRSphericalHarmonics(newHRIRSphericalHarmonics);
+        currentHRIRSphericalHarmonics = newHRIRSphericalHarmonics;
+    }
+    
     // if the plugin is initialized by prepareToPlay()
     if (inited) {
         // need to update block size if it is not what we expected to make sure we have enough memory alloced for processing
 		N = buffer.getNumSamples();
 		if (N > maxBufferSizePreparedFor) {
             maxBufferSizePreparedFor = N;
-            // also got to reset the resampler to the new buffer size if the incoming sample rate is not 44.1kHz
-            if (fs != sampleRate_HRTF) {
-                resampler = Resampler(fs, N, sampleRate_HRTF, true);
-                unsamplerCh1 = Resampler(sampleRate_HRTF, N, fs, false);
-                unsamplerCh2 = Resampler(sampleRate_HRTF, N, fs, false);
-                maxBufferSizePreparedFor = std::max(resampler.getNoutMax(), N.load());
+            // also got to reset the resampler to the new buffer size if the incoming sample rate is above maxSampleRate_HRTF
+            prepareResamplers();
+            {
+                const std::lock_guard<std::mutex> lock (playableSourcesLock);
+                for (auto& s : playableSources)
+                    s.allocateForMaxBufferSize(maxBufferSizePreparedFor, maxHRIRLength);
             }
-            for (auto& s : playableSources)
-                s.allocateForMaxBufferSize(maxBufferSizePreparedFor);
+            hrirBasisConvolver.allocate(maxBufferSizePreparedFor);
+            virtualSpeakers.allocate(maxBufferSizePreparedFor);
+            ambisonicBus.allocate(maxBufferSizePreparedFor);
+            // the pool's threads keep their stacks, renderSources() doesn't hand them blocks this big until the next prepareToPlay() restarts them
+            workerOutputs.assign(sourceRenderingPool.getNumWorkers() * 2 * maxBufferSizePreparedFor, 0.0f);
         }
         
         // update playback position stuff
@@ -1600,14 +1894,18 @@ void ThreeDAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer&
             buffer.clear(ch, 0, currentN);
         }
         
-        // got to resample to 44.1kHz if input is a different sample rate because the HRIR data is 44.1kHz
+        // got to resample to the hrir data's sample rate if the input is at a higher one than the hrir data is converted to
         // NOTE: size is getNoutMax() b/c we can't tell if the buffer will be long or short until we make the resample call below
         const int resampledMaxSize = resampler.getNoutMax();
         STACK_ARRAY(float, inputResampled, resampledMaxSize)
-        if (fs != sampleRate_HRTF) {
-            for (int n = 0; n < resampledMaxSize; ++n)
-                inputResampled[n] = 0;
-            resampler.resampleLinear(&input[0], &inputResampled[0]);
+        if (fs != hrirDataSampleRate) {
+            if (resetProcessingState) {
+                resampler.reset();
+                unsampler.reset();
+            }
+            const float* resamplerInput[] = {&input[0]};
+            float* resamplerOutput[] = {&inputResampled[0]};
+            resampler.resample(resamplerInput, currentN, resamplerOutput);
         }
         
         // the net output accumulator for all sources
@@ -1617,7 +1915,7 @@ void ThreeDAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer&
             output[n] = 0;
         
         // the resampled version ...
-        const int resampledNout = resampler.getNout();
+        const int resampledNout = fs != hrirDataSampleRate ? resampler.getNout() : 0;
         const int resampledSize = 2*resampledNout;
         STACK_ARRAY(float, outputResampled, resampledSize);
         for (int n = 0; n < resampledSize; ++n)
@@ -1625,7 +1923,7 @@ void ThreeDAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer&
         
         float *inputPtr, *outputPtr;
         int inputLength;
-        if (fs != sampleRate_HRTF) {
+        if (fs != hrirDataSampleRate) {
             inputPtr = &inputResampled[0];
             outputPtr = &outputResampled[0];
             inputLength = resampledNout;
@@ -1635,43 +1933,99 @@ void ThreeDAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer&
             inputLength = currentN;
         }
         
-        // process the sources
+        // the input history is always kept up so switching to the basis filters doesn't start off with a gap, but it is only convolved with them if they're used
+        if (resetProcessingState)
+            hrirBasisConvolver.reset();
+        hrirBasisConvolver.write(inputPtr, inputLength);
+        // (not with the doppler effect's delay line, which delays each source's input before it is convolved)
+        const bool dopplerTaps = dopplerOn && dopplerMode == DopplerMode::DELAY_LINE;
+        const HRIRBasisFilters* basis = renderingEngine == RenderingEngine::BASIS_FILTERS && realTime && !dopplerTaps ? getHRIRBasisFiltersFor(currentHRIRData) : nullptr;
+        const float* basisConvolvedInput = basis ? hrirBasisConvolver.convolve(*basis, inputLength) : nullptr;
+        // the speakers' hrirs only need interpolating when the hrir data changes, and their feeds start from silence whenever they start being used again
+        const bool useVirtualSpeakers = renderingEngine == RenderingEngine::VIRTUAL_SPEAKERS && realTime;
+        if (useVirtualSpeakers) {
+            if (virtualSpeakers.getHRIRData() != currentHRIRData)
+                virtualSpeakers.setHRIRData(currentHRIRData);
+            if (!virtualSpeakersInUse || resetProcessingState)
+                virtualSpeakers.reset();
+            virtualSpeakers.beginBlock(inputLength);
+        }
+        virtualSpeakersInUse = useVirtualSpeakers;
+        // likewise the bus's decoding filters only change with the order, and the sources keep convolving their own hrirs until the decoder's fit is done
+        const HRIRSphericalHarmonics* ambisonicDecoder = renderingEngine == RenderingEngine::AMBISONICS && realTime ? ambisonicDecoderForAudio.load(std::memory_order_acquire) : nullptr;
+        const bool useAmbisonicBus = ambisonicDecoder && ambisonicDecoder->isReady();
+        if (useAmbisonicBus) {
+            if (ambisonicBus.getDecoder() != ambisonicDecoder) {
+                ambisonicBus.setDecoder(ambisonicDecoder);
+                ambisonicBus.reset();
+            }
+            if (!ambisonicBusInUse || resetProcessingState)
+                ambisonicBus.reset();
+            ambisonicBus.beginBlock(inputLength);
+        }
+        ambisonicBusInUse = useAmbisonicBus;
+        
+        // process the sources, the positions are updated here one after another and then the unmuted ones are rendered together
+        int sourcesToRender[maxNumSources];
+        int numSourcesToRender = 0;
         {
             Sources* copy = nullptr;
             const std::unique_lock<Mutex> lock (sources.get(copy), std::try_to_lock);
             if (lock.owns_lock() && copy) {
-                for (int s = 0; s < (const int)copy->size(); ++s)
+                // an undo can bring back more sources than the capacity has since been lowered to, those stay silent
+                const int numSources = std::min((int)copy->size(), (int)playableSources.size());
+                for (int s = 0; s < numSources; ++s)
                 {   // update the moving source position here for those sources automated on a path
 					if (lockSourcesToPaths && playing) {
 						const auto endOfBufferPosSec = (loopingEnabled && posSEC + thisBufferDuration >= loopRegionEnd) ?
 							loopRegionBegin + posSEC + thisBufferDuration - loopRegionEnd : posSEC + thisBufferDuration;
 						(*copy)[s].setParametricPosition(endOfBufferPosSec, playableSources[s].prevPathPosIndex, 
-														 *sourcePathPositionsFromDAW[s]);		
+														 s < numAutomatableSources ? (float)*sourcePathPositionsFromDAW[s] : 0.0f);
+						playableSources[s].setHRIRBaker(loopingEnabled && bakeLoopedPathHRIRs ? &hrirBaker : nullptr, s, endOfBufferPosSec);
+					} else {
+						playableSources[s].setHRIRBaker(nullptr, s, 0);
 					}
 					// serves as a single point of update for the positional state to ensure positional continuity btw buffers
                     playableSources[s].updateFromSoundSource((*copy)[s]);
                     playableSources[s].setDopplerOn(dopplerOn, speedOfSound);
+                    playableSources[s].setBasisFilterRendering(basis, basisConvolvedInput);
+                    playableSources[s].setVirtualSpeakerRendering(useVirtualSpeakers ? &virtualSpeakers : nullptr);
+                    playableSources[s].setAmbisonicRendering(useAmbisonicBus ? &ambisonicBus : nullptr);
                     if (resetProcessingState)
                         playableSources[s].resetProcessingState();
                     if (! playableSources[s].getSourceMuted())
-                        playableSources[s].processAudio(inputPtr, inputLength, outputPtr, realTime);
+                        sourcesToRender[numSourcesToRender++] = s;
                 }
-                prevSourcesSize = copy->size();
+                prevSourcesSize = numSources;
                 sources.tryToUpdate(copy);
             } else { // failed to get the lock, so just use the previous PlayableSoundSource data to process this buffer
                 for (int s = 0; s < (const int)prevSourcesSize; ++s)
                 {   // compute approximated position if the source was previously moving since we don't have access to the interps of the locked source.  this is crucial to avoid glitches with the dopper effect on, not so important without the doppler as the ocassional glitches aren't noticable
                     playableSources[s].advancePosition();
+                    playableSources[s].setHRIRBaker(nullptr, s, 0);
+                    playableSources[s].setBasisFilterRendering(basis, basisConvolvedInput);
+                    playableSources[s].setVirtualSpeakerRendering(useVirtualSpeakers ? &virtualSpeakers : nullptr);
+                    playableSources[s].setAmbisonicRendering(useAmbisonicBus ? &ambisonicBus : nullptr);
                     if (! playableSources[s].getSourceMuted())
-                        playableSources[s].processAudio(inputPtr, inputLength, outputPtr, realTime);
+                        sourcesToRender[numSourcesToRender++] = s;
                 }
             }
         }
         
+        // the virtual speakers and ambisonic bus are summed into by every source, so those sources have to take turns (they're cheap anyway)
+        renderSources(sourcesToRender, numSourcesToRender, inputPtr, inputLength, outputPtr, realTime,
+                      !useVirtualSpeakers && !useAmbisonicBus && numSourcesToRender > 1 && inputLength >= minBlockSizeForWorkers);
+        
+        if (useVirtualSpeakers)
+            virtualSpeakers.render(outputPtr, inputLength);
+        if (useAmbisonicBus)
+            ambisonicBus.render(outputPtr, inputLength);
+        
         // resample the processed audio back to the original sample rate of the buffer given to us
-        if (fs != sampleRate_HRTF) {
-            unsamplerCh1.unsampleLinear(outputResampled, resampledNout, output);
-            unsamplerCh2.unsampleLinear(&outputResampled[resampledNout], resampledNout, &output[currentN]);
+        if (fs != hrirDataSampleRate) {
+            const float* unsamplerInput[] = {&outputResampled[0], &outputResampled[resampledNout]};
+            float* unsamplerOutput[] = {&output[0], &output[currentN]};
+            unsampler.unsample(unsamplerInput, resampledNout, unsamplerOutput, currentN);
         }
         
         // copy final data to output buffer
@@ -1679,6 +2033,15 @@ void ThreeDAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer&
             buffer.copyFromWithRamp(ch, 0, &output[ch*currentN], currentN, 0.18f * prevWetOutputVolume, 0.18f * wetOutputVolume);
             //buffer.copyFrom(ch, 0, &output[ch*currentN], currentN, 0.18f * wetOutputVolume); // 0.18 scales the volume to about the input volume for the default single source in front of the listener at rae coord (1,0,0)
         
+        if (!dryDelay.empty()) {
+            cauto delayLength = (int)dryDelay.size() / 2;
+            for (int n = 0; n < currentN; ++n) {
+                for (int ch = 0; ch < 2; ++ch)
+                    std::swap(stereoInput[ch*currentN + n], dryDelay[ch*delayLength + dryDelayPos]);
+                dryDelayPos = (dryDelayPos + 1) % delayLength;
+            }
+        }
+        
         if (dryOutputVolume > 0) {
             cauto dovStart = prevDryOutputVolume;
             cauto dovInc = (dryOutputVolume - prevDryOutputVolume) / currentN;
@@ -1723,10 +2086,19 @@ void ThreeDAudioProcessor::getStateInformation (MemoryBlock& destData)
 //    xml.setAttribute ("uiHeight", lastUIHeight);
     xml.setAttribute("dopplerOn", dopplerOn);
     xml.setAttribute("speedOfSound", speedOfSound);
+    xml.setAttribute("dopplerMode", (int)dopplerMode.load());
     xml.setAttribute("loopRegionBegin", loopRegionBegin);
     xml.setAttribute("loopRegionEnd", loopRegionEnd);
     xml.setAttribute("loopingEnabled", loopingEnabled);
     xml.setAttribute("processingMode", (int)processingMode.load());
+    xml.setAttribute("minimumPhaseHRIRs", minimumPhaseHRIRs.load());
+    xml.setAttribute("realTimeHRIRInterpolationQuality", (int)realTimeHRIRInterpolationQuality.load());
+    xml.setAttribute("offlineHRIRInterpolationQuality", (int)offlineHRIRInterpolationQuality.load());
+    xml.setAttribute("bakeLoopedPathHRIRs", bakeLoopedPathHRIRs.load());
+    xml.setAttribute("renderingEngine", (int)renderingEngine.load());
+    xml.setAttribute("ambisonicOrder", ambisonicOrder.load());
+    xml.setAttribute("sourceCapacity", sourceCapacity.load());
+    xml.setAttribute("resamplerQuality", (int)resamplerQuality.load());
     xml.setAttribute("wetOutputVolume", wetOutputVolume.load());
     xml.setAttribute("dryOutputVolume", dryOutputVolume.load());
     // add all the data from the sources array
@@ -1760,10 +2132,17 @@ void ThreeDAudioProcessor::setStateInformation (const void* data, int sizeInByte
 //            lastUIHeight = xmlState->getIntAttribute ("uiHeight", lastUIHeight);
             dopplerOn = xmlState->getBoolAttribute("dopplerOn", false);
             speedOfSound = xmlState->getDoubleAttribute("speedOfSound", defaultSpeedOfSound);
+            setDopplerMode((DopplerMode)xmlState->getIntAttribute("dopplerMode", (int)DopplerMode::DELAY_LINE));
             loopRegionBegin = xmlState->getDoubleAttribute("loopRegionBegin", -1.0);
             loopRegionEnd = xmlState->getDoubleAttribute("loopRegionEnd", -1.0);
             loopingEnabled = xmlState->getBoolAttribute("loopingEnabled", loopRegionBegin != -1 && loopRegionEnd != -1);
             setProcessingMode((ProcessingMode)xmlState->getIntAttribute("processingMode", 2));
+            setMinimumPhaseHRIRs(xmlState->getBoolAttribute("minimumPhaseHRIRs", false));
+            setHRIRInterpolationQuality(true, (HRIRInterpolationQuality)xmlState->getIntAttribute("realTimeHRIRInterpolationQuality", (int)HRIRInterpolationQuality::TRILINEAR));
+            setHRIRInterpolationQuality(false, (HRIRInterpolationQuality)xmlState->getIntAttribute("offlineHRIRInterpolationQuality", (int)HRIRInterpolationQuality::FULL));
+            bakeLoopedPathHRIRs = xmlState->getBoolAttribute("bakeLoopedPathHRIRs", false);
+            setAmbisonicOrder(xmlState->getIntAttribute("ambisonicOrder", AmbisonicBus::defaultOrder));
+            setRenderingEngine((RenderingEngine)xmlState->getIntAttribute("renderingEngine", (int)RenderingEngine::HRIR_CONVOLUTION));
             wetOutputVolume = xmlState->getDoubleAttribute("wetOutputVolume", 1.0);
             dryOutputVolume = xmlState->getDoubleAttribute("dryOutputVolume", 0.0);
             // restore all the saved sources and their state stuff
@@ -1785,7 +2164,9 @@ void ThreeDAudioProcessor::setStateInformation (const void* data, int sizeInByte
                     makeSourcesVisibleForPathAutomationView();
             }
             saveCurrentState(1);
-            
+            // after the sources so it makes room for all of them
+            setSourceCapacity(xmlState->getIntAttribute("sourceCapacity", defaultSourceCapacity));
+            setResamplerQuality((ResamplerQuality)xmlState->getIntAttribute("resamplerQuality", (int)ResamplerQuality::NORMAL));
         }
     }
 //    // update the editor with the new window size loaded from the settings
@@ -36,15 +36,28 @@
 #include "SoundSource.h"
 #include "Resampler.h"
 #include "ConcurrentResource.h"
+#include "HRIRBaker.h"
+#include "HRIRSphericalHarmonics.h"
+#include "HRIRBasisFilters.h"
+#include "WorkerPool.h"
+#include <map>
+#include <thread>
 
-// keeps track of the number of plugin instances so we can only use one copy of the HRIR data
-static int numRefs = 0;
 // possible states for GUI display
 enum class DisplayState { MAIN, PATH_AUTOMATION, SETTINGS, NUM_DISPLAY_STATES };
 // realtime is lightest on cpu and will not glitch, offline is expensive on cpu and may glitch, auto-detect assumes the processing mode from the host
 enum class ProcessingMode { REALTIME, OFFLINE, AUTO_DETECT };
-// max number of sound sources
-static constexpr auto maxNumSources = 8;
+// how the realtime processing renders the sources: each one convolving the input with its own hrirs, the input convolved once with the hrir data's basis
+// filters and each source mixing those (see HRIRBasisFilters), each source panned onto virtual speakers with fixed hrirs (see VirtualSpeakers), or each
+// source encoded into an ambisonic bus that is decoded to binaural once (see AmbisonicBus)
+enum class RenderingEngine { HRIR_CONVOLUTION, BASIS_FILTERS, VIRTUAL_SPEAKERS, AMBISONICS };
+// most sound sources the plugin can be set up for, and how many it is set up for until told otherwise (see ThreeDAudioProcessor::setSourceCapacity())
+static constexpr auto maxNumSources = 128;
+static constexpr auto defaultSourceCapacity = 8;
+// the first this many sources get a host parameter for their position on their path, hosts expect the parameters to stay the same once the plugin is made
+static constexpr auto numAutomatableSources = 8;
+// memory map the hrir data file (shared by all processes, untouched pages are never read from disk) instead of reading it all into private memory
+static constexpr auto hrirDataMemoryMapped = true;
 // making life easier
 using Sources = std::vector<SoundSource>;
 using Locker = std::lock_guard<Mutex>;
@@ -154,6 +167,9 @@ public:
     // for the doppler effect
     void setSpeedOfSound(float newSpeedOfSound);
     bool dopplerOn = false;
+    // reallocates the sources' doppler buffers for the mode (with the processing suspended while it happens), not realtime safe
+    void setDopplerMode(DopplerMode newMode);
+    std::atomic<DopplerMode> dopplerMode {DopplerMode::DELAY_LINE};
     float speedOfSound = defaultSpeedOfSound;
     float maxSpeedOfSound = 500.0f;
     float minSpeedOfSound = 0.1f;
@@ -186,6 +202,38 @@ public:
     std::atomic<ProcessingMode> processingMode {ProcessingMode::AUTO_DETECT};
     std::atomic<bool> realTime {true};
     std::atomic<bool> isHostRealTime {false};
+    // render with shorter minimum phase hrirs and put each ear's onset delay back with a fractional delay line instead of convolving with the full hrirs
+    void setMinimumPhaseHRIRs(bool enabled);
+    std::atomic<bool> minimumPhaseHRIRs {false};
+    // how many neighboring hrirs get blended for each processing mode, realtime defaults to the cheaper tri-linear interpolation
+    std::atomic<HRIRInterpolationQuality> realTimeHRIRInterpolationQuality {HRIRInterpolationQuality::TRILINEAR};
+    std::atomic<HRIRInterpolationQuality> offlineHRIRInterpolationQuality {HRIRInterpolationQuality::FULL};
+    // set one of the above, picking HRIRInterpolationQuality::SPHERICAL_HARMONICS starts fitting the hrir data in the background if that isn't done yet
+    void setHRIRInterpolationQuality(bool forRealTime, HRIRInterpolationQuality newQuality);
+    // times interpolating hrirs at each HRIRInterpolationQuality with the hrir data currently in use (if not done already for it), call from the gui
+    void measureHRIRInterpolationCosts();
+    // microseconds per interpolated hrir for each HRIRInterpolationQuality, -1 until measured (the spherical harmonics stay -1 until they are fitted)
+    std::array<std::atomic<float>, 4> hrirInterpolationCosts {{{-1.0f}, {-1.0f}, {-1.0f}, {-1.0f}}};
+    // bake the hrirs along the sources' paths over the loop region in the background while looping, so the realtime processing just looks them up, see HRIRBaker
+    std::atomic<bool> bakeLoopedPathHRIRs {false};
+    std::size_t getBakedHRIRsMemorySize() const noexcept;
+    // bytes taken by the doppler delay lines of the source (0 if there isn't a playable source for it)
+    std::size_t getDopplerMemorySize(int sourceIndex) const;
+    // picking RenderingEngine::BASIS_FILTERS starts finding the basis filters of the hrir data in the background if that isn't done yet, until they are ready
+    // the sources keep convolving their own hrirs
+    // likewise for RenderingEngine::AMBISONICS and the fit of the hrir data that decodes the bus
+    void setRenderingEngine(RenderingEngine newEngine);
+    std::atomic<RenderingEngine> renderingEngine {RenderingEngine::HRIR_CONVOLUTION};
+    // how many sources there can be, a power of 2 from 1 to maxNumSources that is never less than the number of sources there are now. the playableSources
+    // for them are made and allocated here (with the processing suspended while it happens) so processBlock() never has to, not realtime safe
+    void setSourceCapacity(int newCapacity);
+    std::atomic<int> sourceCapacity {defaultSourceCapacity};
+    // order of the ambisonic bus (1 to AmbisonicBus::maxOrder), setting it while RenderingEngine::AMBISONICS is picked starts fitting its decoder if needed
+    void setAmbisonicOrder(int newOrder);
+    std::atomic<int> ambisonicOrder {AmbisonicBus::defaultOrder};
+    // how well the audio is resampled to and from the hrir data's sample rate (when the host's is different), higher quality has more latency
+    void setResamplerQuality(ResamplerQuality newQuality);
+    std::atomic<ResamplerQuality> resamplerQuality {ResamplerQuality::NORMAL};
     // show the controls for that view
     //bool showHelp = false;
     // for letting the GL know when its display lists for drawing the path and pathPos interps for each source are updated
@@ -194,14 +242,85 @@ public:
     //std::array<std::atomic<bool>, maxNumSources> pathChangeds;
     //std::array<std::atomic<bool>, maxNumSources> pathPosChangeds;
     // the visual representation of sound sources along with temporary copies to support undo/redos
-    RealtimeConcurrent<Sources, 3> sources;
+    RealtimeConcurrent<Sources, 4> sources;
     //AudioPlayHead::CurrentPositionInfo gPositionInfo;
-    std::array<std::atomic<AudioParameterFloat*>, maxNumSources> sourcePathPositionsFromDAW; // for source position automation from DAW
+    std::array<std::atomic<AudioParameterFloat*>, numAutomatableSources> sourcePathPositionsFromDAW; // for source position automation from DAW
     std::atomic<float> wetOutputVolume {1.0f};
     std::atomic<float> dryOutputVolume {0.0f};
     float savedMixValue = wetOutputVolume / (wetOutputVolume + dryOutputVolume);
+    // so the editor can show if the hrir data is still loading or failed to load
+    HRIRData::State getHRIRDataState() const noexcept;
+    // so the editor can show how much the hrtf data file lost in conversion to the stored precision, null until it is loaded
+    const HRIRData::ConversionError* getHRIRConversionError() const noexcept;
+    // interpolated hrirs shared by all the playableSources, so the same direction isn't interpolated over and over
+    HRIRCache hrirCache;
     
 private:
+    // the hrir data file shared by all plugin instances (at sampleRate_HRTF), loaded on a background thread
+    std::shared_ptr<HRIRData> fileHRIRData;
+    // the sources are rendered at the host's sample rate up to maxSampleRate_HRTF (and at an even fraction of it above that, resampling to and from it), this
+    // is what the hrir data and everything made from it below are at
+    double hrirDataSampleRate = sampleRate_HRTF;
+    int maxHRIRLength = numTimeSteps;
+    // switch the hrir data and everything made from it to sampleRate, converting the file's hrirs to it (or loading them from a cache file) on a background
+    // thread the first time, from prepareToPlay()
+    void setHRIRDataSampleRate(double sampleRate);
+    // everything made from the hrir data at one sample rate, kept around after the sample rate changes since the audio processing and hrirBaker may still
+    // be pointing into it
+    struct HRIRDataSet
+    {
+        std::shared_ptr<HRIRData> hrirData, minimumPhaseHRIRData;
+        std::shared_ptr<HRIRSphericalHarmonics> hrirSphericalHarmonics, minimumPhaseHRIRSphericalHarmonics;
+        std::shared_ptr<HRIRBasisFilters> hrirBasisFilters, minimumPhaseHRIRBasisFilters;
+        std::array<std::shared_ptr<HRIRSphericalHarmonics>, AmbisonicBus::maxOrder + 1> ambisonicDecoders;
+    };
+    std::map<long, HRIRDataSet> hrirDataSets;
+    // held while the members below are changed or read off the audio thread, the sample rate can change on another thread than the gui's
+    mutable std::mutex hrirDataLock;
+    // the hrir data at hrirDataSampleRate
+    std::shared_ptr<HRIRData> hrirData;
+    // minimum phase version of the hrir data, made (or loaded from its cache file) on a background thread the first time it is enabled and then kept around
+    void makeMinimumPhaseHRIRData();
+    std::shared_ptr<HRIRData> minimumPhaseHRIRData;
+    std::atomic<const HRIRData*> minimumPhaseHRIRDataForAudio {nullptr};
+    // the minimum phase hrir data once it is made and enabled, otherwise the full hrir data
+    const HRIRData* getHRIRDataToProcessWith() const noexcept;
+    // spherical harmonic fits of the full and minimum phase hrir data, started the first time HRIRInterpolationQuality::SPHERICAL_HARMONICS is picked and then kept around
+    void fitHRIRSphericalHarmonics();
+    std::shared_ptr<HRIRSphericalHarmonics> hrirSphericalHarmonics;
+    std::shared_ptr<HRIRSphericalHarmonics> minimumPhaseHRIRSphericalHarmonics;
+    std::atomic<const HRIRSphericalHarmonics*> hrirSphericalHarmonicsForAudio {nullptr};
+    std::atomic<const HRIRSphericalHarmonics*> minimumPhaseHRIRSphericalHarmonicsForAudio {nullptr};
+    // the fit of data once it is done, otherwise nullptr
+    const HRIRSphericalHarmonics* getHRIRSphericalHarmonicsFor(const HRIRData* data) const noexcept;
+    // basis filters of the full and minimum phase hrir data, found the first time RenderingEngine::BASIS_FILTERS is picked and then kept around
+    void findHRIRBasisFilters();
+    std::shared_ptr<HRIRBasisFilters> hrirBasisFilters;
+    std::shared_ptr<HRIRBasisFilters> minimumPhaseHRIRBasisFilters;
+    std::atomic<const HRIRBasisFilters*> hrirBasisFiltersForAudio {nullptr};
+    std::atomic<const HRIRBasisFilters*> minimumPhaseHRIRBasisFiltersForAudio {nullptr};
+    // the basis filters of data once they are found, otherwise nullptr
+    const HRIRBasisFilters* getHRIRBasisFiltersFor(const HRIRData* data) const noexcept;
+    // the input convolved with the basis filters for all the playableSources, only accessed from prepareToPlay() and processBlock()
+    HRIRBasisConvolver hrirBasisConvolver;
+    // the virtual speakers the playableSources pan onto, only accessed from prepareToPlay() and processBlock()
+    VirtualSpeakers virtualSpeakers;
+    bool virtualSpeakersInUse = false;
+    // the decoders of the ambisonic bus for each order, spherical harmonic fits of the full hrir data (the fit has no onset delays to put back, so the minimum
+    // phase hrirs aren't used for it) made the first time an order is used and kept around since the audio thread may still be decoding with the last one
+    void fitAmbisonicDecoder();
+    std::array<std::shared_ptr<HRIRSphericalHarmonics>, AmbisonicBus::maxOrder + 1> ambisonicDecoders;
+    std::atomic<const HRIRSphericalHarmonics*> ambisonicDecoderForAudio {nullptr};
+    // the bus the playableSources are encoded into, only accessed from prepareToPlay() and processBlock()
+    AmbisonicBus ambisonicBus;
+    bool ambisonicBusInUse = false;
+    // only accessed from processBlock(), the hrir data, spherical harmonics, and interpolation quality the playableSources were last handed
+    const HRIRData* currentHRIRData = nullptr;
+    const HRIRSphericalHarmonics* currentHRIRSphericalHarmonics = nullptr;
+    HRIRInterpolationQuality currentHRIRInterpolationQuality = HRIRInterpolationQuality::FULL;
+    // only accessed from measureHRIRInterpolationCosts()
+    const HRIRData* hrirInterpolationCostsHRIRData = nullptr;
+    const HRIRSphericalHarmonics* hrirInterpolationCostsHRIRSphericalHarmonics = nullptr;
   #ifdef DEMO // Demo version only
     DialogWindow::LaunchOptions buyMeWindowLauncher;
     DialogWindow* buyMeWindow = nullptr;
@@ -209,18 +328,49 @@ private:
     float prevWetOutputVolume = wetOutputVolume;
     float prevDryOutputVolume = dryOutputVolume;
 	int maxBufferSizePreparedFor = -1;
+    // what the hrirBaker bakes next, called on its thread
+    bool getHRIRBakingJob(HRIRBaker::Job& job);
     // version of sources that can be used to process audio, only updated in processBlock() and is therefore thread-safe to use for processing
     std::vector<PlayableSoundSource> playableSources;
+    // make playableSources the size of sourceCapacity and get any new ones ready to go like the others, only while processBlock() can't be running
+    void preparePlayableSources();
     int prevSourcesSize = 0; // see processBlock() for useage
+    // held while playableSources is resized, or looked at from threads other than the audio thread
+    mutable std::mutex playableSourcesLock;
+    // makes the playableSources' doppler delay lines longer as the sources go farther away or the speed of sound goes down (and shorter when they are far
+    // too long) every dopplerResizeInterval ms, which they swap in themselves, so processBlock() never allocates for them, see DopplerBuffer. the new ones
+    // are made (and the old ones freed) without holding playableSourcesLock, which processBlock() takes when the block size grows
+    void resizeDopplerDelayLines();
+    static constexpr int dopplerResizeInterval = 50;
+    std::mutex dopplerResizerWakeLock;
+    std::condition_variable dopplerResizerWake;
+    std::atomic<bool> dopplerResizerShouldExit {false};
+    std::thread dopplerResizer;
+    // spreads rendering the playableSources over a few threads, started in prepareToPlay() and only used from processBlock()
+    WorkerPool sourceRenderingPool;
+    // processAudio() keeps a handful of block sized arrays on the stack, so the pool's threads get stacks big enough for blocks of up to
+    // workerMaxBlockSize (maxBufferSizePreparedFor when they were started), bigger blocks are rendered on the calling thread
+    static constexpr std::size_t workerStackBaseSize = 512 * 1024;
+    static constexpr std::size_t workerStackSizePerSample = 128;
+    int workerMaxBlockSize = 0;
+    // each pool thread's sum of the sources it rendered [worker - 1][2 * maxBufferSizePreparedFor], the audio thread renders straight into the output
+    std::vector<float> workerOutputs;
+    // below this block size (or with a single source) handing the sources to the pool costs more than it saves, so they're rendered one after another
+    static constexpr int minBlockSizeForWorkers = 128;
+    void renderSources(const int* sourceIndices, int count, const float* in, int N, float* out, bool realTime, bool parallel) noexcept;
     // temporary SoundSource copies to support undo/redos
     Sources beforeUndo;
     Sources currentUndo;
 //    Lockable<Sources> beforeUndo;
 //    Lockable<Sources> currentUndo;
-    // objects for sample rate conversion
+    // objects for sample rate conversion, the unsampler does both output channels at once
     Resampler resampler;
-    Resampler unsamplerCh1;
-    Resampler unsamplerCh2;
+    Resampler unsampler;
+    // remake the above for the current sample rate, block size and resamplerQuality and report their latency, not realtime safe
+    void prepareResamplers();
+    // the dry input is held back by the resampling latency too so it still lines up with the wet output, 2 channels of the latency apiece
+    std::vector<float> dryDelay;
+    int dryDelayPos = 0;
     // previous buffer's time position from this plugin's perspective
     float posSECprev = 0;
     // prev buf time position from host's perspective
@@ -233,6 +383,8 @@ private:
     // are we playing back audio now?
     std::atomic<bool> playing {false};
     std::atomic<int> resetPlayingCount {0};
+    // declared last so its thread is stopped before anything it reads goes away
+    HRIRBaker hrirBaker {maxNumSources, [this] (HRIRBaker::Job& job) { return getHRIRBakingJob(job); }};
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThreeDAudioProcessor)
 };
 
@@ -25,111 +25,209 @@
  */
 
 #include "Resampler.h"
+#include "Functions.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+constexpr int Resampler::maxNumPhases;
 
-Resampler::Resampler(double new_fs_in, int new_N_in_out, double new_fs_out, bool direction) noexcept
-    : fs_in(new_fs_in), fs_out(new_fs_out), dir(direction)
+static int greatestCommonDivisor(int a, int b) noexcept
 {
-    if (dir) {
-        // 2nd param is N_in for the resampler
-        N_in = new_N_in_out;
-        N_out = fs_out * ((double)N_in) / fs_in;
-    } else {
-        // 2nd param is N_out for the unsampler
-        N_out = new_N_in_out;
-        N_in = fs_in * N_out / fs_out;
-        N_in += 1;
+    while (b != 0) {
+        const int r = a % b;
+        a = b;
+        b = r;
     }
+    return a;
 }
 
-// linearly resamples N_in samples in x at fs_in and spits out ceil(N_out) samples in y at fs_out
-void Resampler::resampleLinear(const float* x, float *y) noexcept
+// modified bessel function of the first kind, order 0, for the kaiser window
+static double besselI0(const double x) noexcept
 {
-    int Nout = N_out;//ceil(N_out);
-    const double this_fs_in = fs_in;
-    const double this_fs_out = fs_out;
-    const double Ts_in = 1.0 / this_fs_in;
-    const double Ts_out = 1.0 / this_fs_out;
-    const double this_offset = offset;
-    const double thisPrevSample = prevSample;
-    if (((double)Nout) * Ts_out + this_offset >= ((double)N_in) * Ts_in) {
-        y[Nout] = 0; // set last output sample to 0 since it is not technically in this output buffer
-        shortBuffer = true;
-    } else {
-        Nout += 1;
-        shortBuffer = false;
+    double sum = 1, term = 1;
+    for (int k = 1; k < 64 && term > 1.0e-12 * sum; ++k) {
+        term *= (0.5 * x / k) * (0.5 * x / k);
+        sum += term;
     }
-    const int thisNout = Nout;
-    int k_low;
-    float x_low, x_high;
-    double t_out, t_in;
-    for (int n = 0; n < thisNout; ++n) {
-        t_out = ((double)n) * Ts_out + this_offset;
-        k_low = t_out * this_fs_in;
-        if (k_low == 0) {
-            x_low = thisPrevSample;
-        } else {
-            x_low = x[k_low-1];
+    return sum;
+}
+
+Resampler::Resampler(double new_fs_in, int new_N_in_out, double new_fs_out, bool direction, int new_numChannels, ResamplerQuality quality)
+    : dir(direction), numChannels(new_numChannels), N_in_out(new_N_in_out)
+{
+    // the ratio of the rates in lowest terms, the output is at input sample inStep/outStep * n for output sample n
+    const int fsIn = std::max(1, (int)std::lround(new_fs_in));
+    const int fsOut = std::max(1, (int)std::lround(new_fs_out));
+    const int divisor = greatestCommonDivisor(fsIn, fsOut);
+    inStep = fsIn / divisor;
+    outStep = fsOut / divisor;
+    numPhases = std::min(outStep, maxNumPhases);
+    
+    // zero crossings each side of the sinc and stopband attenuation (dB) for each quality, the stopband starts at the nyquist frequency of the lower rate
+    static constexpr int zeroCrossings[] = {16, 32, 64};
+    static constexpr double attenuations[] = {70, 90, 120};
+    const int q = (int)quality;
+    // going down in rate the sinc is stretched out over more input samples to cutoff below the output's nyquist frequency
+    const double stretch = std::max(1.0, ((double)inStep) / outStep);
+    halfLength = (int)std::ceil(zeroCrossings[q] * stretch);
+    halfLength = (halfLength + 3) / 4 * 4;
+    const double transitionWidth = (attenuations[q] - 7.95) / (14.36 * zeroCrossings[q]); // fraction of the nyquist frequency (kaiser's estimate)
+    const double cutoff = (1 - 0.5 * transitionWidth) / stretch;
+    const double beta = 0.1102 * (attenuations[q] - 8.7);
+    const double windowScale = 1 / besselI0(beta);
+    const int length = 2 * halfLength;
+    phaseTable.assign((numPhases + 1) * length, 0);
+    for (int p = 0; p <= numPhases; ++p) {
+        float* taps = &phaseTable[p * length];
+        const double phase = ((double)p) / numPhases;
+        double sum = 0;
+        for (int j = 0; j < length; ++j) {
+            // distance of the tap's input sample from the output sample's position
+            const double t = j - halfLength + 1 - phase;
+            const double u = t / halfLength;
+            if (std::abs(u) >= 1)
+                continue;
+            const double x = M_PI * cutoff * t;
+            const double sinc = x == 0 ? 1 : std::sin(x) / x;
+            taps[j] = cutoff * sinc * besselI0(beta * std::sqrt(1 - u*u)) * windowScale;
+            sum += taps[j];
         }
-        x_high = x[k_low];
-        t_in = ((double)k_low) * Ts_in;
-        // y = b     + m                               * x
-        y[n] = x_low + ((x_high - x_low) * this_fs_in) * (t_out - t_in);
+        // unity gain at dc for every phase
+        for (int j = 0; j < length; ++j)
+            taps[j] /= sum;
     }
-    offset = (((double)thisNout) * Ts_out + this_offset) - ((double)N_in) * Ts_in;
-    prevSample = x[N_in-1];
+    
+    // the resampler needs halfLength input samples past an output sample's position, which it waits for by taking its output from that far back. the
+    // unsampler waits at least as long for its input, and a little longer so that its latency is a whole number of output samples
+    if (dir) {
+        latency = halfLength;
+        delayTicks = ((int64_t)halfLength) * outStep;
+    } else {
+        latency = (int)((((int64_t)halfLength) * outStep + inStep - 1) / inStep);
+        delayTicks = ((int64_t)latency) * inStep;
+    }
+    // the most input the resampler is given per buffer, or that the unsampler is given by a resampler going the other way
+    const int maxNin = dir ? N_in_out : (int)((((int64_t)N_in_out) * inStep + outStep - 1) / outStep) + 1;
+    historyLength = length + latency * inStep / outStep + 2 + maxNin + 4;
+    history.assign(numChannels * historyLength, 0);
+    reset();
+}
+
+void Resampler::reset() noexcept
+{
+    std::fill(history.begin(), history.end(), 0.0f);
+    // start with enough silence before the first input sample that the first output sample's taps don't go before the history
+    numHistory = (int)((delayTicks + outStep - 1) / outStep) + halfLength - 1;
+    const int64_t ticks = ((int64_t)numHistory) * outStep - delayTicks;
+    nextIndex = (int)(ticks / outStep);
+    nextPhase = (int)(ticks % outStep);
+    N_out = 0;
+}
+
+void Resampler::resample(const float* const* x, const int Nin, float* const* y) noexcept
+{
+    process(x, Nin, y, getNoutMax());
+}
+
+void Resampler::unsample(const float* const* x, const int Nin, float* const* y, const int Nout) noexcept
+{
+    const int numOut = process(x, Nin, y, Nout);
+    // only if it wasn't fed what the resampler put out
+    for (int ch = 0; ch < numChannels; ++ch)
+        for (int n = numOut; n < Nout; ++n)
+            y[ch][n] = 0;
 }
 
-void Resampler::unsampleLinear(const float* x, const int Nin, float* y) noexcept
+int Resampler::process(const float* const* x, int Nin, float* const* y, const int maxNout) noexcept
 {
-    const double this_fs_in = fs_in;
-    const double this_fs_out = fs_out;
-    const double Ts_in = 1.0 / this_fs_in;
-    const double Ts_out = 1.0 / this_fs_out;
-    const double this_offset = offset;
-    const double thisPrevSample = prevSample;
-    const int thisNout = N_out;
-    int k_low;
-    float x_low, x_high;
-    double t_out, t_in;
-    for (int n = 0; n < thisNout; ++n) {
-        t_out = ((double)n) * Ts_out + this_offset;
-        k_low = t_out * this_fs_in;
-        if (k_low == 0) {
-            x_low = thisPrevSample;
+    Nin = std::min(Nin, historyLength - numHistory);
+    for (int ch = 0; ch < numChannels; ++ch)
+        std::memcpy(&history[ch * historyLength + numHistory], x[ch], Nin * sizeof(float));
+    numHistory += Nin;
+    
+    const int length = 2 * halfLength;
+    const int inWhole = inStep / outStep;
+    const int inFraction = inStep % outStep;
+    const bool exactPhases = numPhases == outStep;
+    int index = nextIndex, phase = nextPhase;
+    int Nout = 0;
+    const float* channels[2];
+    while (Nout < maxNout && index + halfLength < numHistory) {
+        // the phase (and so the taps) is worked out once for all the channels
+        const int row = exactPhases ? phase : (int)((((int64_t)phase) * numPhases + outStep / 2) / outStep);
+        const float* taps = &phaseTable[row * length];
+        const int start = index - halfLength + 1;
+        if (numChannels == 2) {
+            float sums[2];
+            channels[0] = &history[start];
+            channels[1] = &history[historyLength + start];
+            simd::dots<2>(taps, channels, length, sums);
+            y[0][Nout] = sums[0];
+            y[1][Nout] = sums[1];
         } else {
-            x_low = x[k_low-1];
+            for (int ch = 0; ch < numChannels; ++ch)
+                y[ch][Nout] = simd::dot(taps, &history[ch * historyLength + start], length);
+        }
+        ++Nout;
+        index += inWhole;
+        phase += inFraction;
+        if (phase >= outStep) {
+            phase -= outStep;
+            ++index;
+        }
+    }
+    
+    // forget the input the next output sample's taps start after
+    const int consumed = std::max(0, std::min(index - halfLength + 1, numHistory));
+    if (consumed > 0) {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            float* h = &history[ch * historyLength];
+            std::memmove(h, h + consumed, (numHistory - consumed) * sizeof(float));
         }
-        x_high = x[k_low];
-        t_in = ((double)k_low) * Ts_in;
-        // y = b     + m                             * x
-        y[n] = x_low + (x_high - x_low) * this_fs_in * (t_out - t_in);
+        numHistory -= consumed;
+        index -= consumed;
     }
-    offset = (((double)thisNout) * Ts_out + this_offset) - ((double)Nin) * Ts_in;
-    prevSample = x[Nin-1];
+    nextIndex = index;
+    nextPhase = phase;
+    N_out = Nout;
+    return Nout;
 }
 
-int Resampler::getNout() const noexcept
+void Resampler::convert(const float* x, const int Nin, float* y, const int Nout) const
 {
-    if (dir) {
-        // resampling, resamplers have variable buffer size due to the fractional nature of fs_in/fs_out
-        if (shortBuffer) {
-            return N_out;
-        } else {
-            return N_out + 1;
-        }
-    } else {
-        // unsampling, unsamplers should always output the same number of samples per buffer as was initially fed to the associated resampler
-        return N_out;
+    const int length = 2 * halfLength;
+    // x goes halfLength-1 samples into a zero padded copy, so output sample n's taps start at the input sample just before it
+    thread_local std::vector<float> padded;
+    const int lastIndex = Nout > 0 ? (int)((((int64_t)Nout - 1) * inStep) / outStep) : 0;
+    padded.assign(std::max(lastIndex + length, Nin + halfLength - 1), 0.0f);
+    std::copy(x, x + Nin, padded.begin() + halfLength - 1);
+    const bool exactPhases = numPhases == outStep;
+    for (int n = 0; n < Nout; ++n) {
+        const int64_t ticks = ((int64_t)n) * inStep;
+        const int index = (int)(ticks / outStep);
+        const int phase = (int)(ticks % outStep);
+        const int row = exactPhases ? phase : (int)((((int64_t)phase) * numPhases + outStep / 2) / outStep);
+        y[n] = simd::dot(&phaseTable[row * length], &padded[index], length);
     }
 }
 
+int Resampler::getNout() const noexcept
+{
+    return N_out;
+}
+
 // returns the maximum size of the output buffer (used for allocating the output buffer's memory)
 int Resampler::getNoutMax() const noexcept
 {
     if (dir)
-        return N_out + 1;
+        return (int)((((int64_t)N_in_out) * outStep + inStep - 1) / inStep) + 1;
     else
-        return N_out;
+        return N_in_out;
+}
+
+int Resampler::getLatency() const noexcept
+{
+    return latency;
 }
 
 //int Resampler::getNumSamplesLatency()
@@ -27,35 +27,68 @@
 #ifndef __Resampler__
 #define __Resampler__
 
-// NOTE: this whole setup assumes that 1/fs_out !> N_in / fs_in. that is that there is not less than one sample per output buffer on average.
+#include <cstdint>
+#include <vector>
+
+// how many zero crossings of the sinc each side of a sample the resampler looks at, and so how much latency it has
+enum class ResamplerQuality { LOW_LATENCY, NORMAL, HIGH };
+
+/** polyphase windowed sinc sample rate conversion of a block by block stream of one or more channels. the two sample rates (rounded to whole Hz) are kept
+    as an exact ratio of integers so the input and output never drift apart, and each output sample's phase between the input samples picks a row of a
+    precomputed table of kaiser windowed sinc taps that all the channels are then filtered with.
+    the resampler (direction = true) puts out however many samples it can from the input it has been given so far, getNout() of them and never more than
+    getNoutMax(). the unsampler (direction = false) puts out exactly the number of samples per buffer it is asked for, and as long as it is fed everything
+    a resampler going the other way put out for the same buffers its latency always leaves it enough input to do that. both latencies are whole samples at the rate that isn't
+    the hrir data's, so the round trip latency is too. */
 class Resampler
 {
 public:
     Resampler() noexcept {};
-    Resampler(double new_fs_in, int new_N_in, double new_fs_out, bool direction) noexcept;
-    ~Resampler() {};
-    void resampleLinear(const float* x, float* y) noexcept;
-    void unsampleLinear(const float* x, int Nin, float* y) noexcept;
+    // for the resampler N_in_out is the longest input buffer it can be given, for the unsampler it is the most samples it puts out per buffer
+    Resampler(double new_fs_in, int new_N_in_out, double new_fs_out, bool direction, int numChannels = 1, ResamplerQuality quality = ResamplerQuality::NORMAL);
+    // resamples the Nin samples of each channel in x and puts getNout() samples into each channel of y
+    void resample(const float* const* x, int Nin, float* const* y) noexcept;
+    // unsamples the Nin samples of each channel in x and puts Nout samples into each channel of y
+    void unsample(const float* const* x, int Nin, float* const* y, int Nout) noexcept;
+    // back to the state it was constructed in, for when the audio jumps to somewhere else
+    void reset() noexcept;
+    // resamples all Nin samples of x (with silence before and after) into the Nout samples of y with no latency, for short signals like hrirs that are
+    // converted in one go. doesn't touch the streaming state, so any number of threads can share one resampler for this
+    void convert(const float* x, int Nin, float* y, int Nout) const;
     int getNout() const noexcept;
-    int getNoutMax() const noexcept ;
-    //int getNumSamplesLatency();
+    int getNoutMax() const noexcept;
+    // how many samples later the output is than the input, counted at the input sample rate for the resampler and the output sample rate for the unsampler
+    int getLatency() const noexcept;
+    // the resampler and unsampler's phase tables are one row per output sample phase up to this many, beyond that rows are rounded to the nearest of these
+    static constexpr int maxNumPhases = 1024;
 private:
-    // input sample rate
-    double fs_in = 44100;
-    // output sample rate
-    double fs_out = 44100;
-    // length of input buffer
-    int N_in = 0;
-    // length of output buffer (fraction due to sample rate change, however resample only outputs floor(N_out) samples per input buffer and the appropriate time shifting is taken care of with the computation of those samples)
-    double N_out = 0;
+    // filters as many output samples as there is input for (but no more than maxNout) and returns how many
+    int process(const float* const* x, int Nin, float* const* y, int maxNout) noexcept;
     // direction of resampling: true = resample, false = unsample
     bool dir = true;
-    // last sample of the previous input
-    double prevSample = 0;
-    // the time offset of the first resampled sample from the actual begin time of the input buffer, due to the fact that N_out is fractional in nature
-    double offset = 0;
-    // state variable(s) to indicate when we are outputing the occasional "short" buffer from the resampler and when we are indexing into "short" buffers when unsampling
-    bool shortBuffer = false;
+    int numChannels = 0;
+    // input samples per output sample is inStep / outStep
+    int inStep = 1;
+    int outStep = 1;
+    // taps each side of an output sample's position, a multiple of the simd width
+    int halfLength = 0;
+    int numPhases = 0;
+    // numPhases + 1 rows (the last is a whole sample of phase) of 2 * halfLength taps
+    std::vector<float> phaseTable;
+    // how far behind the input the output samples are taken from, in 1/outStep's of an input sample
+    int64_t delayTicks = 0;
+    int latency = 0;
+    // each channel's input history, historyLength samples apiece
+    std::vector<float> history;
+    int historyLength = 0;
+    int numHistory = 0;
+    // input sample just before and phase (in 1/outStep's of an input sample) of the next output sample
+    int nextIndex = 0;
+    int nextPhase = 0;
+    // for the resampler the longest input buffer, for the unsampler the longest output buffer
+    int N_in_out = 0;
+    // how many samples the last process() put out
+    int N_out = 0;
 };
 
 ////#include <stdio.h>
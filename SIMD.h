@@ -0,0 +1,355 @@
+//
+//  SIMD.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __SIMD__
+#define __SIMD__
+
+#include <cstdint>
+#include <cstring>
+
+// which simd instruction sets we get to use is decided at compile time by the compiler flags for the target
+#if defined(__AVX__)
+  #include <immintrin.h>
+  #define SIMD_AVX 1
+  #if defined(__F16C__)
+    #define SIMD_F16C 1
+  #endif
+  #if defined(__FMA__)
+    #define SIMD_FMA 1
+  #endif
+  #if defined(__AVX512F__)
+    #define SIMD_AVX512 1
+  #endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+  #define SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SIMD_SSE 1
+#endif
+
+// so the kernels can be specialized for lengths known at compile time
+#if defined(_MSC_VER)
+  #define SIMD_INLINE __forceinline
+#else
+  #define SIMD_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace simd
+{
+    /** ieee half precision float (stored as its 16 bits) to float */
+    inline float halfToFloat(const std::uint16_t h) noexcept
+    {
+        const std::uint32_t sign = std::uint32_t(h & 0x8000u) << 16;
+        std::uint32_t exponent = (h >> 10) & 0x1fu;
+        std::uint32_t mantissa = h & 0x3ffu;
+        std::uint32_t bits;
+        if (exponent == 0x1f) // inf or nan
+            bits = sign | 0x7f800000u | (mantissa << 13);
+        else if (exponent != 0) // normal
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        else if (mantissa == 0) // zero
+            bits = sign;
+        else { // subnormal half is a normal float
+            exponent = 113;
+            while (!(mantissa & 0x400u)) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+        }
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    /** float to ieee half precision float (stored as its 16 bits), rounding to nearest even */
+    inline std::uint16_t floatToHalf(const float f) noexcept
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        const std::uint16_t sign = (bits >> 16) & 0x8000u;
+        const std::uint32_t absBits = bits & 0x7fffffffu;
+        if (absBits >= 0x7f800000u) // inf or nan
+            return sign | 0x7c00u | (absBits > 0x7f800000u ? 0x200u : 0u);
+        if (absBits >= 0x477ff000u) // rounds to above the largest half (65504)
+            return sign | 0x7c00u;
+        if (absBits < 0x38800000u) { // subnormal half or zero
+            if (absBits < 0x33000000u)
+                return sign;
+            const std::uint32_t mantissa = (absBits & 0x7fffffu) | 0x800000u;
+            const int shift = 126 - int(absBits >> 23);
+            const std::uint32_t halfway = 1u << (shift - 1);
+            const std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+            std::uint32_t h = mantissa >> shift;
+            if (remainder > halfway || (remainder == halfway && (h & 1u)))
+                ++h;
+            return sign | h;
+        }
+        // normal, the rounding may carry into the exponent which is what we want
+        const std::uint32_t rounded = absBits + 0xfffu + ((absBits >> 13) & 1u);
+        return sign | ((rounded - 0x38000000u) >> 13);
+    }
+
+    // so code can be written once for samples stored either as floats or halfs
+    inline float toFloat(const float x) noexcept { return x; }
+    inline float toFloat(const std::uint16_t x) noexcept { return halfToFloat(x); }
+    inline void convert(const float in, float& out) noexcept { out = in; }
+    inline void convert(const std::uint16_t in, std::uint16_t& out) noexcept { out = in; }
+    inline void convert(const float in, std::uint16_t& out) noexcept { out = floatToHalf(in); }
+    inline void convert(const std::uint16_t in, float& out) noexcept { out = halfToFloat(in); }
+
+#if SIMD_AVX
+    /** load 8 consecutive samples as floats */
+    inline __m256 load8(const float* x) noexcept { return _mm256_loadu_ps(x); }
+    inline __m256 load8(const std::uint16_t* x) noexcept
+    {
+      #if SIMD_F16C
+        return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x)));
+      #else
+        return _mm256_setr_ps(halfToFloat(x[0]), halfToFloat(x[1]), halfToFloat(x[2]), halfToFloat(x[3]),
+                              halfToFloat(x[4]), halfToFloat(x[5]), halfToFloat(x[6]), halfToFloat(x[7]));
+      #endif
+    }
+    /** a * b + c */
+    inline __m256 multiplyAdd(const __m256 a, const __m256 b, const __m256 c) noexcept
+    {
+      #if SIMD_FMA
+        return _mm256_fmadd_ps(a, b, c);
+      #else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+      #endif
+    }
+  #if SIMD_AVX512
+    /** load 16 consecutive samples as floats */
+    inline __m512 load16(const float* x) noexcept { return _mm512_loadu_ps(x); }
+    inline __m512 load16(const std::uint16_t* x) noexcept { return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x))); }
+  #endif
+#elif SIMD_SSE
+    /** load 4 consecutive samples as floats */
+    inline __m128 load4(const float* x) noexcept { return _mm_loadu_ps(x); }
+    inline __m128 load4(const std::uint16_t* x) noexcept
+    {
+        // no half conversion instruction, but shifting a half's exponent and mantissa into a float's and scaling by 2^(127-15) is exact
+        // for every finite half (subnormals included), only infs and nans don't survive which hrirs don't have
+        const __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(x)), _mm_setzero_si128());
+        const __m128 magnitude = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13)),
+                                            _mm_castsi128_ps(_mm_set1_epi32((127 + 112) << 23)));
+        return _mm_or_ps(magnitude, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16)));
+    }
+#elif SIMD_NEON
+    /** load 4 consecutive samples as floats */
+    inline float32x4_t load4(const float* x) noexcept { return vld1q_f32(x); }
+    inline float32x4_t load4(const std::uint16_t* x) noexcept { return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(x))); }
+#endif
+
+#if SIMD_AVX
+    /** sum of the 8 lanes */
+    inline float horizontalSum(const __m256 x) noexcept
+    {
+        __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+        sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+        sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1));
+        return _mm_cvtss_f32(sum4);
+    }
+#elif SIMD_SSE
+    /** sum of the 4 lanes */
+    inline float horizontalSum(__m128 x) noexcept
+    {
+        x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+        x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+        return _mm_cvtss_f32(x);
+    }
+#endif
+
+    /** sum of x[i] * y[i] for i = 0 to n-1, with no alignment requirements */
+    SIMD_INLINE float dot(const float* x, const float* y, const int n) noexcept
+    {
+        int i = 0;
+        float sum = 0;
+#if SIMD_AVX
+        // two accumulators to hide the add latency
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+        for (; i + 16 <= n; i += 16) {
+            sum0 = multiplyAdd(_mm256_loadu_ps(x + i    ), _mm256_loadu_ps(y + i    ), sum0);
+            sum1 = multiplyAdd(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), sum1);
+        }
+        sum = horizontalSum(_mm256_add_ps(sum0, sum1));
+#elif SIMD_SSE
+        __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+        for (; i + 8 <= n; i += 8) {
+            sum0 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i    ), _mm_loadu_ps(y + i    )), sum0);
+            sum1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)), sum1);
+        }
+        sum = horizontalSum(_mm_add_ps(sum0, sum1));
+#elif SIMD_NEON
+        float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+        for (; i + 8 <= n; i += 8) {
+            sum0 = vfmaq_f32(sum0, vld1q_f32(x + i    ), vld1q_f32(y + i    ));
+            sum1 = vfmaq_f32(sum1, vld1q_f32(x + i + 4), vld1q_f32(y + i + 4));
+        }
+        sum = vaddvq_f32(vaddq_f32(sum0, sum1));
+#else
+        float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+        for (; i + 4 <= n; i += 4) {
+            sum0 += x[i    ] * y[i    ];
+            sum1 += x[i + 1] * y[i + 1];
+            sum2 += x[i + 2] * y[i + 2];
+            sum3 += x[i + 3] * y[i + 3];
+        }
+        sum = (sum0 + sum1) + (sum2 + sum3);
+#endif
+        for (; i < n; ++i)
+            sum += x[i] * y[i];
+        return sum;
+    }
+
+    /** dot() for a length known at compile time, so the loops get fully unrolled and the tail disappears */
+    template <int n>
+    SIMD_INLINE float dot(const float* x, const float* y) noexcept
+    {
+        return dot(x, y, n);
+    }
+
+    /** calls f(k) for k = begin to end-1 fully unrolled, so arrays indexed by k inside can live in registers */
+    template <int begin, int end>
+    struct Unroll
+    {
+        template <typename F>
+        static SIMD_INLINE void run(F&& f) noexcept
+        {
+            f(begin);
+            Unroll<begin + 1, end>::run(f);
+        }
+    };
+    template <int end>
+    struct Unroll<end, end>
+    {
+        template <typename F>
+        static SIMD_INLINE void run(F&&) noexcept {}
+    };
+
+    /** sums[k] = dot(x, ys[k], n) for each of the numYs ys, but each x is only loaded once for all of them */
+    template <int numYs>
+    SIMD_INLINE void dots(const float* x, const float* const* yPtrs, const int n, float* sums) noexcept
+    {
+        // local copies of the pointers so the compiler knows the stores can't change them
+        const float* ys[numYs];
+        Unroll<0, numYs>::run([&] (const int k) { ys[k] = yPtrs[k]; });
+        int i = 0;
+#if SIMD_AVX
+        __m256 acc[numYs];
+        Unroll<0, numYs>::run([&] (const int k) { acc[k] = _mm256_setzero_ps(); });
+        for (; i + 8 <= n; i += 8) {
+            const __m256 xi = _mm256_loadu_ps(x + i);
+            Unroll<0, numYs>::run([&] (const int k) { acc[k] = multiplyAdd(xi, _mm256_loadu_ps(ys[k] + i), acc[k]); });
+        }
+        Unroll<0, numYs>::run([&] (const int k) { sums[k] = horizontalSum(acc[k]); });
+#elif SIMD_SSE
+        __m128 acc[numYs];
+        Unroll<0, numYs>::run([&] (const int k) { acc[k] = _mm_setzero_ps(); });
+        for (; i + 4 <= n; i += 4) {
+            const __m128 xi = _mm_loadu_ps(x + i);
+            Unroll<0, numYs>::run([&] (const int k) { acc[k] = _mm_add_ps(_mm_mul_ps(xi, _mm_loadu_ps(ys[k] + i)), acc[k]); });
+        }
+        Unroll<0, numYs>::run([&] (const int k) { sums[k] = horizontalSum(acc[k]); });
+#elif SIMD_NEON
+        float32x4_t acc[numYs];
+        Unroll<0, numYs>::run([&] (const int k) { acc[k] = vdupq_n_f32(0); });
+        for (; i + 4 <= n; i += 4) {
+            const float32x4_t xi = vld1q_f32(x + i);
+            Unroll<0, numYs>::run([&] (const int k) { acc[k] = vfmaq_f32(acc[k], xi, vld1q_f32(ys[k] + i)); });
+        }
+        Unroll<0, numYs>::run([&] (const int k) { sums[k] = vaddvq_f32(acc[k]); });
+#else
+        Unroll<0, numYs>::run([&] (const int k) { sums[k] = 0; });
+#endif
+        for (; i < n; ++i) {
+            const float xi = x[i];
+            Unroll<0, numYs>::run([&] (const int k) { sums[k] += xi * ys[k][i]; });
+        }
+    }
+
+    /** dots() for a length known at compile time */
+    template <int n, int numYs>
+    SIMD_INLINE void dots(const float* x, const float* const* ys, float* sums) noexcept
+    {
+        dots<numYs>(x, ys, n, sums);
+    }
+
+    /** out[k] = x at indices[k] + 1 + fractions[k] (fractions from 0 to 1) on the cubic lagrange polynomial through x[indices[k]] to x[indices[k] + 3].
+        each output's 4 samples are loaded together and transposed with the next 3 outputs' so the weights are worked out 4 outputs at a time */
+    SIMD_INLINE void interpolateCubic(const float* x, const int* indices, const float* fractions, float* out, const int n) noexcept
+    {
+        int k = 0;
+#if SIMD_AVX || SIMD_SSE
+        const __m128 one = _mm_set1_ps(1), two = _mm_set1_ps(2), half = _mm_set1_ps(0.5f), sixth = _mm_set1_ps(1.0f / 6);
+        for (; k + 4 <= n; k += 4) {
+            __m128 x0 = _mm_loadu_ps(x + indices[k    ]);
+            __m128 x1 = _mm_loadu_ps(x + indices[k + 1]);
+            __m128 x2 = _mm_loadu_ps(x + indices[k + 2]);
+            __m128 x3 = _mm_loadu_ps(x + indices[k + 3]);
+            _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+            const __m128 f = _mm_loadu_ps(fractions + k);
+            const __m128 fp1 = _mm_add_ps(f, one), fm1 = _mm_sub_ps(f, one), fm2 = _mm_sub_ps(f, two);
+            const __m128 a = _mm_mul_ps(f, fm1), b = _mm_mul_ps(fp1, fm2);
+            __m128 y = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(a, fm2), sixth), x0);
+            y = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(b, fm1), half), x1), y);
+            y = _mm_sub_ps(y, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(b, f), half), x2));
+            y = _mm_add_ps(y, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(a, fp1), sixth), x3));
+            _mm_storeu_ps(out + k, y);
+        }
+#elif SIMD_NEON
+        for (; k + 4 <= n; k += 4) {
+            const float32x4x2_t t01 = vtrnq_f32(vld1q_f32(x + indices[k    ]), vld1q_f32(x + indices[k + 1]));
+            const float32x4x2_t t23 = vtrnq_f32(vld1q_f32(x + indices[k + 2]), vld1q_f32(x + indices[k + 3]));
+            const float32x4_t x0 = vcombine_f32(vget_low_f32 (t01.val[0]), vget_low_f32 (t23.val[0]));
+            const float32x4_t x1 = vcombine_f32(vget_low_f32 (t01.val[1]), vget_low_f32 (t23.val[1]));
+            const float32x4_t x2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+            const float32x4_t x3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+            const float32x4_t f = vld1q_f32(fractions + k);
+            const float32x4_t fp1 = vaddq_f32(f, vdupq_n_f32(1)), fm1 = vsubq_f32(f, vdupq_n_f32(1)), fm2 = vsubq_f32(f, vdupq_n_f32(2));
+            const float32x4_t a = vmulq_f32(f, fm1), b = vmulq_f32(fp1, fm2);
+            float32x4_t y = vmulq_f32(vmulq_n_f32(vmulq_f32(a, fm2), 1.0f / 6), x0);
+            y = vsubq_f32(vmulq_f32(vmulq_n_f32(vmulq_f32(b, fm1), 0.5f), x1), y);
+            y = vsubq_f32(y, vmulq_f32(vmulq_n_f32(vmulq_f32(b, f), 0.5f), x2));
+            y = vfmaq_f32(y, vmulq_n_f32(vmulq_f32(a, fp1), 1.0f / 6), x3);
+            vst1q_f32(out + k, y);
+        }
+#endif
+        for (; k < n; ++k) {
+            const float* const xk = x + indices[k];
+            const float f = fractions[k];
+            const float fp1 = f + 1, fm1 = f - 1, fm2 = f - 2;
+            const float a = f * fm1, b = fp1 * fm2;
+            out[k] = - xk[0] * a * fm2 * (1.0f / 6)
+                     + xk[1] * b * fm1 * 0.5f
+                     - xk[2] * b * f   * 0.5f
+                     + xk[3] * a * fp1 * (1.0f / 6);
+        }
+    }
+}
+
+#endif /* defined(__SIMD__) */
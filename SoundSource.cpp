@@ -26,7 +26,12 @@
 
 #include "SoundSource.h"
 #include "Functions.h"
+#include "HRIRStencils.h"
+#include "HRIRBaker.h"
+#include "HRIRSphericalHarmonics.h"
+#include "HRIRBasisFilters.h"
 #include <string>
+constexpr int PlayableSoundSource::numDopplerBuffers;
 
 // fuckin C++ man
 template <class T_SRC, class T_DEST>
@@ -675,28 +680,30 @@ bool SoundSource::setSelectedPathAutomationPointsSegmentType(const int newSegTyp
 /***** PlayableSoundSource *****/
 PlayableSoundSource::PlayableSoundSource()
 {
-    interpolateHRIR(&posRAE[0], &HRIR[0]);
-    HRIRScaling[0] = HRIRScaling[1] = 0;//= HRIRScaling[2] = HRIRScaling[3] = 0;
-    for (int n = 0; n < numTimeSteps; ++n) {
-        HRIRScaling[0] += std::abs(HRIR[             n]);
-        //HRIRScaling[2] += std::abs(HRIR[             n]);
-        HRIRScaling[1] += std::abs(HRIR[numTimeSteps+n]);
-        //HRIRScaling[3] += std::abs(HRIR[numTimeSteps+n]);
-    }
-    HRIRScaling[0] = 1.0/HRIRScaling[0];
-    HRIRScaling[1] = 1.0/HRIRScaling[1];
+    // hrirs get initialized once the hrir data is loaded, see setHRIRData()
+    HRIRSpectra.resize(2 * 2 * fftConvolver.getSpectrumSize());
+    // build the interpolation stencils now rather than on the first interpolation on the audio thread
+    HRIRStencils::get();
+}
+
+void PlayableSoundSource::setHRIRData(const HRIRData* newHRIRData) noexcept
+{
+    hrirData = newHRIRData;
+    hrirLength = hrirData->getLength();
+    interpolateHRIR(&posRAE[0], &HRIR[0], HRIRDelay, HRIRScaling);
+    HRIRDelays[2] = HRIRDelays[0] = HRIRDelay[0];
+    HRIRDelays[3] = HRIRDelays[1] = HRIRDelay[1];
+    hrirDelay[0].reset();
+    hrirDelay[1].reset();
+    HRIRSpectraValid = false;
     // hoping this (init of HRIRs at construction) might fix the random fuzz issue with moving sources, it did seem to work...
-    for (int n = 0; n < numTimeSteps; ++n)
+    for (int n = 0; n < hrirLength; ++n)
     {
-        HRIR[             n] *= HRIRScaling[0];
-        HRIR[numTimeSteps+n] *= HRIRScaling[1];
-        HRIRs[2*numTimeSteps+n] = HRIRs[             n] = HRIR[             n];// * HRIRScaling[0];
-        //HRIRs[2*numTimeSteps+n] = HRIR[             n];// * HRIRScaling[0];
-        HRIRs[3*numTimeSteps+n] = HRIRs[numTimeSteps+n] = HRIR[numTimeSteps+n];// * HRIRScaling[1];
-        //HRIRs[3*numTimeSteps+n] = HRIR[numTimeSteps+n];// * HRIRScaling[1];
+        HRIRs[2*maxNumTimeSteps+n] = HRIRs[                n] = HRIR[                n];
+        HRIRs[3*maxNumTimeSteps+n] = HRIRs[maxNumTimeSteps+n] = HRIR[maxNumTimeSteps+n];
     }
-    HRIRScaling[2] = HRIRScaling[0] = 1.0/HRIRScaling[0];
-    HRIRScaling[3] = HRIRScaling[1] = 1.0/HRIRScaling[1];
+    HRIRScaling[2] = HRIRScaling[0];
+    HRIRScaling[3] = HRIRScaling[1];
 }
 
 PlayableSoundSource::~PlayableSoundSource()
@@ -751,25 +758,44 @@ std::array<float,3> PlayableSoundSource::getPosRAE() const noexcept
     return posRAE;
 }
 
-void PlayableSoundSource::allocateForMaxBufferSize(const int N_max)
+void PlayableSoundSource::allocateForMaxBufferSize(const int N_max, const int newMaxHRIRLength)
 {
     Nmax = N_max;
-	inputBuffer.resize(Nmax * (std::ceil(float(numTimeSteps - 1) / float(Nmax)) + 1), 0.0f);
+    if (std::min(newMaxHRIRLength, maxNumTimeSteps) != maxHRIRLength) {
+        maxHRIRLength = std::min(newMaxHRIRLength, maxNumTimeSteps);
+        fftConvolver = FFTConvolver(maxHRIRLength);
+        HRIRSpectra.assign(2 * 2 * fftConvolver.getSpectrumSize(), 0.0f);
+        HRIRSpectraValid = false;
+    }
+	inputBufferSize = Nmax * (std::ceil(float(maxHRIRLength - 1) / float(Nmax)) + 1);
+	inputBuffer.assign(2 * inputBufferSize, 0.0f); // mirrored, see processAudio()
 	inputBufferInPos = 0;
 	inputBufferOutPos = 0;
 	const int maxNumHRIRs = (Nmax >> 1) + 1; // new hrir position for each 2 samples seems more than sufficient...
-	hqHRIRs.resize(maxNumHRIRs * 2 * numTimeSteps, 0);
+	hqHRIRs.resize(maxNumHRIRs * 2 * maxNumTimeSteps, 0);
 	hqHRIRScaling.resize(maxNumHRIRs * 2, 0);
+	hqHRIRDelays.resize(maxNumHRIRs * 2, 0);
     //inputs.resize(std::ceil((float)(numTimeSteps-1)/((float)Nmax)) + 1);
     //for (auto& input : inputs)
     //    input.setSize(Nmax);
     //newInputIndex = 0;
-    if (dopplerOn)
-    {
-        //doppler[0].free();
-        //doppler[1].free();
-        doppler[0].allocate(dopplerMaxDistance, Nmax, 0.1f/*dopplerSpeedOfSound*/);
-        doppler[1].allocate(dopplerMaxDistance, Nmax, 0.1f/*dopplerSpeedOfSound*/);
+    allocateDoppler();
+}
+
+void PlayableSoundSource::allocateDoppler()
+{
+    // even with the doppler effect off so turning it on doesn't allocate, it's small at the speed of sound. sources that go farther or slower speeds of
+    // sound get longer delay lines from the processor's dopplerResizer
+    if (dopplerMode == DopplerMode::DELAY_LINE) {
+        dopplerInputBuffer.assign(2 * 2 * inputBufferSize, 0.0f);
+        doppler.allocate(dopplerMaxDistance, Nmax);
+        for (auto& d : earDopplers)
+            d.free();
+    } else {
+        std::vector<float>().swap(dopplerInputBuffer);
+        doppler.free();
+        for (auto& d : earDopplers)
+            d.allocate(dopplerMaxDistance, Nmax);
     }
 }
 
@@ -786,16 +812,10 @@ void PlayableSoundSource::allocateForMaxBufferSize(const int N_max)
 void PlayableSoundSource::setDopplerOn(const bool newDopplerOn, const float newSpeedOfSound)
 {
     dopplerSpeedOfSound = newSpeedOfSound;
-	doppler[0].setSpeedOfSound(dopplerSpeedOfSound);
-	doppler[1].setSpeedOfSound(dopplerSpeedOfSound);
+	doppler.setSpeedOfSound(dopplerSpeedOfSound);
+	for (auto& d : earDopplers)
+		d.setSpeedOfSound(dopplerSpeedOfSound);
 	if (newDopplerOn != dopplerOn) {
-		if (newDopplerOn) {
-			doppler[0].allocate(dopplerMaxDistance, Nmax, 0.1f);
-			doppler[1].allocate(dopplerMaxDistance, Nmax, 0.1f);
-		} else {
-            doppler[0].free();
-            doppler[1].free();
-		}
 		// reset processing state of sound source
 //        for (auto& i : inputs)
 //            i.clear();
@@ -828,10 +848,33 @@ void PlayableSoundSource::setDopplerOn(const bool newDopplerOn, const float newS
     dopplerOn = newDopplerOn;
 }
 
+void PlayableSoundSource::setDopplerMode(const DopplerMode newMode)
+{
+    if (newMode == dopplerMode)
+        return;
+    dopplerMode = newMode;
+    if (Nmax > 0)
+        allocateDoppler();
+    resetProcessingState();
+}
+
+DopplerBuffer& PlayableSoundSource::getDopplerBuffer(const int i) noexcept
+{
+    if (i == 0)
+        return doppler;
+    return earDopplers[i - 1];
+}
+
+std::size_t PlayableSoundSource::getDopplerMemorySize() const noexcept
+{
+    return doppler.getMemorySize() + earDopplers[0].getMemorySize() + earDopplers[1].getMemorySize();
+}
+
 void PlayableSoundSource::setDopplerSampleRate(const float sampleRate) noexcept
 {
-    doppler[0].setSampleRate(sampleRate);
-    doppler[1].setSampleRate(sampleRate);
+    doppler.setSampleRate(sampleRate);
+    for (auto& d : earDopplers)
+        d.setSampleRate(sampleRate);
 }
 
 void PlayableSoundSource::setSourceMuted(const bool newMutedState) noexcept
@@ -848,24 +891,46 @@ void PlayableSoundSource::resetProcessingState() noexcept
 {
     if (dopplerOn)
     {
-        doppler[0].reset();
-        doppler[1].reset();
+        if (dopplerMode == DopplerMode::DELAY_LINE)
+            doppler.reset();
+        else
+            for (auto& d : earDopplers)
+                d.reset();
     }
 //    for (auto& i : inputs)
 //        i.clear();
 //    newInputIndex = 0;
     for (auto& x : inputBuffer)
         x = 0;
+    std::fill(dopplerInputBuffer.begin(), dopplerInputBuffer.end(), 0.0f);
     inputBufferInPos = 0;
     inputBufferOutPos = 0;
+    hrirDelay[0].reset();
+    hrirDelay[1].reset();
     HRIRChange = false;
     prevRAE = posRAE;
+    busGainsValid = false;
 }
 
 void PlayableSoundSource::processAudio(const float* in, const int N, float* out, const bool realTime)
 {
+    if (realTime && ((virtualSpeakers && virtualSpeakers->getHRIRData() == hrirData) || (ambisonicBus && ambisonicBus->getDecoder()))) {
+        panOntoBus(in, N);
+        return;
+    }
+    busGainsValid = false;
+    // not allocated for hrirs this long (yet), stay silent rather than convolve past the ends of the buffers, see allocateForMaxBufferSize()
+    if (hrirLength > maxHRIRLength)
+        return;
+    // the hrirs weren't kept up while panning onto the virtual speakers or ambisonic bus, so start over from the current position
+    if (HRIRStale) {
+        setHRIRData(hrirData);
+        HRIRStale = false;
+        HRIRChange = false;
+    }
     float* whichHRIRs = nullptr;
     float* whichHRIRScaling = nullptr;
+    float* whichHRIRDelays = nullptr;
     // if we had an HRIRChange update we gotta interpolate that hrir data for the blended output
     if (HRIRChange) {
         if (realTime) {
@@ -873,22 +938,13 @@ void PlayableSoundSource::processAudio(const float* in, const int N, float* out,
             numHRIRs = 2; // must be 2 in order to get away with only making one new interpolateHRIR() call
             whichHRIRs = &HRIRs[0];
             whichHRIRScaling = &HRIRScaling[0];
+            whichHRIRDelays = &HRIRDelays[0];
             // end of the positional interps (only one that needs computation for realtime)
-            interpolateHRIR(&posRAE[0], &HRIRs[2*numTimeSteps]);
-            // this pre-convolution normalization is required to get rid of the crackling in the quiet ear for close sources due to floating point addition inaccuracy
-            HRIRScaling[2] = HRIRScaling[3] = 0;
-            for (int n = 0; n < numTimeSteps; ++n) {
-                HRIRScaling[2] += std::abs(HRIRs[2*numTimeSteps+n]);
-                HRIRScaling[3] += std::abs(HRIRs[3*numTimeSteps+n]);
-            }
-            HRIRScaling[2] = 1.0/HRIRScaling[2];
-            HRIRScaling[3] = 1.0/HRIRScaling[3];
-            for (int n = 0; n < numTimeSteps; ++n) {
-                HRIRs[2*numTimeSteps+n] *= HRIRScaling[2];
-                HRIRs[3*numTimeSteps+n] *= HRIRScaling[3];
-            }
-            HRIRScaling[2] = 1.0/HRIRScaling[2];
-            HRIRScaling[3] = 1.0/HRIRScaling[3];
+            // with the pre-convolution normalization, it is required to get rid of the crackling in the quiet ear for close sources due to floating point addition inaccuracy
+            // unless the hrirs for this spot along a looped path are already baked
+            if (!hrirBaker || !hrirBaker->getHRIR(hrirBakerSourceIndex, hrirBakerPosSec, &posRAE[0], hrirData, interpolationQuality,
+                                                  &HRIRs[2*maxNumTimeSteps], &HRIRDelays[2], &HRIRScaling[2]))
+                interpolateHRIR(&posRAE[0], &HRIRs[2*maxNumTimeSteps], &HRIRDelays[2], &HRIRScaling[2]);
 		}
 		else {
 			// for non-realtime processing, we can go crazy and have each output sample be processed with a different blending position for nice smooth audio despite potentially fast moving source
@@ -904,30 +960,13 @@ void PlayableSoundSource::processAudio(const float* in, const int N, float* out,
 			//}
 			whichHRIRs = &hqHRIRs[0];
             whichHRIRScaling = &hqHRIRScaling[0];
-            const int lastHRIR = numHRIRs-1;
-            // end of the positional interps (only one that needs computation for realtime)
-            interpolateHRIR(&posRAE[0], &hqHRIRs[lastHRIR*2*numTimeSteps]);
-            // pre-convolution normalization
-            hqHRIRScaling[lastHRIR*2] = hqHRIRScaling[lastHRIR*2+1] = 0;
-            for (int n = 0; n < numTimeSteps; ++n) {
-                hqHRIRScaling[lastHRIR*2  ] += std::abs(hqHRIRs[ lastHRIR*2   *numTimeSteps+n]);
-                hqHRIRScaling[lastHRIR*2+1] += std::abs(hqHRIRs[(lastHRIR*2+1)*numTimeSteps+n]);
-            }
-            hqHRIRScaling[lastHRIR*2  ] = 1.0/hqHRIRScaling[lastHRIR*2  ];
-            hqHRIRScaling[lastHRIR*2+1] = 1.0/hqHRIRScaling[lastHRIR*2+1];
-            for (int n = 0; n < numTimeSteps; ++n) {
-                hqHRIRs[ lastHRIR*2   *numTimeSteps+n] *= hqHRIRScaling[lastHRIR*2  ];
-                hqHRIRs[(lastHRIR*2+1)*numTimeSteps+n] *= hqHRIRScaling[lastHRIR*2+1];
-            }
-            hqHRIRScaling[lastHRIR*2  ] = 1.0/hqHRIRScaling[lastHRIR*2  ];
-            hqHRIRScaling[lastHRIR*2+1] = 1.0/hqHRIRScaling[lastHRIR*2+1];
+            whichHRIRDelays = &hqHRIRDelays[0];
             hqHRIRScaling[0] = HRIRScaling[0]; // load the first hrir pos scaling factors
             hqHRIRScaling[1] = HRIRScaling[1];
-            // number of interps minus the endpoints which have already been interped!
+            // number of interps minus the endpoints, the first one is the current hrir
             const int numInterps = numHRIRs-2;
             // positional data for blending
             float posXYZ[3];
-            float pos_RAE[3];
             float xyzCurrent[3];
             RAEtoXYZ(&prevRAE[0], &xyzCurrent[0]);
             float xyzNext[3];
@@ -936,30 +975,19 @@ void PlayableSoundSource::processAudio(const float* in, const int N, float* out,
             const float factorX = oneOverNumInterpsP1 * (xyzNext[0]-xyzCurrent[0]);
             const float factorY = oneOverNumInterpsP1 * (xyzNext[1]-xyzCurrent[1]);
             const float factorZ = oneOverNumInterpsP1 * (xyzNext[2]-xyzCurrent[2]);
-            // interpolate positions and hrirs for those positions
+            // interpolate the positions for all the hrirs after the first, ending at the current position
+            STACK_ARRAY(float, pos_RAEs, 3*(numInterps+1))
             for (int i = 1; i <= numInterps; ++i) {
                 // interpolate intermediate positions in xyz land
                 posXYZ[0] = i * factorX + xyzCurrent[0];
                 posXYZ[1] = i * factorY + xyzCurrent[1];
                 posXYZ[2] = i * factorZ + xyzCurrent[2];
                 // convert back to spherical
-                XYZtoRAE(&posXYZ[0], &pos_RAE[0]);
-                interpolateHRIR(pos_RAE, &hqHRIRs[i*2*numTimeSteps]);
-                // pre-convolution normalization
-                hqHRIRScaling[i*2] = hqHRIRScaling[i*2+1] = 0;
-                for (int n = 0; n < numTimeSteps; ++n) {
-                    hqHRIRScaling[i*2  ] += std::abs(hqHRIRs[ i*2   *numTimeSteps+n]);
-                    hqHRIRScaling[i*2+1] += std::abs(hqHRIRs[(i*2+1)*numTimeSteps+n]);
-                }
-                hqHRIRScaling[i*2  ] = 1.0/hqHRIRScaling[i*2  ];
-                hqHRIRScaling[i*2+1] = 1.0/hqHRIRScaling[i*2+1];
-                for (int n = 0; n < numTimeSteps; ++n) {
-                    hqHRIRs[ i*2   *numTimeSteps+n] *= hqHRIRScaling[i*2  ];
-                    hqHRIRs[(i*2+1)*numTimeSteps+n] *= hqHRIRScaling[i*2+1];
-                }
-                hqHRIRScaling[i*2  ] = 1.0/hqHRIRScaling[i*2  ];
-                hqHRIRScaling[i*2+1] = 1.0/hqHRIRScaling[i*2+1];
+                XYZtoRAE(&posXYZ[0], &pos_RAEs[3*(i-1)]);
             }
+            std::copy(posRAE.begin(), posRAE.end(), &pos_RAEs[3*numInterps]);
+            // and then the hrirs for those positions in one go (with pre-convolution normalization), consecutive positions mostly share their neighboring hrirs
+            interpolateHRIRs(&pos_RAEs[0], numInterps+1, &hqHRIRs[2*maxNumTimeSteps], &hqHRIRDelays[2], &hqHRIRScaling[2]);
         }
         // load the "current" hrir into the blended HRIRs and make "current" hrir the one for the next position, think that screwy stuff with the HRIR data is causing those rare fuzzes when the sources moves, still not sure what to do to fix it...
 //        for (int ch = 0; ch < 2; ++ch) {
@@ -968,23 +996,42 @@ void PlayableSoundSource::processAudio(const float* in, const int N, float* out,
 //                HRIR[ch*numTimeSteps+n] = whichHRIRs[((numHRIRs-1)*2+ch)*numTimeSteps+n];
 //            }
 //        }
-        for (int n = 0; n < numTimeSteps; ++n) {
+        for (int n = 0; n < hrirLength; ++n) {
             // ch 0
-            whichHRIRs[             n] = HRIR      [             n];
-            HRIR      [             n] = whichHRIRs[((numHRIRs-1)*2)  *numTimeSteps+n];
+            whichHRIRs[                n] = HRIR      [                n];
+            HRIR      [                n] = whichHRIRs[((numHRIRs-1)*2)  *maxNumTimeSteps+n];
             // ch 1
-            whichHRIRs[numTimeSteps+n] = HRIR      [numTimeSteps+n];
-            HRIR      [numTimeSteps+n] = whichHRIRs[((numHRIRs-1)*2+1)*numTimeSteps+n];
+            whichHRIRs[maxNumTimeSteps+n] = HRIR      [maxNumTimeSteps+n];
+            HRIR      [maxNumTimeSteps+n] = whichHRIRs[((numHRIRs-1)*2+1)*maxNumTimeSteps+n];
+        }
+        for (int ch = 0; ch < 2; ++ch) {
+            whichHRIRDelays[ch] = HRIRDelay[ch];
+            HRIRDelay[ch] = whichHRIRDelays[(numHRIRs-1)*2+ch];
         }
         // advance positional state
         pprevRAE = prevRAE;
         prevRAE = posRAE;
     } // end if HRIRChange
     // load the current input
+    const int inPos = inputBufferInPos;
 	for (int n = 0; n < N; ++n) {
-		inputBuffer[inputBufferInPos] = in[n];
-		inputBufferInPos = (inputBufferInPos + 1) % inputBuffer.size();
+		// each input also goes in the mirrored copy so the inputs for any output are contiguous
+		inputBuffer[inputBufferInPos] = inputBuffer[inputBufferInPos + inputBufferSize] = in[n];
+		if (++inputBufferInPos == inputBufferSize)
+			inputBufferInPos = 0;
 	}
+    // with the doppler effect's delay line each ear convolves the input delayed for its own distance to the source instead
+    const bool dopplerTaps = dopplerOn && dopplerMode == DopplerMode::DELAY_LINE;
+    const float* convolutionInputs[2] {&inputBuffer[0], &inputBuffer[0]};
+    if (dopplerTaps) {
+        const float distances[2] {getEarToSourceDistance(0), getEarToSourceDistance(1)};
+        STACK_ARRAY(float, yDoppler, 2*N)
+        float* dopplerOutputs[2] {&yDoppler[0], &yDoppler[N]};
+        doppler.process(in, N, distances, 2, dopplerOutputs);
+        loadDopplerInputs(dopplerOutputs, inPos, N);
+        convolutionInputs[0] = &dopplerInputBuffer[0];
+        convolutionInputs[1] = &dopplerInputBuffer[2*inputBufferSize];
+    }
 
 //	// old input inserting
 //    inputs[newInputIndex].load(in, N);
@@ -1016,13 +1063,46 @@ void PlayableSoundSource::processAudio(const float* in, const int N, float* out,
 ////        }
 ////    }
 	
-    // allocate final output array
-    STACK_ARRAY(float, yfinal, N);
+    // convolve both ears at once, in the frequency domain if the block is big enough for it to pay off and there is at most one hrir change to crossfade,
+    // otherwise with the direct stereo kernels that walk the input history once for both ears (and both blended hrirs of each ear)
+    // or just mix the input already convolved with the basis filters for all the sources. not offline though, where the new hrir every few samples costs more
+    // to project onto the filters than convolving with it does, or with the doppler effect's delay line that delays this source's input before its convolution
+    const bool fftConvolution = N >= fftConvolutionMinBlockSize && (!HRIRChange || numHRIRs == 2);
+    const bool basisFilterRendering = realTime && !dopplerTaps && basisConvolvedInput && hrirBasisFilters && hrirBasisFilters->getHRIRData() == hrirData;
+    STACK_ARRAY(float, yConvolved, 2*N)
+    if (basisFilterRendering) {
+        mixBasisFilterOutputs(HRIRChange ? whichHRIRs : &HRIR[0], HRIRChange ? whichHRIRScaling : &HRIRScaling[0], HRIRChange ? numHRIRs : 1, yConvolved, N);
+        if (HRIRChange)
+            HRIRSpectraValid = false;
+    } else if (fftConvolution) {
+        fftConvolve(convolutionInputs, HRIRChange ? whichHRIRs : &HRIR[0], HRIRChange ? whichHRIRScaling : &HRIRScaling[0], yConvolved, N);
+    } else if (HRIRChange) {
+        if (dopplerTaps) {
+            for (int ch = 0; ch < 2; ++ch)
+                convolve(convolutionInputs[ch], inputBufferOutPos, inputBufferSize,
+                         &whichHRIRs[0], hrirLength, maxNumTimeSteps, numHRIRs, &whichHRIRScaling[0], ch,
+                         &yConvolved[ch*N], N);
+        } else {
+            convolveStereo(&inputBuffer[0], inputBufferOutPos, inputBufferSize,
+                           &whichHRIRs[0], hrirLength, maxNumTimeSteps, numHRIRs, &whichHRIRScaling[0],
+                           &yConvolved[0], &yConvolved[N], N);
+        }
+        // the current hrir's spectra are stale now
+        HRIRSpectraValid = false;
+    } else if (dopplerTaps) {
+        for (int ch = 0; ch < 2; ++ch)
+            convolve(convolutionInputs[ch], inputBufferOutPos, inputBufferSize,
+                     &HRIR[ch*maxNumTimeSteps], hrirLength, HRIRScaling[ch],
+                     &yConvolved[ch*N], N);
+    } else {
+        convolveStereo(&inputBuffer[0], inputBufferOutPos, inputBufferSize,
+                       &HRIR[0], &HRIR[maxNumTimeSteps], hrirLength, HRIRScaling[0], HRIRScaling[1],
+                       &yConvolved[0], &yConvolved[N], N);
+    }
     // process for each ear
     for (int ch = 0; ch < 2; ++ch) {
-        // zero fill output array
-        for (int n = 0; n < N; ++n)
-            yfinal[n] = 0;
+        // this ear's convolved output
+        float* const yfinal = &yConvolved[ch*N];
             
         // blending hrirs in this buffer
         if (HRIRChange) {
@@ -1092,18 +1172,11 @@ void PlayableSoundSource::processAudio(const float* in, const int N, float* out,
             //        }
             //    }
             //}
-			convolve(&inputBuffer[0], inputBufferOutPos, inputBuffer.size(),
-					 &whichHRIRs[0], numTimeSteps, numHRIRs, &whichHRIRScaling[0], ch,
-				     &yfinal[0], N);
             // advance the HRIR scaling stuff
             HRIRScaling[0] = whichHRIRScaling[(numHRIRs-1)*2];
             HRIRScaling[1] = whichHRIRScaling[(numHRIRs-1)*2+1];
         } else { // no blending to do in this buffer as we are stationary
 
-			convolve(&inputBuffer[0], inputBufferOutPos, inputBuffer.size(), 
-				     &HRIR[ch*numTimeSteps], numTimeSteps, HRIRScaling[ch],
-				     &yfinal[0], N);
-
 //            // do convolutions for all the inputs that are needed to render this buffers output
 //            // note that begin and end indecies are refering to the previous buffer's indexing context, not the current buffer's
 //            int beginIndex = 0, endIndex, thing;
@@ -1132,617 +1205,433 @@ void PlayableSoundSource::processAudio(const float* in, const int N, float* out,
 //                    yfinal[n-beginIndex] += y[n] * HRIRScaling[ch];
 //            }
         }
-        // apply doppler effect
-        if (dopplerOn) {
+        // put back the onset delay split off of minimum phase hrirs
+        if (hrirData->hasDelays()) {
+            STACK_ARRAY(float, yDelayed, N)
+            if (HRIRChange)
+                hrirDelay[ch].process(&whichHRIRDelays[ch], 2, numHRIRs, yfinal, yDelayed, N);
+            else
+                hrirDelay[ch].process(&HRIRDelay[ch], 1, 1, yfinal, yDelayed, N);
+            for (int n = 0; n < N; ++n)
+                yfinal[n] = yDelayed[n];
+        }
+        // apply the per ear doppler effect
+        if (dopplerOn && dopplerMode == DopplerMode::PER_EAR) {
             STACK_ARRAY(float, yDoppler, N)
-            float sourceXYZ[3];
-            RAEtoXYZ(&posRAE[0], sourceXYZ);
-            float earXYZ[3];
-			const float earRAE[3] {sphereRad, static_cast<float>(ch == 0 ? earAzimuth : -earAzimuth), earElevation};
-			RAEtoXYZ(earRAE, earXYZ);
-            const float dx = sourceXYZ[0] - earXYZ[0];
-            const float dy = sourceXYZ[1] - earXYZ[1];
-            const float dz = sourceXYZ[2] - earXYZ[2];
-            const float earToSourceDistance = std::sqrt(dx*dx + dy*dy + dz*dz);
-            if (earToSourceDistance > dopplerMaxDistance) {
-                // shouldn't happen that often, so reallocing here when necessary shouldn't cause any big problems
-                dopplerMaxDistance = earToSourceDistance * 2;
-                doppler[0].allocate(dopplerMaxDistance, Nmax, 0.1f/*dopplerSpeedOfSound*/);
-                doppler[1].allocate(dopplerMaxDistance, Nmax, 0.1f/*dopplerSpeedOfSound*/);
-                //dopplerMaxDistanceChanged = true;
-            }
-            doppler[ch].process(earToSourceDistance, N, yfinal, yDoppler);
-            // package each channel's output into one dual-channel array
-			for (int n = 0; n < N; ++n)
-				out[ch*N + n] += yDoppler[n];
-		}
-		else { // no doppler effect
-			// package each channel's output into one dual-channel array
-			for (int n = 0; n < N; ++n)
-				out[ch*N + n] += yfinal[n];
+            earDopplers[ch].process(getEarToSourceDistance(ch), N, yfinal, yDoppler);
+            for (int n = 0; n < N; ++n)
+                yfinal[n] = yDoppler[n];
         }
+        // package each channel's output into one dual-channel array
+        for (int n = 0; n < N; ++n)
+            out[ch*N + n] += yfinal[n];
     } // end for each channel
-	inputBufferOutPos = (inputBufferOutPos + N) % inputBuffer.size();
+	inputBufferOutPos = (inputBufferOutPos + N) % inputBufferSize;
     prevHRIRChange = HRIRChange;
     // set the state of movement so that the next buffer is stationary, which may change if we get an updated position from the gl side
     HRIRChange = false;
 }
 
-// the global hrir data that gets one instance across multiple plugin instances, this just references the one instance defined in PluginProcessor.cpp
-extern float***** HRIRdata;
-extern float**** HRIRdataPoles;
+float PlayableSoundSource::getEarToSourceDistance(const int ch) const noexcept
+{
+    float sourceXYZ[3];
+    RAEtoXYZ(&posRAE[0], sourceXYZ);
+    float earXYZ[3];
+    const float earRAE[3] {sphereRad, static_cast<float>(ch == 0 ? earAzimuth : -earAzimuth), earElevation};
+    RAEtoXYZ(earRAE, earXYZ);
+    const float dx = sourceXYZ[0] - earXYZ[0];
+    const float dy = sourceXYZ[1] - earXYZ[1];
+    const float dz = sourceXYZ[2] - earXYZ[2];
+    return std::sqrt(dx*dx + dy*dy + dz*dz);
+}
 
-// compacted (one azimuth side provided) with pole data version
-void PlayableSoundSource::interpolateHRIR(const float* rae, float* hrir) const noexcept
+void PlayableSoundSource::loadDopplerInputs(const float* const* dopplerOutputs, const int inPos, const int N) noexcept
 {
-    // get the inner + outer rad,azi,ele indicies that define the 3d region bounded by the hrtf/dvf sampling resolution that the source is currently located in
-    const int innerRadiusIndex = std::max(0, std::min((int)((std::log(rae[0])-std::log(distanceBegin))/std::log(distanceEnd/distanceBegin)*(numDistanceSteps-1)), numDistanceSteps-2));//-1);
-    const int outerRadiusIndex = innerRadiusIndex+1;// std::min(innerRadiusIndex+1, numDistanceSteps-1);
-    
-    const int lowerElevationIndex = std::max(0, std::min((int)std::floor(rae[2]/M_PI*numElevationSteps), numElevationSteps-1));
-    const int upperElevationIndex = lowerElevationIndex+1;
-    
-    const float revAzi = std::fmod(4*M_PI-rae[1], 2*M_PI); // fix reversed azimuth indexing with hrir array's, this caused lowerAzimuthIndex = -1 without fmod
-    int lowerAzimuthIndex = std::min((int)std::floor(revAzi/(2*M_PI)*numAzimuthSteps), numAzimuthSteps-1);
-    int upperAzimuthIndex = (lowerAzimuthIndex+1) % numAzimuthSteps;
-    
-    // inner/outer surface radius values
-    const float rIn  = distanceBegin*std::pow(distanceEnd/distanceBegin, ((float)innerRadiusIndex)/(numDistanceSteps-1));
-    const float rOut = distanceBegin*std::pow(distanceEnd/distanceBegin, ((float)outerRadiusIndex)/(numDistanceSteps-1));
-    
-    // upper/lower azimuth values
-    const float aP = ((float)(upperAzimuthIndex))*(2*M_PI)/numAzimuthSteps;
-    const float aM = ((float)(lowerAzimuthIndex))*(2*M_PI)/numAzimuthSteps;
-    
-    // upper/lower elevation values
-    const float eM = ((float)lowerElevationIndex)*M_PI/numElevationSteps;
-    const float eP = ((float)upperElevationIndex)*M_PI/numElevationSteps;
-    
-    // for making close/far more loud/quiet
-    const float intensity_factor = 0.1 / std::pow(rae[0], 0.5);
-    
-    const float mu3 = 0.5*intensity_factor*std::min((rae[0]-rIn)/(rOut-rIn), 1.0f); // scaled by 1/2*intensity_factor here instead of for each sample below
-    
-    // interpolate along azimuth edges
-    const float mu1_01 = (rae[2]-eM)*numElevationSteps/M_PI; // should be btw 0 and 1
-    const float mu1 = mu1_01 + 2;                            // should be btw 2 and 3
-    const float nmu1 = std::abs(2.5-mu1); // should be 0 when source is dead center in interp region, 0.5 when source is on boarder
-    
-    // interpolate along elevation edges
-    const float mu2_01 = (revAzi-aM)*numAzimuthSteps/(2.0*M_PI); // should be btw 0 and 1
-    const float mu2 = mu2_01 + 2;                                // should be btw 2 and 3
-    const float nmu2 = std::abs(2.5-mu2); // should be 0 when source is dead center in interp region, 0.5 when source is on boarder
-    
-    // variables for bounds wrapping surrounding data
-    int uAzip1 = upperAzimuthIndex+1;
-    int lAzim1 = lowerAzimuthIndex-1;
-    int uElep1 = upperElevationIndex+1;
-    int lElem1 = lowerElevationIndex-1;
-    
-    if (uAzip1 > numAzimuthSteps-1)
-        uAzip1 -= numAzimuthSteps;
-    if (lAzim1 < 0)
-        lAzim1 += numAzimuthSteps;
-    
-    bool lElem1Flip = false, uElep1Flip = false; // ele's need bounds wrapping and if they wrap, the corresponding azi it is used with needs flipping
-    if (uElep1 > numElevationSteps) {
-        uElep1 = 2*numElevationSteps - uElep1;
-        uElep1Flip = true;
+    for (int ch = 0; ch < 2; ++ch) {
+        float* const buffer = &dopplerInputBuffer[ch * 2*inputBufferSize];
+        for (int n = 0, i = inPos; n < N; ++n) {
+            buffer[i] = buffer[i + inputBufferSize] = dopplerOutputs[ch][n];
+            if (++i == inputBufferSize)
+                i = 0;
+        }
     }
-    if (lElem1 < 0) {
-        lElem1 = -lElem1;
-        lElem1Flip = true;
+}
+
+void PlayableSoundSource::panOntoBus(const float* in, const int N) noexcept
+{
+    // keep the input history going for switching back to the hrir convolution
+    const int inPos = inputBufferInPos;
+    for (int n = 0; n < N; ++n) {
+        inputBuffer[inputBufferInPos] = inputBuffer[inputBufferInPos + inputBufferSize] = in[n];
+        if (++inputBufferInPos == inputBufferSize)
+            inputBufferInPos = 0;
     }
-    
-    int nAzi2, nEle2;  // neighboring azi/ele indices
-    bool nAziUp, nEleUp;
-    if ((aP > aM ? aP-revAzi : 2.0*M_PI-revAzi) > revAzi-aM) {
-        nAzi2 = lowerAzimuthIndex-2;
-        nAziUp = false;
-    } else {
-        nAzi2 = upperAzimuthIndex+2;
-        nAziUp = true;
+    inputBufferOutPos = (inputBufferOutPos + N) % inputBufferSize;
+    // the doppler effect for the distance from the center of the head, the ears' own arrival times come from the speakers' hrirs or the decoder.
+    // with the delay line it stands in for both ears' doppler inputs too, they're close enough for the hrir convolution to pick up from
+    const float* signal = in;
+    STACK_ARRAY(float, yDoppler, N)
+    if (dopplerOn && dopplerMode == DopplerMode::PER_EAR) {
+        earDopplers[0].process(posRAE[0], N, in, yDoppler);
+        signal = yDoppler;
+    } else if (dopplerOn) {
+        float* dopplerOutput = yDoppler;
+        doppler.process(in, N, &posRAE[0], 1, &dopplerOutput);
+        float* dopplerOutputs[2] {yDoppler, yDoppler};
+        loadDopplerInputs(dopplerOutputs, inPos, N);
+        signal = yDoppler;
     }
-    if (eP-rae[2] > rae[2]-eM) {
-        nEle2 = lowerElevationIndex-2;
-        nEleUp = false;
+    // the gains move from where the source was at the end of the last block to where it is now
+    if (virtualSpeakers) {
+        const VirtualSpeakers::Pan pan = virtualSpeakers->pan(&posRAE[0]);
+        if (!busGainsValid)
+            virtualSpeakerPan = pan;
+        virtualSpeakers->add(signal, virtualSpeakerPan, pan, N);
+        virtualSpeakerPan = pan;
     } else {
-        nEle2 = upperElevationIndex+2;
-        nEleUp = true;
-    }
-    
-    if (nAzi2 > numAzimuthSteps-1)
-        nAzi2 -= numAzimuthSteps;
-    if (nAzi2 < 0)
-        nAzi2 += numAzimuthSteps;
-    
-    bool nEleFlip = false; // ele's need bounds wrapping and if they wrap, the corresponding azi needs flipping
-    if (nEle2 > numElevationSteps) {
-        nEle2 = 2*numElevationSteps - nEle2;
-        nEleFlip = true;
-    }
-    if (nEle2 < 0) {
-        nEle2 = -nEle2;
-        nEleFlip = true;
-    }
-    
-    // for the compacted data with only one azimuth side provided, we gotta do some channel flipping
-    int lAziBaseCh = 0, uAziBaseCh = 0;
-    if (lowerAzimuthIndex > numAzimuthSteps/2) {
-        lowerAzimuthIndex = numAzimuthSteps - lowerAzimuthIndex;// numAzimuthSteps/2 - (lowerAzimuthIndex - numAzimuthSteps/2);
-        lAziBaseCh = 1;
-    }
-    if (upperAzimuthIndex > numAzimuthSteps/2) {
-        upperAzimuthIndex = numAzimuthSteps - upperAzimuthIndex;
-        uAziBaseCh = 1;
-    }
-    int lAzim1BaseCh = 0, uAzip1BaseCh = 0;
-    if (lAzim1 > numAzimuthSteps/2) {
-        lAzim1 = numAzimuthSteps - lAzim1;
-        lAzim1BaseCh = 1;
+        float gains[AmbisonicBus::maxNumChannels];
+        ambisonicBus->encode(&posRAE[0], gains);
+        if (!busGainsValid)
+            std::copy_n(gains, ambisonicBus->getNumChannels(), ambisonicGains);
+        ambisonicBus->add(signal, ambisonicGains, gains, N);
+        // the channels past the bus's order stay silent so they fade in from nothing if the order goes up
+        std::copy_n(gains, ambisonicBus->getNumChannels(), ambisonicGains);
+        std::fill(ambisonicGains + ambisonicBus->getNumChannels(), ambisonicGains + AmbisonicBus::maxNumChannels, 0.0f);
     }
-    if (uAzip1 > numAzimuthSteps/2) {
-        uAzip1 = numAzimuthSteps - uAzip1;
-        uAzip1BaseCh = 1;
-    }
-    int nAziBaseCh = 0;
-    if (nAzi2 > numAzimuthSteps/2) {
-        nAzi2 = numAzimuthSteps - nAzi2;
-        nAziBaseCh = 1;
+    busGainsValid = true;
+    if (HRIRChange) {
+        pprevRAE = prevRAE;
+        prevRAE = posRAE;
     }
-    
-    // i like things that are difficult to understand (see below, they follow the same pattern as the original interpolateHRIR())
-    float **niRuAE1, **niRuAE2, **niRuAE3, **niRuAE4,
-           **iRuAE1,  **iRuAE2,  **iRuAE3,  **iRuAE4,
-          **niRlAE1, **niRlAE2, **niRlAE3, **niRlAE4,
-           **iRlAE1,  **iRlAE2,  **iRlAE3,  **iRlAE4,
-          **noRuAE1, **noRuAE2, **noRuAE3, **noRuAE4,
-           **oRuAE1,  **oRuAE2,  **oRuAE3,  **oRuAE4,
-          **noRlAE1, **noRlAE2, **noRlAE3, **noRlAE4,
-           **oRlAE1,  **oRlAE2,  **oRlAE3,  **oRlAE4,
-          **niRA1uE, **niRA2uE, **niRA3uE, **niRA4uE,
-           **iRA1uE,  **iRA2uE,  **iRA3uE,  **iRA4uE,
-          **niRA1lE, **niRA2lE, **niRA3lE, **niRA4lE,
-           **iRA1lE,  **iRA2lE,  **iRA3lE,  **iRA4lE,
-          **noRA1uE, **noRA2uE, **noRA3uE, **noRA4uE,
-           **oRA1uE,  **oRA2uE,  **oRA3uE,  **oRA4uE,
-          **noRA1lE, **noRA2lE, **noRA3lE, **noRA4lE,
-           **oRA1lE,  **oRA2lE,  **oRA3lE,  **oRA4lE;
-    
-    // need these cuz bounds wrapped ele indecies can flip their channels or at least the order of the 1234 matters depending on n(Ele/Azi)Up
-    int nuAE1BaseCh, nuAE2BaseCh, nuAE3BaseCh, nuAE4BaseCh,
-        nlAE1BaseCh, nlAE2BaseCh, nlAE3BaseCh, nlAE4BaseCh,
-         uAE1BaseCh,           /*uAE3BaseCh,*/  uAE4BaseCh,
-         lAE1BaseCh,           /*lAE3BaseCh,*/  lAE4BaseCh,
-        nA1uEBaseCh, nA2uEBaseCh, nA3uEBaseCh, nA4uEBaseCh,
-        nA1lEBaseCh, nA2lEBaseCh, nA3lEBaseCh, nA4lEBaseCh;
-//         A1uEBaseCh,  A2uEBaseCh,  A3uEBaseCh,  A4uEBaseCh;
-    
-    //const int uAzip1EleFlipped        = numAzimuthSteps-(uAzip1           +numAzimuthSteps/2);
-    const int upperAziIndexEleFlipped = numAzimuthSteps-(upperAzimuthIndex+numAzimuthSteps/2);
-    const int lowerAziIndexEleFlipped = numAzimuthSteps-(lowerAzimuthIndex+numAzimuthSteps/2);
-    //const int lAzim1EleFlipped        = numAzimuthSteps-(lAzim1           +numAzimuthSteps/2);
-    //const int nAzi2EleFlipped         = numAzimuthSteps-(nAzi2            +numAzimuthSteps/2);
-    
-    float mu1n;
-    if (nEleUp) {
-        mu1n = mu1 - 1;
-        if (lowerElevationIndex == 0) {
-            niRuAE1 = niRlAE1 = HRIRdataPoles[innerRadiusIndex][0];
-            noRuAE1 = noRlAE1 = HRIRdataPoles[outerRadiusIndex][0];
-            nuAE1BaseCh = nlAE1BaseCh = 0;
-        } else {
-            niRuAE1 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-            noRuAE1 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-            niRlAE1 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-            noRlAE1 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-            nuAE1BaseCh = uAziBaseCh;
-            nlAE1BaseCh = lAziBaseCh;
-        }
-        if (upperElevationIndex == numElevationSteps) {
-            niRuAE2 = niRlAE2 = HRIRdataPoles[innerRadiusIndex][1];
-            noRuAE2 = noRlAE2 = HRIRdataPoles[outerRadiusIndex][1];
-            nuAE2BaseCh = nlAE2BaseCh = 0;
-        } else {
-            niRuAE2 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-            noRuAE2 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-            niRlAE2 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-            noRlAE2 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-            nuAE2BaseCh = uAziBaseCh;
-            nlAE2BaseCh = lAziBaseCh;
-        }
-        if (uElep1Flip) {
-            niRuAE3 = HRIRdata[innerRadiusIndex][upperAziIndexEleFlipped][uElep1-1];
-            noRuAE3 = HRIRdata[outerRadiusIndex][upperAziIndexEleFlipped][uElep1-1];
-            niRlAE3 = HRIRdata[innerRadiusIndex][lowerAziIndexEleFlipped][uElep1-1];
-            noRlAE3 = HRIRdata[outerRadiusIndex][lowerAziIndexEleFlipped][uElep1-1];
-            nuAE3BaseCh = (uAziBaseCh + 1) % 2;
-            nlAE3BaseCh = (lAziBaseCh + 1) % 2;
-        } else if (uElep1 == numElevationSteps) {
-            niRuAE3 = niRlAE3 = HRIRdataPoles[innerRadiusIndex][1];
-            noRuAE3 = noRlAE3 = HRIRdataPoles[outerRadiusIndex][1];
-            nuAE3BaseCh = nlAE3BaseCh = 0;
-        } else {
-            niRuAE3 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][uElep1-1];
-            noRuAE3 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][uElep1-1];
-            niRlAE3 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][uElep1-1];
-            noRlAE3 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][uElep1-1];
-            nuAE3BaseCh = uAziBaseCh;
-            nlAE3BaseCh = lAziBaseCh;
-        }
-        if (nEleFlip) {
-            niRuAE4 = HRIRdata[innerRadiusIndex][upperAziIndexEleFlipped][nEle2-1];
-            noRuAE4 = HRIRdata[outerRadiusIndex][upperAziIndexEleFlipped][nEle2-1];
-            niRlAE4 = HRIRdata[innerRadiusIndex][lowerAziIndexEleFlipped][nEle2-1];
-            noRlAE4 = HRIRdata[outerRadiusIndex][lowerAziIndexEleFlipped][nEle2-1];
-            nuAE4BaseCh = (uAziBaseCh + 1) % 2;
-            nlAE4BaseCh = (lAziBaseCh + 1) % 2;
-        } else if (nEle2 == numElevationSteps) {
-            niRuAE4 = niRlAE4 = HRIRdataPoles[innerRadiusIndex][1];
-            noRuAE4 = noRlAE4 = HRIRdataPoles[outerRadiusIndex][1];
-            nuAE4BaseCh = nlAE4BaseCh = 0;
-        } else {
-            niRuAE4 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][nEle2-1];
-            noRuAE4 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][nEle2-1];
-            niRlAE4 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][nEle2-1];
-            noRlAE4 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][nEle2-1];
-            nuAE4BaseCh = uAziBaseCh;
-            nlAE4BaseCh = lAziBaseCh;
-        }
-    } else {
-        mu1n = mu1 + 1;
-        if (nEleFlip) {
-            niRuAE1 = HRIRdata[innerRadiusIndex][upperAziIndexEleFlipped][nEle2-1];
-            noRuAE1 = HRIRdata[outerRadiusIndex][upperAziIndexEleFlipped][nEle2-1];
-            niRlAE1 = HRIRdata[innerRadiusIndex][lowerAziIndexEleFlipped][nEle2-1];
-            noRlAE1 = HRIRdata[outerRadiusIndex][lowerAziIndexEleFlipped][nEle2-1];
-            nuAE1BaseCh = (uAziBaseCh + 1) % 2;
-            nlAE1BaseCh = (lAziBaseCh + 1) % 2;
-        } else if (nEle2 == 0) {
-            niRuAE1 = niRlAE1 = HRIRdataPoles[innerRadiusIndex][0];
-            noRuAE1 = noRlAE1 = HRIRdataPoles[outerRadiusIndex][0];
-            nuAE1BaseCh = nlAE1BaseCh = 0;
-        } else {
-            niRuAE1 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][nEle2-1];
-            noRuAE1 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][nEle2-1];
-            niRlAE1 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][nEle2-1];
-            noRlAE1 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][nEle2-1];
-            nuAE1BaseCh = uAziBaseCh;
-            nlAE1BaseCh = lAziBaseCh;
-        }
-        if (lElem1Flip) {
-            niRuAE2 = HRIRdata[innerRadiusIndex][upperAziIndexEleFlipped][lElem1-1];
-            noRuAE2 = HRIRdata[outerRadiusIndex][upperAziIndexEleFlipped][lElem1-1];
-            niRlAE2 = HRIRdata[innerRadiusIndex][lowerAziIndexEleFlipped][lElem1-1];
-            noRlAE2 = HRIRdata[outerRadiusIndex][lowerAziIndexEleFlipped][lElem1-1];
-            nuAE2BaseCh = (uAziBaseCh + 1) % 2;
-            nlAE2BaseCh = (lAziBaseCh + 1) % 2;
-        } else if (lElem1 == 0) {
-            niRuAE2 = niRlAE2 = HRIRdataPoles[innerRadiusIndex][0];
-            noRuAE2 = noRlAE2 = HRIRdataPoles[outerRadiusIndex][0];
-            nuAE2BaseCh = nlAE2BaseCh = 0;
-        } else {
-            niRuAE2 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][lElem1-1];
-            noRuAE2 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][lElem1-1];
-            niRlAE2 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][lElem1-1];
-            noRlAE2 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][lElem1-1];
-            nuAE2BaseCh = uAziBaseCh;
-            nlAE2BaseCh = lAziBaseCh;
-        }
-        if (lowerElevationIndex == 0) {
-            niRuAE3 = niRlAE3 = HRIRdataPoles[innerRadiusIndex][0];
-            noRuAE3 = noRlAE3 = HRIRdataPoles[outerRadiusIndex][0];
-            nuAE3BaseCh = nlAE3BaseCh = 0;
-        } else {
-            niRuAE3 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-            noRuAE3 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-            niRlAE3 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-            noRlAE3 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-            nuAE3BaseCh = uAziBaseCh;
-            nlAE3BaseCh = lAziBaseCh;
-        }
-        if (upperElevationIndex == numElevationSteps) {
-            niRuAE4 = niRlAE4 = HRIRdataPoles[innerRadiusIndex][1];
-            noRuAE4 = noRlAE4 = HRIRdataPoles[outerRadiusIndex][1];
-            nuAE4BaseCh = nlAE4BaseCh = 0;
-        } else {
-            niRuAE4 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-            noRuAE4 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-            niRlAE4 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-            noRlAE4 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-            nuAE4BaseCh = uAziBaseCh;
-            nlAE4BaseCh = lAziBaseCh;
+    HRIRStale = true;
+    prevHRIRChange = HRIRChange;
+    HRIRChange = false;
+}
+
+void PlayableSoundSource::mixBasisFilterOutputs(const float* whichHRIRs, const float* whichHRIRScaling, const int count, float* y, const int N) const noexcept
+{
+    const int K = hrirBasisFilters->getNumFilters();
+    // the weights of the hrirs at both ends of a blending segment on the filters, [ear][filter] for each
+    STACK_ARRAY(float, weights, 4*K)
+    float* w0 = &weights[0];
+    float* w1 = &weights[2*K];
+    const auto project = [&] (const int j, float* w)
+    {
+        for (int ch = 0; ch < 2; ++ch)
+            hrirBasisFilters->project(&whichHRIRs[(2*j + ch)*maxNumTimeSteps], whichHRIRScaling[2*j + ch], &w[ch*K]);
+    };
+    if (count == 1) {
+        project(0, w0);
+        const float* ws[2] {&w0[0], &w0[K]};
+        for (int n = 0; n < N; ++n) {
+            float sums[2];
+            simd::dots<2>(&basisConvolvedInput[n*K], ws, K, sums);
+            y[    n] = sums[0];
+            y[N + n] = sums[1];
         }
+        return;
     }
-    if (lElem1Flip) {
-        iRuAE1 = HRIRdata[innerRadiusIndex][upperAziIndexEleFlipped][lElem1-1];
-        iRlAE1 = HRIRdata[innerRadiusIndex][lowerAziIndexEleFlipped][lElem1-1];
-        oRuAE1 = HRIRdata[outerRadiusIndex][upperAziIndexEleFlipped][lElem1-1];
-        oRlAE1 = HRIRdata[outerRadiusIndex][lowerAziIndexEleFlipped][lElem1-1];
-        uAE1BaseCh = (uAziBaseCh + 1) % 2;
-        lAE1BaseCh = (lAziBaseCh + 1) % 2;
-    } else if (lElem1 == 0) {
-        iRuAE1 = iRlAE1 = HRIRdataPoles[innerRadiusIndex][0];
-        oRuAE1 = oRlAE1 = HRIRdataPoles[outerRadiusIndex][0];
-        uAE1BaseCh = lAE1BaseCh = 0;
-    } else {
-        iRuAE1 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][lElem1-1];
-        iRlAE1 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][lElem1-1];
-        oRuAE1 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][lElem1-1];
-        oRlAE1 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][lElem1-1];
-        uAE1BaseCh = uAziBaseCh;
-        lAE1BaseCh = lAziBaseCh;
-    }
-    if (lowerElevationIndex == 0) {
-        iRuAE2 = iRlAE2 = HRIRdataPoles[innerRadiusIndex][0];
-        oRuAE2 = oRlAE2 = HRIRdataPoles[outerRadiusIndex][0];
-    } else {
-        iRuAE2 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-        iRlAE2 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-        oRuAE2 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-        oRlAE2 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-    }
-    if (upperElevationIndex == numElevationSteps) {
-        iRuAE3 = iRlAE3 = HRIRdataPoles[innerRadiusIndex][1];
-        oRuAE3 = oRlAE3 = HRIRdataPoles[outerRadiusIndex][1];
-        //uAE3BaseCh = lAE3BaseCh = 0;
-    } else {
-        iRuAE3 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-        iRlAE3 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-        oRuAE3 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-        oRlAE3 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-        //uAE3BaseCh = uAziBaseCh;
-        //lAE3BaseCh = lAziBaseCh;
+    // the mixes of the hrirs at both ends of a segment blend across it, the same as the outputs of the blended hrirs do in convolveStereo()
+    const float L = N / float(count - 1);
+    int prevHi = -1;
+    for (int n = 0; n < N; ++n) {
+        const int hi = std::min((int)(n / L), count - 2);
+        if (hi != prevHi) {
+            if (hi == prevHi + 1 && prevHi >= 0)
+                std::swap(w0, w1);
+            else
+                project(hi, w0);
+            project(hi + 1, w1);
+            prevHi = hi;
+        }
+        const float* ws[4] {&w0[0], &w1[0], &w0[K], &w1[K]};
+        float sums[4];
+        simd::dots<4>(&basisConvolvedInput[n*K], ws, K, sums);
+        const float hBlend = n / L - hi;
+        y[    n] = sums[0] * (1 - hBlend) + sums[1] * hBlend;
+        y[N + n] = sums[2] * (1 - hBlend) + sums[3] * hBlend;
     }
-    if (uElep1Flip) {
-        iRuAE4 = HRIRdata[innerRadiusIndex][upperAziIndexEleFlipped][uElep1-1];
-        iRlAE4 = HRIRdata[innerRadiusIndex][lowerAziIndexEleFlipped][uElep1-1];
-        oRuAE4 = HRIRdata[outerRadiusIndex][upperAziIndexEleFlipped][uElep1-1];
-        oRlAE4 = HRIRdata[outerRadiusIndex][lowerAziIndexEleFlipped][uElep1-1];
-        uAE4BaseCh = (uAziBaseCh + 1) % 2;
-        lAE4BaseCh = (lAziBaseCh + 1) % 2;
-    } else if (uElep1 == numElevationSteps) {
-        iRuAE4 = iRlAE4 = HRIRdataPoles[innerRadiusIndex][1];
-        oRuAE4 = oRlAE4 = HRIRdataPoles[outerRadiusIndex][1];
-        uAE4BaseCh = lAE4BaseCh = 0;
-    } else {
-        iRuAE4 = HRIRdata[innerRadiusIndex][upperAzimuthIndex][uElep1-1];
-        iRlAE4 = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][uElep1-1];
-        oRuAE4 = HRIRdata[outerRadiusIndex][upperAzimuthIndex][uElep1-1];
-        oRlAE4 = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][uElep1-1];
-        uAE4BaseCh = uAziBaseCh;
-        lAE4BaseCh = lAziBaseCh;
+}
+
+void PlayableSoundSource::fftConvolve(const float* const* inputs, const float* whichHRIRs, const float* whichHRIRScaling, float* y, const int N) noexcept
+{
+    const int M = fftConvolver.getSpectrumSize();
+    const auto spectrum = [&] (const int slot, const int ch) { return &HRIRSpectra[(slot*2 + ch) * M]; };
+    // the current hrir's spectra only need computing when it changes, not for every buffer
+    if (!HRIRSpectraValid) {
+        for (int ch = 0; ch < 2; ++ch)
+            fftConvolver.computeSpectrum(&whichHRIRs[ch*maxNumTimeSteps], hrirLength, whichHRIRScaling[ch], spectrum(currentHRIRSpectra, ch));
+        HRIRSpectraValid = true;
     }
-    
-    float mu2n;
-    if (nAziUp) {
-        mu2n = mu2 - 1;
-        if (lowerElevationIndex == 0) {
-            niRA1lE = niRA2lE = niRA3lE = niRA4lE = HRIRdataPoles[innerRadiusIndex][0];
-            noRA1lE = noRA2lE = noRA3lE = noRA4lE = HRIRdataPoles[outerRadiusIndex][0];
-            nA1lEBaseCh = nA2lEBaseCh = nA3lEBaseCh = nA4lEBaseCh = 0;
+    const int current = currentHRIRSpectra;
+    // one ear at a time if they have their own inputs
+    const bool sharedInput = inputs[0] == inputs[1];
+    if (!HRIRChange) {
+        const std::complex<float>* spectra[2] {spectrum(current, 0), spectrum(current, 1)};
+        float* outputs[2] {&y[0], &y[N]};
+        if (sharedInput) {
+            fftConvolver.process(inputs[0], inputBufferOutPos, inputBufferSize, hrirLength, spectra, 2, outputs, N);
         } else {
-            niRA1lE = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-            niRA2lE = HRIRdata[innerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-            niRA3lE = HRIRdata[innerRadiusIndex][uAzip1]           [lowerElevationIndex-1];
-            niRA4lE = HRIRdata[innerRadiusIndex][nAzi2]            [lowerElevationIndex-1];
-            noRA1lE = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-            noRA2lE = HRIRdata[outerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-            noRA3lE = HRIRdata[outerRadiusIndex][uAzip1]           [lowerElevationIndex-1];
-            noRA4lE = HRIRdata[outerRadiusIndex][nAzi2]            [lowerElevationIndex-1];
-            nA1lEBaseCh = lAziBaseCh;
-            nA2lEBaseCh = uAziBaseCh;
-            nA3lEBaseCh = uAzip1BaseCh;
-            nA4lEBaseCh = nAziBaseCh;
-        }
-        if (upperElevationIndex == numElevationSteps) {
-            niRA1uE = niRA2uE = niRA3uE = niRA4uE = HRIRdataPoles[innerRadiusIndex][1];
-            noRA1uE = noRA2uE = noRA3uE = noRA4uE = HRIRdataPoles[outerRadiusIndex][1];
-            nA1uEBaseCh = nA2uEBaseCh = nA3uEBaseCh = nA4uEBaseCh = 0;
-        } else {
-            niRA1uE = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-            niRA2uE = HRIRdata[innerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-            niRA3uE = HRIRdata[innerRadiusIndex][uAzip1]           [upperElevationIndex-1];
-            niRA4uE = HRIRdata[innerRadiusIndex][nAzi2]            [upperElevationIndex-1];
-            noRA1uE = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-            noRA2uE = HRIRdata[outerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-            noRA3uE = HRIRdata[outerRadiusIndex][uAzip1]           [upperElevationIndex-1];
-            noRA4uE = HRIRdata[outerRadiusIndex][nAzi2]            [upperElevationIndex-1];
-            nA1uEBaseCh = lAziBaseCh;
-            nA2uEBaseCh = uAziBaseCh;
-            nA3uEBaseCh = uAzip1BaseCh;
-            nA4uEBaseCh = nAziBaseCh;
+            for (int ch = 0; ch < 2; ++ch)
+                fftConvolver.process(inputs[ch], inputBufferOutPos, inputBufferSize, hrirLength, &spectra[ch], 1, &outputs[ch], N);
         }
     } else {
-        mu2n = mu2 + 1;
-        if (lowerElevationIndex == 0) { // NOTE; this is exact same as in nAziUp above
-            niRA1lE = niRA2lE = niRA3lE = niRA4lE = HRIRdataPoles[innerRadiusIndex][0];
-            noRA1lE = noRA2lE = noRA3lE = noRA4lE = HRIRdataPoles[outerRadiusIndex][0];
-            nA1lEBaseCh = nA2lEBaseCh = nA3lEBaseCh = nA4lEBaseCh = 0;
+        // both the old and new hrirs for each ear, then crossfade between the two outputs (just like the direct convolution blends them)
+        const int next = 1 - current;
+        for (int ch = 0; ch < 2; ++ch)
+            fftConvolver.computeSpectrum(&whichHRIRs[(2+ch)*maxNumTimeSteps], hrirLength, whichHRIRScaling[2+ch], spectrum(next, ch));
+        STACK_ARRAY(float, yNext, 2*N)
+        const std::complex<float>* spectra[4] {spectrum(current, 0), spectrum(next, 0), spectrum(current, 1), spectrum(next, 1)};
+        float* outputs[4] {&y[0], &yNext[0], &y[N], &yNext[N]};
+        if (sharedInput) {
+            fftConvolver.process(inputs[0], inputBufferOutPos, inputBufferSize, hrirLength, spectra, 4, outputs, N);
         } else {
-            niRA1lE = HRIRdata[innerRadiusIndex][nAzi2]            [lowerElevationIndex-1];
-            niRA2lE = HRIRdata[innerRadiusIndex][lAzim1]           [lowerElevationIndex-1];
-            niRA3lE = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-            niRA4lE = HRIRdata[innerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-            noRA1lE = HRIRdata[outerRadiusIndex][nAzi2]            [lowerElevationIndex-1];
-            noRA2lE = HRIRdata[outerRadiusIndex][lAzim1]           [lowerElevationIndex-1];
-            noRA3lE = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-            noRA4lE = HRIRdata[outerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-            nA1lEBaseCh = nAziBaseCh;
-            nA2lEBaseCh = lAzim1BaseCh;
-            nA3lEBaseCh = lAziBaseCh;
-            nA4lEBaseCh = uAziBaseCh;
+            for (int ch = 0; ch < 2; ++ch)
+                fftConvolver.process(inputs[ch], inputBufferOutPos, inputBufferSize, hrirLength, &spectra[2*ch], 2, &outputs[2*ch], N);
         }
-        if (upperElevationIndex == numElevationSteps) { // NOTE; this is exact same as in nAziUp above
-            niRA1uE = niRA2uE = niRA3uE = niRA4uE = HRIRdataPoles[innerRadiusIndex][1];
-            noRA1uE = noRA2uE = noRA3uE = noRA4uE = HRIRdataPoles[outerRadiusIndex][1];
-            nA1uEBaseCh = nA2uEBaseCh = nA3uEBaseCh = nA4uEBaseCh = 0;
-        } else {
-            niRA1uE = HRIRdata[innerRadiusIndex][nAzi2]            [upperElevationIndex-1];
-            niRA2uE = HRIRdata[innerRadiusIndex][lAzim1]           [upperElevationIndex-1];
-            niRA3uE = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-            niRA4uE = HRIRdata[innerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-            noRA1uE = HRIRdata[outerRadiusIndex][nAzi2]            [upperElevationIndex-1];
-            noRA2uE = HRIRdata[outerRadiusIndex][lAzim1]           [upperElevationIndex-1];
-            noRA3uE = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-            noRA4uE = HRIRdata[outerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-            nA1uEBaseCh = nAziBaseCh;
-            nA2uEBaseCh = lAzim1BaseCh;
-            nA3uEBaseCh = lAziBaseCh;
-            nA4uEBaseCh = uAziBaseCh;
+        const float oneOverN = 1.0f / N;
+        for (int ch = 0; ch < 2; ++ch) {
+            for (int n = 0; n < N; ++n) {
+                const float blend = n * oneOverN;
+                y[ch*N + n] = y[ch*N + n] * (1 - blend) + yNext[ch*N + n] * blend;
+            }
         }
+        currentHRIRSpectra = next;
     }
-    if (lowerElevationIndex == 0) {
-        iRA1lE = iRA2lE = iRA3lE = iRA4lE = HRIRdataPoles[innerRadiusIndex][0];
-        oRA1lE = oRA2lE = oRA3lE = oRA4lE = HRIRdataPoles[outerRadiusIndex][0];
-    } else {
-        iRA1lE = HRIRdata[innerRadiusIndex][lAzim1]           [lowerElevationIndex-1];
-        iRA2lE = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-        iRA3lE = HRIRdata[innerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-        iRA4lE = HRIRdata[innerRadiusIndex][uAzip1]           [lowerElevationIndex-1];
-        oRA1lE = HRIRdata[outerRadiusIndex][lAzim1]           [lowerElevationIndex-1];
-        oRA2lE = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][lowerElevationIndex-1];
-        oRA3lE = HRIRdata[outerRadiusIndex][upperAzimuthIndex][lowerElevationIndex-1];
-        oRA4lE = HRIRdata[outerRadiusIndex][uAzip1]           [lowerElevationIndex-1];
+}
+
+void PlayableSoundSource::setHRIRCache(HRIRCache* newHRIRCache) noexcept
+{
+    hrirCache = newHRIRCache;
+}
+
+void PlayableSoundSource::setInterpolationQuality(const HRIRInterpolationQuality newQuality) noexcept
+{
+    interpolationQuality = newQuality;
+}
+
+void PlayableSoundSource::setHRIRSphericalHarmonics(const HRIRSphericalHarmonics* newHRIRSphericalHarmonics) noexcept
+{
+    hrirSphericalHarmonics = newHRIRSphericalHarmonics;
+}
+
+void PlayableSoundSource::setHRIRBaker(const HRIRBaker* newHRIRBaker, const int sourceIndex, const float posSec) noexcept
+{
+    hrirBaker = newHRIRBaker;
+    hrirBakerSourceIndex = sourceIndex;
+    hrirBakerPosSec = posSec;
+}
+
+void PlayableSoundSource::setBasisFilterRendering(const HRIRBasisFilters* newHRIRBasisFilters, const float* newConvolvedInput) noexcept
+{
+    hrirBasisFilters = newHRIRBasisFilters;
+    basisConvolvedInput = newConvolvedInput;
+}
+
+void PlayableSoundSource::setVirtualSpeakerRendering(VirtualSpeakers* newVirtualSpeakers) noexcept
+{
+    // gains for one bus mean nothing on another
+    if (newVirtualSpeakers != virtualSpeakers)
+        busGainsValid = false;
+    virtualSpeakers = newVirtualSpeakers;
+}
+
+void PlayableSoundSource::setAmbisonicRendering(AmbisonicBus* newAmbisonicBus) noexcept
+{
+    if (newAmbisonicBus != ambisonicBus)
+        busGainsValid = false;
+    ambisonicBus = newAmbisonicBus;
+}
+
+void PlayableSoundSource::interpolateHRIR(const float* rae, float* hrir, float* delays, float* scaling) const noexcept
+{
+    // sources sitting still with jittery positions or going around the same path keep landing on the same (quantized) positions, only normalized hrirs are cached
+    if (hrirCache && scaling) {
+        float quantizedRAE[3];
+        const std::uint64_t key = hrirCache->quantize(rae, quantizedRAE);
+        if (!hrirCache->find(key, hrirLength, hrir, delays, scaling)) {
+            interpolateHRIRs(quantizedRAE, 1, hrir, delays, scaling);
+            hrirCache->insert(key, hrirLength, hrir, delays, scaling);
+        }
+        return;
     }
-    if (upperElevationIndex == numElevationSteps) {
-        iRA1uE = iRA2uE = iRA3uE = iRA4uE = HRIRdataPoles[innerRadiusIndex][1];
-        oRA1uE = oRA2uE = oRA3uE = oRA4uE = HRIRdataPoles[outerRadiusIndex][1];
-    } else {
-        iRA1uE = HRIRdata[innerRadiusIndex][lAzim1]           [upperElevationIndex-1];
-        iRA2uE = HRIRdata[innerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-        iRA3uE = HRIRdata[innerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-        iRA4uE = HRIRdata[innerRadiusIndex][uAzip1]           [upperElevationIndex-1];
-        oRA1uE = HRIRdata[outerRadiusIndex][lAzim1]           [upperElevationIndex-1];
-        oRA2uE = HRIRdata[outerRadiusIndex][lowerAzimuthIndex][upperElevationIndex-1];
-        oRA3uE = HRIRdata[outerRadiusIndex][upperAzimuthIndex][upperElevationIndex-1];
-        oRA4uE = HRIRdata[outerRadiusIndex][uAzip1]           [upperElevationIndex-1];
-//        A1uEBaseCh = lAzim1BaseCh;
-//        A2uEBaseCh = lAziBaseCh;
-//        A3uEBaseCh = uAziBaseCh;
-//        A4uEBaseCh = uAzip1BaseCh;
+    interpolateHRIRs(rae, 1, hrir, delays, scaling);
+}
+
+// compacted (one azimuth side provided) with pole data version
+void PlayableSoundSource::interpolateHRIRs(const float* raes, const int count, float* hrirs, float* delays, float* scaling) const noexcept
+{
+    if (interpolationQuality == HRIRInterpolationQuality::SPHERICAL_HARMONICS && hrirSphericalHarmonics
+        && hrirSphericalHarmonics->isReady() && hrirSphericalHarmonics->getHRIRData() == hrirData) {
+        for (int p = 0; p < count; ++p)
+            hrirSphericalHarmonics->interpolateHRIR(&raes[3*p], &hrirs[p*2*maxNumTimeSteps], delays ? &delays[p*2] : nullptr, scaling ? &scaling[p*2] : nullptr);
+        return;
     }
+    const HRIRStencils& stencils = HRIRStencils::get();
+    constexpr int numAngular = HRIRStencils::numNeighbors;
+    constexpr int numNeighbors = 2 * numAngular;
+    const int length = hrirData->getLength(); // the right ear's hrir follows the left ear's
+    const bool withDelays = delays && hrirData->hasDelays();
+    // the neighbors (and their onset delays) only change when a position lands in a different cell or cell half than the one before it, which along a trajectory is rare
+    const HRIRData::Sample* neighbors[2][numNeighbors]; // [ear][neighbor]
+    float neighborDelays[2][numNeighbors];
+    int neighborsCell = -1;
     
-    // mu1's are for azi interp
-    const float mu1_1 = mu1 - 1;
-    const float mu1_2 = mu1 - 2;
-    const float mu1_3 = mu1 - 3;
-    const float mu1_4 = mu1 - 4;
-    const float mu1n_1 = mu1n - 1;
-    const float mu1n_2 = mu1n - 2;
-    const float mu1n_3 = mu1n - 3;
-    const float mu1n_4 = mu1n - 4;
-    
-    // mu2's are for ele interp
-    const float mu2_1 = mu2 - 1;
-    const float mu2_2 = mu2 - 2;
-    const float mu2_3 = mu2 - 3;
-    const float mu2_4 = mu2 - 4;
-    const float mu2n_1 = mu2n - 1;
-    const float mu2n_2 = mu2n - 2;
-    const float mu2n_3 = mu2n - 3;
-    const float mu2n_4 = mu2n - 4;
-    
-    const float oneminus_nmu1 = 1.0 - nmu1;
-    const float oneminus_nmu2 = 1.0 - nmu2;
-    const float oneminus_mu3 = 0.5*intensity_factor - mu3;//1.0 - mu3; // scaled by 1/2*intensity_factor here instead of for each sample below
-    const float oneminus_mu1_01 = 1.0 - mu1_01;
-    const float oneminus_mu2_01 = 1.0 - mu2_01;
-    
-    const float a1 = mu1_2 * mu1_3 * mu1_4 * -0.1666666666666666667;
-    const float a2 = mu1_1 * mu1_3 * mu1_4 * 0.5;
-    const float a3 = mu1_1 * mu1_2 * mu1_4 * -0.5;
-    const float a4 = mu1_1 * mu1_2 * mu1_3 * 0.1666666666666666667;
-    const float na1 = mu1n_2 * mu1n_3 * mu1n_4 * -0.1666666666666666667;
-    const float na2 = mu1n_1 * mu1n_3 * mu1n_4 * 0.5;
-    const float na3 = mu1n_1 * mu1n_2 * mu1n_4 * -0.5;
-    const float na4 = mu1n_1 * mu1n_2 * mu1n_3 * 0.1666666666666666667;
-    
-    const float e1 = mu2_2 * mu2_3 * mu2_4 * -0.1666666666666666667;
-    const float e2 = mu2_1 * mu2_3 * mu2_4 * 0.5;
-    const float e3 = mu2_1 * mu2_2 * mu2_4 * -0.5;
-    const float e4 = mu2_1 * mu2_2 * mu2_3 * 0.1666666666666666667;
-    const float ne1 = mu2n_2 * mu2n_3 * mu2n_4 * -0.1666666666666666667;
-    const float ne2 = mu2n_1 * mu2n_3 * mu2n_4 * 0.5;
-    const float ne3 = mu2n_1 * mu2n_2 * mu2n_4 * -0.5;
-    const float ne4 = mu2n_1 * mu2n_2 * mu2n_3 * 0.1666666666666666667;
-    
-    // intermediate interpolation values (in-region/nearby)(inner/outer)(azimuth/elevation)(plus/minus)
-    float inAp, inAm, inEp, inEm, outAp, outAm, outEp, outEm, netIn, netOut;
-    
-    bool again = true;
-    int hrirCh = 0;
-AGAIN:
-    for (int n = 0; n < numTimeSteps; ++n)
-    {
-        inAp = nmu1*(na1*niRuAE1[nuAE1BaseCh][n] + na2*niRuAE2[nuAE2BaseCh][n] + na3*niRuAE3[nuAE3BaseCh][n] + na4*niRuAE4[nuAE4BaseCh][n])
-    + oneminus_nmu1*( a1* iRuAE1[ uAE1BaseCh][n] +  a2* iRuAE2[ uAziBaseCh][n] +  a3* iRuAE3[ uAziBaseCh][n] +  a4* iRuAE4[ uAE4BaseCh][n]);
+    for (int p = 0; p < count; ++p) {
+        const float* const rae = &raes[3*p];
+        float* const hrir = &hrirs[p*2*maxNumTimeSteps];
         
-        inAm = nmu1*(na1*niRlAE1[nlAE1BaseCh][n] + na2*niRlAE2[nlAE2BaseCh][n] + na3*niRlAE3[nlAE3BaseCh][n] + na4*niRlAE4[nlAE4BaseCh][n])
-    + oneminus_nmu1*( a1* iRlAE1[ lAE1BaseCh][n] +  a2* iRlAE2[ lAziBaseCh][n] +  a3* iRlAE3[ lAziBaseCh][n] +  a4* iRlAE4[ lAE4BaseCh][n]);
+        // get the inner + outer rad,azi,ele indicies that define the 3d region bounded by the hrtf/dvf sampling resolution that the source is currently located in
+        const int innerRadiusIndex = stencils.getInnerRadiusIndex(rae[0]);
+        const int outerRadiusIndex = innerRadiusIndex+1;
         
-        outAp = nmu1*(na1*noRuAE1[nuAE1BaseCh][n] + na2*noRuAE2[nuAE2BaseCh][n] + na3*noRuAE3[nuAE3BaseCh][n] + na4*noRuAE4[nuAE4BaseCh][n])
-     + oneminus_nmu1*( a1* oRuAE1[ uAE1BaseCh][n] +  a2* oRuAE2[ uAziBaseCh][n] +  a3* oRuAE3[ uAziBaseCh][n] +  a4* oRuAE4[ uAE4BaseCh][n]);
+        const int lowerElevationIndex = std::max(0, std::min((int)(rae[2]*(float)(numElevationSteps/M_PI)), numElevationSteps-1));
         
-        outAm = nmu1*(na1*noRlAE1[nlAE1BaseCh][n] + na2*noRlAE2[nlAE2BaseCh][n] + na3*noRlAE3[nlAE3BaseCh][n] + na4*noRlAE4[nlAE4BaseCh][n])
-     + oneminus_nmu1*( a1* oRlAE1[ lAE1BaseCh][n] +  a2* oRlAE2[ lAziBaseCh][n] +  a3* oRlAE3[ lAziBaseCh][n] +  a4* oRlAE4[ lAE4BaseCh][n]);
+        float revAzi = 2*M_PI-rae[1]; // fix reversed azimuth indexing with hrir array's
+        if (revAzi >= 2*M_PI)
+            revAzi -= 2*M_PI;
+        else if (revAzi < 0)
+            revAzi += 2*M_PI;
+        const int lowerAzimuthIndex = std::min((int)(revAzi*(float)(numAzimuthSteps/(2*M_PI))), numAzimuthSteps-1);
         
+        // inner/outer surface radius values
+        const float rIn  = stencils.getRadius(innerRadiusIndex);
+        const float rOut = stencils.getRadius(outerRadiusIndex);
         
-        inEp = nmu2*(ne1*niRA1uE[ nA1uEBaseCh][n] + ne2*niRA2uE[nA2uEBaseCh][n] + ne3*niRA3uE[nA3uEBaseCh][n] + ne4*niRA4uE[ nA4uEBaseCh][n])
-    + oneminus_nmu2*( e1* iRA1uE[lAzim1BaseCh][n] +  e2* iRA2uE[ lAziBaseCh][n] +  e3* iRA3uE[ uAziBaseCh][n] +  e4* iRA4uE[uAzip1BaseCh][n]);
+        // for making close/far more loud/quiet
+        const float intensity_factor = 0.1f / std::sqrt(rae[0]);
         
-        inEm = nmu2*(ne1*niRA1lE[ nA1lEBaseCh][n] + ne2*niRA2lE[nA2lEBaseCh][n] + ne3*niRA3lE[nA3lEBaseCh][n] + ne4*niRA4lE[ nA4lEBaseCh][n])
-    + oneminus_nmu2*( e1* iRA1lE[lAzim1BaseCh][n] +  e2* iRA2lE[ lAziBaseCh][n] +  e3* iRA3lE[ uAziBaseCh][n] +  e4* iRA4lE[uAzip1BaseCh][n]);
+        const float mu3 = 0.5f*intensity_factor*std::min((rae[0]-rIn)/(rOut-rIn), 1.0f); // scaled by 1/2*intensity_factor here instead of for each sample below
+        const float oneminus_mu3 = 0.5f*intensity_factor - mu3;
         
-        outEp = nmu2*(ne1*noRA1uE[ nA1uEBaseCh][n] + ne2*noRA2uE[nA2uEBaseCh][n] + ne3*noRA3uE[nA3uEBaseCh][n] + ne4*noRA4uE[ nA4uEBaseCh][n])
-     + oneminus_nmu2*( e1* oRA1uE[lAzim1BaseCh][n] +  e2* oRA2uE[ lAziBaseCh][n] +  e3* oRA3uE[ uAziBaseCh][n] +  e4* oRA4uE[uAzip1BaseCh][n]);
+        // interpolate along azimuth edges
+        const float mu1_01 = (rae[2]-lowerElevationIndex*(float)(M_PI/numElevationSteps))*(float)(numElevationSteps/M_PI); // should be btw 0 and 1
+        const float nmu1 = std::abs(0.5f-mu1_01); // should be 0 when source is dead center in interp region, 0.5 when source is on boarder
         
-        outEm = nmu2*(ne1*noRA1lE[ nA1lEBaseCh][n] + ne2*noRA2lE[nA2lEBaseCh][n] + ne3*noRA3lE[nA3lEBaseCh][n] + ne4*noRA4lE[ nA4lEBaseCh][n])
-     + oneminus_nmu2*( e1* oRA1lE[lAzim1BaseCh][n] +  e2* oRA2lE[ lAziBaseCh][n] +  e3* oRA3lE[ uAziBaseCh][n] +  e4* oRA4lE[uAzip1BaseCh][n]);
+        // interpolate along elevation edges
+        const float mu2_01 = (revAzi-lowerAzimuthIndex*(float)(2*M_PI/numAzimuthSteps))*(float)(numAzimuthSteps/(2*M_PI)); // should be btw 0 and 1
+        const float nmu2 = std::abs(0.5f-mu2_01); // should be 0 when source is dead center in interp region, 0.5 when source is on boarder
         
+        // the nearby interpolations use the neighbors shifted one index towards the closer side of the region
+        const bool nEleUp = mu1_01 >= 0.5f;
+        const bool nAziUp = mu2_01 >= 0.5f;
         
-        netIn  = (oneminus_mu1_01*inEm  + mu1_01*inEp)
-               + (oneminus_mu2_01*inAm  + mu2_01*inAp);
-        netOut = (oneminus_mu1_01*outEm + mu1_01*outEp)
-               + (oneminus_mu2_01*outAm + mu2_01*outAp);
+        float weights[numNeighbors];
+        // the corners of the cell are the in-region neighbors 1 and 2 (lower and upper elevation) along the upper and lower azimuths of the stencil
+        static constexpr int corners[4] = {5, 6, 13, 14};
+        int usedNeighbors[8];
+        int numUsed = numNeighbors;
+        if (interpolationQuality == HRIRInterpolationQuality::FULL || interpolationQuality == HRIRInterpolationQuality::SPHERICAL_HARMONICS) {
+            // cubic lagrange weights for the in-region (between neighbors 2 and 3) and nearby (shifted by one) interpolations along elevation (a, na) and azimuth (e, ne)
+            const auto lagrange = [] (const float mu, float* w)
+            {
+                const float mu_1 = mu - 1, mu_2 = mu - 2, mu_3 = mu - 3, mu_4 = mu - 4;
+                w[0] = mu_2 * mu_3 * mu_4 * -0.1666666666666666667f;
+                w[1] = mu_1 * mu_3 * mu_4 * 0.5f;
+                w[2] = mu_1 * mu_2 * mu_4 * -0.5f;
+                w[3] = mu_1 * mu_2 * mu_3 * 0.1666666666666666667f;
+            };
+            float a[4], na[4], e[4], ne[4];
+            lagrange(mu1_01 + 2, a);
+            lagrange(mu1_01 + (nEleUp ? 1 : 3), na);
+            lagrange(mu2_01 + 2, e);
+            lagrange(mu2_01 + (nAziUp ? 1 : 3), ne);
         
-        hrir[hrirCh*numTimeSteps+n] = /*0.5*intensity_factor**/(mu3*netOut + oneminus_mu3*netIn);
-    }
-    if (again)
-    {
-        nuAE1BaseCh = (nuAE1BaseCh + 1) % 2;
-        nuAE2BaseCh = (nuAE2BaseCh + 1) % 2;
-        nuAE3BaseCh = (nuAE3BaseCh + 1) % 2;
-        nuAE4BaseCh = (nuAE4BaseCh + 1) % 2;
-        nlAE1BaseCh = (nlAE1BaseCh + 1) % 2;
-        nlAE2BaseCh = (nlAE2BaseCh + 1) % 2;
-        nlAE3BaseCh = (nlAE3BaseCh + 1) % 2;
-        nlAE4BaseCh = (nlAE4BaseCh + 1) % 2;
-         uAE1BaseCh = ( uAE1BaseCh + 1) % 2;
-         //uAE3BaseCh = ( uAE3BaseCh + 1) % 2;
-         uAE4BaseCh = ( uAE4BaseCh + 1) % 2;
-         lAE1BaseCh = ( lAE1BaseCh + 1) % 2;
-         //lAE3BaseCh = ( lAE3BaseCh + 1) % 2;
-         lAE4BaseCh = ( lAE4BaseCh + 1) % 2;
-        nA1uEBaseCh = (nA1uEBaseCh + 1) % 2;
-        nA2uEBaseCh = (nA2uEBaseCh + 1) % 2;
-        nA3uEBaseCh = (nA3uEBaseCh + 1) % 2;
-        nA4uEBaseCh = (nA4uEBaseCh + 1) % 2;
-        nA1lEBaseCh = (nA1lEBaseCh + 1) % 2;
-        nA2lEBaseCh = (nA2lEBaseCh + 1) % 2;
-        nA3lEBaseCh = (nA3lEBaseCh + 1) % 2;
-        nA4lEBaseCh = (nA4lEBaseCh + 1) % 2;
-//         A1uEBaseCh = ( A1uEBaseCh + 1) % 2;
-//         A2uEBaseCh = ( A2uEBaseCh + 1) % 2;
-//         A3uEBaseCh = ( A3uEBaseCh + 1) % 2;
-//         A4uEBaseCh = ( A4uEBaseCh + 1) % 2;
-        lAzim1BaseCh = (lAzim1BaseCh + 1) % 2;
-          lAziBaseCh = (  lAziBaseCh + 1) % 2;
-          uAziBaseCh = (  uAziBaseCh + 1) % 2;
-        uAzip1BaseCh = (uAzip1BaseCh + 1) % 2;
-        hrirCh = 1;
-        again = false;
-        goto AGAIN; // i love the goto
+            // the interpolated hrir is just a weighted sum of the 64 neighboring hrirs, so rather than blending the intermediate (in-region/nearby)(inner/outer)(azimuth/elevation)(plus/minus)
+            // interpolations sample by sample, multiply their weights through and let HRIRData::weightedSum() do the work (which also decodes the stored samples)
+            // netIn  = (oneminus_mu1_01*inEm  + mu1_01*inEp)  + (oneminus_mu2_01*inAm  + mu2_01*inAp)
+            // netOut = (oneminus_mu1_01*outEm + mu1_01*outEp) + (oneminus_mu2_01*outAm + mu2_01*outAp)
+            // hrir = mu3*netOut + oneminus_mu3*netIn
+            // the angular weights are shared by the inner and outer neighbors, in the same order as the stencil
+            float angularWeights[numAngular];
+            {
+                float* w = angularWeights;
+                const auto addGroup = [&w] (const float side, const float nmu, const float* nearby, const float* inRegion)
+                {
+                    for (int k = 0; k < 4; ++k)
+                        *w++ = side * nmu * nearby[k];
+                    for (int k = 0; k < 4; ++k)
+                        *w++ = side * (1 - nmu) * inRegion[k];
+                };
+                addGroup(mu2_01,     nmu1, na, a); // along the upper azimuth
+                addGroup(1 - mu2_01, nmu1, na, a); // along the lower azimuth
+                addGroup(mu1_01,     nmu2, ne, e); // along the upper elevation
+                addGroup(1 - mu1_01, nmu2, ne, e); // along the lower elevation
+            }
+        
+            for (int i = 0; i < numAngular; ++i) {
+                weights[i] = oneminus_mu3 * angularWeights[i];
+                weights[numAngular + i] = mu3 * angularWeights[i];
+            }
+        } else if (interpolationQuality == HRIRInterpolationQuality::TRILINEAR) {
+            const float cornerWeights[4] = {mu2_01 * (1 - mu1_01), mu2_01 * mu1_01, (1 - mu2_01) * (1 - mu1_01), (1 - mu2_01) * mu1_01};
+            numUsed = 0;
+            for (int c = 0; c < 4; ++c) {
+                usedNeighbors[numUsed] = corners[c];
+                weights[numUsed++] = 2 * oneminus_mu3 * cornerWeights[c];
+                usedNeighbors[numUsed] = numAngular + corners[c];
+                weights[numUsed++] = 2 * mu3 * cornerWeights[c];
+            }
+        } else {
+            usedNeighbors[0] = corners[(nAziUp ? 0 : 2) + nEleUp] + (mu3 > oneminus_mu3 ? numAngular : 0);
+            weights[0] = intensity_factor;
+            numUsed = 1;
+        }
+        
+        const int cell = (((innerRadiusIndex*numAzimuthSteps + lowerAzimuthIndex)*numElevationSteps + lowerElevationIndex)*2 + nAziUp)*2 + nEleUp;
+        if (cell != neighborsCell) {
+            neighborsCell = cell;
+            const HRIRStencils::Neighbor* const stencil = stencils.getStencil(lowerAzimuthIndex, lowerElevationIndex, nAziUp, nEleUp);
+            for (int i = 0; i < numAngular; ++i) {
+                const int direction = stencil[i] >> 1;
+                const int channel = stencil[i] & 1;
+                const HRIRData::Sample* const inner = hrirData->getHRIR(innerRadiusIndex, direction);
+                const HRIRData::Sample* const outer = hrirData->getHRIR(outerRadiusIndex, direction);
+                neighbors[0][i] = inner +      channel  * length;
+                neighbors[1][i] = inner + (1 - channel) * length;
+                neighbors[0][numAngular + i] = outer +      channel  * length;
+                neighbors[1][numAngular + i] = outer + (1 - channel) * length;
+            }
+            if (withDelays)
+                for (int ch = 0; ch < 2; ++ch)
+                    for (int i = 0; i < numNeighbors; ++i)
+                        neighborDelays[ch][i] = hrirData->getDelay(neighbors[ch][i]);
+        }
+        // the lower tiers just pick their few neighbors out of the stencil's
+        const HRIRData::Sample* const* used[2] = {neighbors[0], neighbors[1]};
+        const float* usedDelays[2] = {neighborDelays[0], neighborDelays[1]};
+        const HRIRData::Sample* subset[2][8];
+        float subsetDelays[2][8];
+        if (numUsed < numNeighbors) {
+            for (int ch = 0; ch < 2; ++ch) {
+                for (int j = 0; j < numUsed; ++j) {
+                    subset[ch][j] = neighbors[ch][usedNeighbors[j]];
+                    if (withDelays)
+                        subsetDelays[ch][j] = neighborDelays[ch][usedNeighbors[j]];
+                }
+                used[ch] = subset[ch];
+                usedDelays[ch] = subsetDelays[ch];
+            }
+        }
+        
+        // the right ear uses the same neighbors and weights, just with the other channel of each neighbor, the normalization is done in the same pass
+        const float sum0 = HRIRData::weightedSum(used[0], weights, numUsed, length, &hrir[0],            scaling != nullptr);
+        const float sum1 = HRIRData::weightedSum(used[1], weights, numUsed, length, &hrir[maxNumTimeSteps], scaling != nullptr);
+        if (scaling) {
+            scaling[p*2  ] = sum0;
+            scaling[p*2+1] = sum1;
+        }
+        // the onset delays are interpolated with the same (normalized) weights
+        if (withDelays) {
+            float weightSum = 0, delay0 = 0, delay1 = 0;
+            for (int j = 0; j < numUsed; ++j) {
+                weightSum += weights[j];
+                delay0 += weights[j] * usedDelays[0][j];
+                delay1 += weights[j] * usedDelays[1][j];
+            }
+            delays[p*2  ] = delay0 / weightSum;
+            delays[p*2+1] = delay1 / weightSum;
+        }
     }
 }
 
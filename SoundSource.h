@@ -32,6 +32,12 @@
 #include "Doppler.h"
 #include "Interpolator.h"
 #include "Data.h"
+#include "HRIRData.h"
+#include "HRIRCache.h"
+#include "FractionalDelay.h"
+#include "FFTConvolver.h"
+#include "VirtualSpeakers.h"
+#include "AmbisonicBus.h"
 #include "StackArray.h"
 #include <array>
 
@@ -180,6 +186,14 @@ typedef struct _Input_ {
 //    }
 //} Input;
 
+class HRIRBaker;
+class HRIRSphericalHarmonics;
+class HRIRBasisFilters;
+
+// how many of the neighboring hrirs are blended: just the nearest one, the 8 corners of the grid cell (tri-linear), or the full 64 hrir stencil. or instead
+// evaluate the spherical harmonic fit of the hrir data (see HRIRSphericalHarmonics), which falls back to the full stencil until the fit is done
+enum class HRIRInterpolationQuality { NEAREST, TRILINEAR, FULL, SPHERICAL_HARMONICS };
+
 // holds the information needed for producing audio for a SoundSource
 class PlayableSoundSource
 {
@@ -190,29 +204,101 @@ public:
     // update the PlayableSoundSource with the state of a SoundSource
     void updateFromSoundSource(const SoundSource& source) noexcept;
     std::array<float,3> getPosRAE() const noexcept;
-    // need to know this to allocate enough temp storage for intermediate audio processing
-    void allocateForMaxBufferSize(int N_max);
+    // need to know this to allocate enough temp storage for intermediate audio processing, along with the longest hrirs it will convolve (the full hrirs at
+    // the sample rate of the hrir data, up to maxNumTimeSteps). processAudio() outputs nothing while the hrir data is longer than that, so allocate for
+    // new hrir data before handing it over with setHRIRData()
+    void allocateForMaxBufferSize(int N_max, int newMaxHRIRLength = numTimeSteps);
 //    // set if the source processes audio in real time or not
 //    void setRealTime(bool isRealTime) noexcept;
 //    bool getRealTime() const noexcept;
     // control Doppler effect
     void setDopplerOn(bool newDopplerOn, float newSpeedOfSound);
     void setDopplerSampleRate(float sampleRate) noexcept;
+    // allocates the doppler buffers for the mode and frees the other mode's, not realtime safe
+    void setDopplerMode(DopplerMode newMode);
+    // the doppler delay lines of both modes (the other mode's are freed), for another thread to make longer ones while processAudio() runs if the source
+    // has gone farther than they were allocated for at the current speed of sound (or shorter ones if they are far too long), see DopplerBuffer
+    static constexpr int numDopplerBuffers = 3;
+    DopplerBuffer& getDopplerBuffer(int i) noexcept;
+    // bytes taken by the doppler delay lines
+    std::size_t getDopplerMemorySize() const noexcept;
     // control if the source is processing audio or not
     void setSourceMuted(bool newMutedState) noexcept;
     bool getSourceMuted() const noexcept;
-    // audio/hrir processing
-    void interpolateHRIR(const float* rae, float* hrir) const noexcept;
+    // set the (fully loaded) hrir data to process with and initialize the hrirs for the current position
+    void setHRIRData(const HRIRData* newHRIRData) noexcept;
+    // cache for the single position hrir interpolations (or nullptr for none), it must be cleared whenever the hrir data changes
+    void setHRIRCache(HRIRCache* newHRIRCache) noexcept;
+    // the cache must also be cleared whenever this changes
+    void setInterpolationQuality(HRIRInterpolationQuality newQuality) noexcept;
+    // the spherical harmonic fit to use for HRIRInterpolationQuality::SPHERICAL_HARMONICS (or nullptr for none), only used if it was fitted to the hrir data
+    // set with setHRIRData() and is ready. the cache must also be cleared whenever this changes
+    void setHRIRSphericalHarmonics(const HRIRSphericalHarmonics* newHRIRSphericalHarmonics) noexcept;
+    // hrirs baked along the source's path to use in realtime processing instead of interpolating them (or nullptr for none), posSec is where in the loop region
+    // the source is for the next processAudio() call, see HRIRBaker
+    void setHRIRBaker(const HRIRBaker* newHRIRBaker, int sourceIndex, float posSec) noexcept;
+    // render realtime blocks by mixing the input already convolved with the basis filters (as HRIRBasisConvolver::convolve() returns it)
+    // by the weights of the source's hrirs on them instead of convolving the input itself (or nullptr for the hrir convolution). only used if the filters were
+    // found for the hrir data set with setHRIRData() and are ready, set it again every block as convolvedInput changes
+    void setBasisFilterRendering(const HRIRBasisFilters* newHRIRBasisFilters, const float* newConvolvedInput) noexcept;
+    // render realtime blocks by panning onto the virtual speakers instead (or nullptr for the hrir convolution), which skips the hrir interpolation and
+    // convolution altogether. only used if the speakers' hrirs came from the hrir data set with setHRIRData()
+    void setVirtualSpeakerRendering(VirtualSpeakers* newVirtualSpeakers) noexcept;
+    // render realtime blocks by encoding into the ambisonic bus instead (or nullptr for the hrir convolution), which also skips the hrir interpolation and
+    // convolution. only used if the bus has a decoder
+    void setAmbisonicRendering(AmbisonicBus* newAmbisonicBus) noexcept;
+    // audio/hrir processing, the right ear's hrir follows the left's at +maxNumTimeSteps, the hrir's onset delays (for each ear) are also interpolated if the
+    // hrir data has them, and if scaling is given each ear's hrir comes out normalized to a sum of absolute values of 1 with the sum it had before put in
+    // scaling (for convolving with HRIRScaling and the like)
+    void interpolateHRIR(const float* rae, float* hrir, float* delays = nullptr, float* scaling = nullptr) const noexcept;
+    // interpolateHRIR() for count positions (rae triplets) at once, each one's output follows the previous one's, hrirs at strides of 2*maxNumTimeSteps (the
+    // right ear at +maxNumTimeSteps), delays and scaling at strides of 2. the neighboring hrirs are only looked up again when a position lands in a different
+    // grid cell than the one before it, so do trajectories in order
+    void interpolateHRIRs(const float* raes, int count, float* hrirs, float* delays = nullptr, float* scaling = nullptr) const noexcept;
     //void processAudioRealTime(const float* dataTime, int N, float* sourceOutput);
     //void interpolateHRIR(const std::array<float,3>& rae, float* hrir) const;
     void resetProcessingState() noexcept;
     void processAudio(const float* dataIn, int N, float* dataOut, const bool realTime);
+    // below this block size the (simd) direct convolution is cheaper than the fft convolution, they are about even at 2048 with 128 tap hrirs
+    static constexpr int fftConvolutionMinBlockSize = 2048;
     // for efficiently remembering the last accessed index of the pathPos interp
     int prevPathPosIndex = 0;
 private:
-    // for the doppler effect
+    const HRIRData* hrirData = nullptr;
+    HRIRCache* hrirCache = nullptr;
+    HRIRInterpolationQuality interpolationQuality = HRIRInterpolationQuality::FULL;
+    const HRIRSphericalHarmonics* hrirSphericalHarmonics = nullptr;
+    const HRIRBaker* hrirBaker = nullptr;
+    int hrirBakerSourceIndex = 0;
+    float hrirBakerPosSec = 0;
+    const HRIRBasisFilters* hrirBasisFilters = nullptr;
+    const float* basisConvolvedInput = nullptr;
+    VirtualSpeakers* virtualSpeakers = nullptr;
+    AmbisonicBus* ambisonicBus = nullptr;
+    // the source's speaker or ambisonic gains at the end of the last block panned onto the speakers or bus, and if the hrirs need interpolating again before
+    // convolving with them
+    VirtualSpeakers::Pan virtualSpeakerPan;
+    float ambisonicGains[AmbisonicBus::maxNumChannels] {};
+    bool busGainsValid = false;
+    bool HRIRStale = false;
+    void panOntoBus(const float* in, int N) noexcept;
+    // distance from the ear (0 left, 1 right) to where the source is now
+    float getEarToSourceDistance(int ch) const noexcept;
+    // put each ear's doppler tap output for the block into dopplerInputBuffer, starting where the block went into inputBuffer
+    void loadDopplerInputs(const float* const* dopplerOutputs, int inPos, int N) noexcept;
+    // number of taps actually used in each hrir (the hrir arrays keep maxNumTimeSteps strides), shorter for minimum phase hrirs and longer at higher sample rates
+    int hrirLength = numTimeSteps;
+    // longest hrirs the buffers and fft convolver are allocated for, see allocateForMaxBufferSize()
+    int maxHRIRLength = numTimeSteps;
+    // for the doppler effect, with DopplerMode::DELAY_LINE the input is delayed once with a tap for each ear's distance before the hrir convolution,
+    // with DopplerMode::PER_EAR each ear's output is delayed after it. only the buffers for the mode in use are allocated, see allocateDoppler()
     bool dopplerOn = false;
-    Doppler doppler[2];
+    DopplerMode dopplerMode = DopplerMode::DELAY_LINE;
+    DopplerDelayLine doppler;
+    Doppler earDopplers[2];
+    void allocateDoppler();
+    // each ear's doppler tap output history to convolve with that ear's hrir, mirrored like inputBuffer [ear][2 * inputBufferSize]
+    std::vector<float> dopplerInputBuffer;
     float dopplerMaxDistance = 20; // 20 meters is good to start with
     float dopplerSpeedOfSound = defaultSpeedOfSound;
     //bool dopplerMaxDistanceChanged = false;
@@ -221,7 +307,9 @@ private:
     //int newInputIndex = 0;
     int Nmax = 0;
 	
+	// circular buffer of the inputs, mirrored into its second half
 	std::vector<float> inputBuffer;
+	int inputBufferSize = 0;
 	int inputBufferInPos = 0;
 	int inputBufferOutPos = 0;
 
@@ -247,11 +335,26 @@ private:
     bool prevHRIRChange = false;
     bool HRIRChange = false; // indicates if there was change in position since the last processesing buffer
     int numHRIRs = 2;
-    std::array<float, 2*numTimeSteps> HRIR {0};
-    std::array<float, 4*numTimeSteps> HRIRs {0};
+    std::array<float, 2*maxNumTimeSteps> HRIR {0};
+    std::array<float, 4*maxNumTimeSteps> HRIRs {0};
     float HRIRScaling[4] {1.0};
 	std::vector<float> hqHRIRs;
 	std::vector<float> hqHRIRScaling;
+    // onset delays for each of the hrirs above when using minimum phase hrirs, put back after the convolution
+    float HRIRDelay[2] {0};
+    float HRIRDelays[4] {0};
+    std::vector<float> hqHRIRDelays;
+    FractionalDelay hrirDelay[2] {FractionalDelay(maxNumTimeSteps), FractionalDelay(maxNumTimeSteps)};
+    // fft convolution of both ears at once (or one after the other if each ear has its own input), crossfading between the old and new hrirs in the output
+    // when moving
+    void fftConvolve(const float* const* inputs, const float* whichHRIRs, const float* whichHRIRScaling, float* y, int N) noexcept;
+    // the basis filter rendering of both ears, blending between count hrirs the same way the direct convolution does
+    void mixBasisFilterOutputs(const float* whichHRIRs, const float* whichHRIRScaling, int count, float* y, int N) const noexcept;
+    FFTConvolver fftConvolver {numTimeSteps};
+    // spectra of the (scaled) current hrir for each ear in one slot, the other slot is for the next hrir
+    std::vector<std::complex<float>> HRIRSpectra;
+    int currentHRIRSpectra = 0;
+    bool HRIRSpectraValid = false;
     /*float* hqHRIRs = nullptr;
     float* hqHRIRScaling = nullptr;
     float* temp = nullptr;*/
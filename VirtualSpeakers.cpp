@@ -0,0 +1,244 @@
+//
+//  VirtualSpeakers.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "VirtualSpeakers.h"
+#include "SoundSource.h"
+#include "Functions.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr int VirtualSpeakers::defaultNumSpeakers;
+constexpr float VirtualSpeakers::radius;
+
+VirtualSpeakers::VirtualSpeakers(const int numSpeakersWanted)
+    : interpolator (new PlayableSoundSource())
+{
+    // the 6 axes, 12 edge midpoints, and 8 corners of a cube make the 26 point grid, the 50 point one adds 24 more points between those
+    const auto addPoints = [this] (const float a, const float b, const float c)
+    {
+        // every sign and ordering of (a, b, c), without the duplicates from zeros and repeated values
+        const float p[3] {a, b, c};
+        const int orders[6][3] {{0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0}};
+        for (const auto& order : orders) {
+            for (int signs = 0; signs < 8; ++signs) {
+                float xyz[3];
+                for (int i = 0; i < 3; ++i)
+                    xyz[i] = (signs >> i & 1 ? -1 : 1) * p[order[i]];
+                bool duplicate = false;
+                for (int s = 0; s < (int)xyzs.size() / 3 && !duplicate; ++s)
+                    duplicate = xyzs[3*s] == xyz[0] && xyzs[3*s+1] == xyz[1] && xyzs[3*s+2] == xyz[2];
+                if (!duplicate)
+                    xyzs.insert(xyzs.end(), xyz, xyz + 3);
+            }
+        }
+    };
+    const float oneOverSqrt2 = 1 / std::sqrt(2.0f), oneOverSqrt3 = 1 / std::sqrt(3.0f);
+    addPoints(1, 0, 0);
+    addPoints(oneOverSqrt2, oneOverSqrt2, 0);
+    addPoints(oneOverSqrt3, oneOverSqrt3, oneOverSqrt3);
+    if (numSpeakersWanted != 26)
+        addPoints(0.301511344577763f, 0.301511344577763f, 0.904534033733291f);
+    numSpeakers = (int)xyzs.size() / 3;
+
+    // the faces of the layout's convex hull are the vbap triangles, found by brute force since it's only done once. the 4 speakers of a square face make both
+    // ways of splitting it in 2, either of which pans the same along the diagonals so the overlap doesn't matter
+    const auto point = [this] (const int s) { return &xyzs[3*s]; };
+    for (int i = 0; i < numSpeakers; ++i) {
+        for (int j = i + 1; j < numSpeakers; ++j) {
+            for (int k = j + 1; k < numSpeakers; ++k) {
+                const float* a = point(i);
+                const float* b = point(j);
+                const float* c = point(k);
+                const float u[3] {b[0]-a[0], b[1]-a[1], b[2]-a[2]}, v[3] {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+                float normal[3] {u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0]};
+                const float length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+                if (length < 1e-6f)
+                    continue;
+                const float sign = (normal[0]*a[0] + normal[1]*a[1] + normal[2]*a[2]) < 0 ? -1 : 1; // facing out
+                for (auto& x : normal)
+                    x *= sign / length;
+                bool face = true;
+                for (int s = 0; s < numSpeakers && face; ++s) {
+                    const float* p = point(s);
+                    face = normal[0]*(p[0]-a[0]) + normal[1]*(p[1]-a[1]) + normal[2]*(p[2]-a[2]) <= 1e-5f;
+                }
+                if (!face)
+                    continue;
+                Triangle t;
+                t.speakers[0] = i;
+                t.speakers[1] = j;
+                t.speakers[2] = k;
+                const float det = a[0]*(b[1]*c[2] - b[2]*c[1]) - a[1]*(b[0]*c[2] - b[2]*c[0]) + a[2]*(b[0]*c[1] - b[1]*c[0]);
+                t.inverse[0][0] = (b[1]*c[2] - b[2]*c[1]) / det;
+                t.inverse[0][1] = (a[2]*c[1] - a[1]*c[2]) / det;
+                t.inverse[0][2] = (a[1]*b[2] - a[2]*b[1]) / det;
+                t.inverse[1][0] = (b[2]*c[0] - b[0]*c[2]) / det;
+                t.inverse[1][1] = (a[0]*c[2] - a[2]*c[0]) / det;
+                t.inverse[1][2] = (a[2]*b[0] - a[0]*b[2]) / det;
+                t.inverse[2][0] = (b[0]*c[1] - b[1]*c[0]) / det;
+                t.inverse[2][1] = (a[1]*c[0] - a[0]*c[1]) / det;
+                t.inverse[2][2] = (a[0]*b[1] - a[1]*b[0]) / det;
+                triangles.push_back(t);
+            }
+        }
+    }
+
+    hrirs.assign(numSpeakers * 2 * maxNumTimeSteps, 0.0f);
+    hrirScaling.assign(numSpeakers * 2, 0.0f);
+    hrirDelays.assign(numSpeakers * 2, 0.0f);
+    hrirDelayLines.assign(numSpeakers * 2, FractionalDelay(maxNumTimeSteps));
+    active.assign(numSpeakers, false);
+    silentSamples.assign(numSpeakers, 2 * maxNumTimeSteps);
+    interpolator->setInterpolationQuality(HRIRInterpolationQuality::FULL);
+}
+
+VirtualSpeakers::~VirtualSpeakers()
+{
+}
+
+void VirtualSpeakers::allocate(const int newMaxBlockSize)
+{
+    maxBlockSize = newMaxBlockSize;
+    feeds.assign(numSpeakers * maxBlockSize, 0.0f);
+    feedBufferSize = maxBlockSize + maxNumTimeSteps;
+    feedBuffers.assign(numSpeakers * 2 * feedBufferSize, 0.0f);
+    feedBufferPos = 0;
+}
+
+void VirtualSpeakers::reset() noexcept
+{
+    std::fill(feedBuffers.begin(), feedBuffers.end(), 0.0f);
+    feedBufferPos = 0;
+    for (auto& delayLine : hrirDelayLines)
+        delayLine.reset();
+    std::fill(silentSamples.begin(), silentSamples.end(), 2 * maxNumTimeSteps);
+}
+
+void VirtualSpeakers::setHRIRData(const HRIRData* newHRIRData) noexcept
+{
+    hrirData = newHRIRData;
+    hrirLength = hrirData->getLength();
+    interpolator->setHRIRData(hrirData);
+    for (int s = 0; s < numSpeakers; ++s) {
+        const float xyz[3] {radius * xyzs[3*s], radius * xyzs[3*s+1], radius * xyzs[3*s+2]};
+        float rae[3];
+        XYZtoRAE(xyz, rae);
+        interpolator->interpolateHRIR(rae, &hrirs[s*2*maxNumTimeSteps], &hrirDelays[2*s], &hrirScaling[2*s]);
+    }
+    for (auto& delayLine : hrirDelayLines)
+        delayLine.reset();
+}
+
+VirtualSpeakers::Pan VirtualSpeakers::pan(const float* rae) const noexcept
+{
+    const float direction[3] {1, rae[1], rae[2]};
+    float p[3];
+    RAEtoXYZ(direction, p);
+    // the triangle the direction is in has all of its gains positive, or if rounding puts it just outside of all of them then the one it's closest to
+    Pan pan;
+    float bestMinGain = -1e9f;
+    for (const auto& t : triangles) {
+        float g[3];
+        for (int i = 0; i < 3; ++i)
+            g[i] = p[0]*t.inverse[0][i] + p[1]*t.inverse[1][i] + p[2]*t.inverse[2][i];
+        const float minGain = std::min(g[0], std::min(g[1], g[2]));
+        if (minGain > bestMinGain) {
+            bestMinGain = minGain;
+            for (int i = 0; i < 3; ++i) {
+                pan.speakers[i] = t.speakers[i];
+                pan.gains[i] = std::max(0.0f, g[i]);
+            }
+            if (minGain >= 0)
+                break;
+        }
+    }
+    // constant power, and the hrir interpolation's 1/sqrt(r) falloff relative to the speakers' distance
+    const float power = pan.gains[0]*pan.gains[0] + pan.gains[1]*pan.gains[1] + pan.gains[2]*pan.gains[2];
+    const float scale = power > 0 ? std::sqrt(radius / (rae[0] * power)) : 0;
+    for (auto& g : pan.gains)
+        g *= scale;
+    return pan;
+}
+
+void VirtualSpeakers::beginBlock(const int N) noexcept
+{
+    std::fill_n(feeds.begin(), numSpeakers * N, 0.0f);
+    std::fill(active.begin(), active.end(), false);
+}
+
+void VirtualSpeakers::add(const float* signal, const Pan& from, const Pan& to, const int N) noexcept
+{
+    // the old gains ramp down while the new ones ramp up, which adds up to a linear ramp for the speakers in both
+    const float oneOverN = 1.0f / N;
+    for (int i = 0; i < 3; ++i) {
+        if (from.gains[i] != 0) {
+            float* const feed = &feeds[from.speakers[i] * N];
+            const float g = from.gains[i], dg = -g * oneOverN;
+            for (int n = 0; n < N; ++n)
+                feed[n] += signal[n] * (g + dg * n);
+            active[from.speakers[i]] = true;
+        }
+        if (to.gains[i] != 0) {
+            float* const feed = &feeds[to.speakers[i] * N];
+            const float dg = to.gains[i] * oneOverN;
+            for (int n = 0; n < N; ++n)
+                feed[n] += signal[n] * (dg * n);
+            active[to.speakers[i]] = true;
+        }
+    }
+}
+
+void VirtualSpeakers::render(float* out, const int N) noexcept
+{
+    STACK_ARRAY(float, y, 2*N)
+    STACK_ARRAY(float, yDelayed, N)
+    for (int s = 0; s < numSpeakers; ++s) {
+        // each feed goes in the mirrored copy too so the inputs for any output are contiguous
+        const float* const feed = &feeds[s * N];
+        float* const buffer = &feedBuffers[s * 2 * feedBufferSize];
+        for (int n = 0, i = feedBufferPos; n < N; ++n) {
+            buffer[i] = buffer[i + feedBufferSize] = feed[n];
+            if (++i == feedBufferSize)
+                i = 0;
+        }
+        // a speaker that hasn't had any signal for longer than its hrirs (and onset delays) has nothing left to say
+        silentSamples[s] = active[s] ? 0 : std::min(silentSamples[s] + N, 2 * maxNumTimeSteps);
+        if (silentSamples[s] >= 2 * maxNumTimeSteps)
+            continue;
+        const float* const hrir = &hrirs[s * 2 * maxNumTimeSteps];
+        convolveStereo(buffer, feedBufferPos, feedBufferSize, hrir, hrir + maxNumTimeSteps, hrirLength, hrirScaling[2*s], hrirScaling[2*s+1], &y[0], &y[N], N);
+        for (int ch = 0; ch < 2; ++ch) {
+            const float* yEar = &y[ch*N];
+            // put back the onset delay split off of minimum phase hrirs
+            if (hrirData->hasDelays()) {
+                hrirDelayLines[2*s + ch].process(&hrirDelays[2*s + ch], 1, 1, yEar, yDelayed, N);
+                yEar = yDelayed;
+            }
+            for (int n = 0; n < N; ++n)
+                out[ch*N + n] += yEar[n];
+        }
+    }
+    feedBufferPos = (feedBufferPos + N) % feedBufferSize;
+}
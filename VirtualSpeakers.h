@@ -0,0 +1,104 @@
+//
+//  VirtualSpeakers.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __VirtualSpeakers__
+#define __VirtualSpeakers__
+
+#include "HRIRData.h"
+#include "FractionalDelay.h"
+#include <memory>
+#include <vector>
+
+class PlayableSoundSource;
+
+// a fixed layout of virtual loudspeakers around the listener, each one with its own static hrir pair. sources are amplitude panned onto the speakers with
+// vbap (each source lands on the 3 speakers of the triangle of the layout it is in) and then each speaker's feed is convolved with its hrirs once per block,
+// so a moving source only costs updating its speaker gains and the convolution cost is bounded by the number of speakers instead of the number of sources.
+// for the audio thread, except for the constructor and allocate().
+class VirtualSpeakers
+{
+public:
+    // the speakers sit on the lebedev grids of 26 or 50 points, at this distance (in meters) from the center of the head
+    static constexpr int defaultNumSpeakers = 50;
+    static constexpr float radius = 1;
+
+    // a source's gains on (up to) 3 speakers
+    struct Pan
+    {
+        int speakers[3] {0, 0, 0};
+        float gains[3] {0, 0, 0};
+    };
+
+    /** the layout with 26 or 50 (anything else) speakers */
+    explicit VirtualSpeakers(int numSpeakers = defaultNumSpeakers);
+    ~VirtualSpeakers();
+    VirtualSpeakers(const VirtualSpeakers&) = delete;
+    VirtualSpeakers& operator=(const VirtualSpeakers&) = delete;
+    /** allocate for blocks of up to maxBlockSize samples, not realtime safe */
+    void allocate(int maxBlockSize);
+    /** forget the speaker feeds' history */
+    void reset() noexcept;
+    /** interpolate the speakers' hrirs from the (fully loaded) hrir data */
+    void setHRIRData(const HRIRData* newHRIRData) noexcept;
+    /** the hrir data the speakers' hrirs came from, nullptr until setHRIRData() */
+    const HRIRData* getHRIRData() const noexcept { return hrirData; }
+    int getNumSpeakers() const noexcept { return numSpeakers; }
+    /** the speaker gains for a source at rae, with constant power across the layout and the same falloff with distance as the hrir interpolation has */
+    Pan pan(const float* rae) const noexcept;
+    /** start a new block of N samples with all the speaker feeds silent */
+    void beginBlock(int N) noexcept;
+    /** add a source's signal to the speaker feeds, its gains moving linearly from one pan to the other across the block */
+    void add(const float* signal, const Pan& from, const Pan& to, int N) noexcept;
+    /** convolve each speaker's feed for the block with its hrirs and add them into the stereo output (the left ear at out[0], the right at out[N]) */
+    void render(float* out, int N) noexcept;
+
+private:
+    // inverse of the matrix with a triangle's speaker directions as its rows, so the vbap gains for a direction are it times this
+    struct Triangle
+    {
+        int speakers[3];
+        float inverse[3][3];
+    };
+    int numSpeakers;
+    std::vector<float> xyzs; // unit direction of each speaker
+    std::vector<Triangle> triangles;
+    // each speaker's hrir pair (at strides of numTimeSteps like PlayableSoundSource::interpolateHRIR()), scaling, and onset delays
+    const HRIRData* hrirData = nullptr;
+    int hrirLength = numTimeSteps;
+    std::vector<float> hrirs, hrirScaling, hrirDelays;
+    std::vector<FractionalDelay> hrirDelayLines;
+    std::unique_ptr<PlayableSoundSource> interpolator;
+    // this block's speaker feeds [speaker][sample], and each speaker's circular buffer of its feeds mirrored into its second half (like PlayableSoundSource's)
+    std::vector<float> feeds;
+    std::vector<float> feedBuffers;
+    int feedBufferSize = 0;
+    int feedBufferPos = 0;
+    int maxBlockSize = 0;
+    // which speakers got any signal this block, and for how many samples each one has been silent so its tail can be skipped once it has rung out
+    std::vector<bool> active;
+    std::vector<int> silentSamples;
+};
+
+#endif /* defined(__VirtualSpeakers__) */
@@ -0,0 +1,196 @@
+//
+//  WorkerPool.cpp
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #include <immintrin.h>
+#endif
+#ifdef _WIN32
+  #define NOMINMAX
+  #include <windows.h>
+#else
+  #include <climits>
+  #include <unistd.h>
+#endif
+
+constexpr int WorkerPool::maxNumWorkers;
+
+namespace
+{
+    // long enough to catch the next batch when the host hands over blocks back to back, short enough not to burn a core while it doesn't
+    constexpr auto spinTime = std::chrono::microseconds(200);
+
+    // let the other hyperthread of a core have it while spinning
+    inline void spinPause() noexcept
+    {
+      #if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+        _mm_pause();
+      #elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+      #endif
+    }
+
+    inline std::uint32_t batchOf(const std::uint64_t state) noexcept { return (std::uint32_t)(state >> 32); }
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start(const int numWorkers, const std::size_t newStackSize)
+{
+    const int wanted = std::max(0, std::min(numWorkers, maxNumWorkers));
+    if (wanted == getNumWorkers() && newStackSize == stackSize)
+        return;
+    stop();
+    shouldExit = false;
+    stackSize = newStackSize;
+    workers.reserve(wanted);
+    for (int w = 1; w <= wanted; ++w) {
+        workers.push_back({this, w, {}});
+        if (!startThread(workers.back())) {
+            workers.pop_back();
+            break;
+        }
+    }
+}
+
+void WorkerPool::stop()
+{
+    {
+        const std::lock_guard<std::mutex> lock (parkLock);
+        shouldExit = true;
+    }
+    unpark.notify_all();
+    for (auto& w : workers) {
+      #ifdef _WIN32
+        WaitForSingleObject(w.thread, INFINITE);
+        CloseHandle(w.thread);
+      #else
+        pthread_join(w.thread, nullptr);
+      #endif
+    }
+    workers.clear();
+}
+
+bool WorkerPool::startThread(Worker& worker) noexcept
+{
+  #ifdef _WIN32
+    worker.thread = CreateThread(nullptr, stackSize, &threadMain, &worker, stackSize > 0 ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0, nullptr);
+    return worker.thread != nullptr;
+  #else
+    pthread_attr_t attributes;
+    if (pthread_attr_init(&attributes) != 0)
+        return false;
+    if (stackSize > 0) {
+        // a whole number of pages (16 KB on some macs) and no less than the system allows
+        const std::size_t pageSize = (std::size_t)sysconf(_SC_PAGESIZE);
+        std::size_t size = std::max<std::size_t>(stackSize, PTHREAD_STACK_MIN);
+        size = (size + pageSize - 1) / pageSize * pageSize;
+        pthread_attr_setstacksize(&attributes, size);
+    }
+    const bool started = pthread_create(&worker.thread, &attributes, &threadMain, &worker) == 0;
+    pthread_attr_destroy(&attributes);
+    return started;
+  #endif
+}
+
+#ifdef _WIN32
+unsigned long __stdcall WorkerPool::threadMain(void* const worker)
+#else
+void* WorkerPool::threadMain(void* const worker)
+#endif
+{
+    const Worker& w = *static_cast<Worker*>(worker);
+    w.pool->work(w.index);
+  #ifdef _WIN32
+    return 0;
+  #else
+    return nullptr;
+  #endif
+}
+
+void WorkerPool::run(const int count, void (*function)(void*, int, int), void* context) noexcept
+{
+    if (count <= 0)
+        return;
+    taskCount.store(count, std::memory_order_relaxed);
+    taskFunction.store(function, std::memory_order_relaxed);
+    taskContext.store(context, std::memory_order_relaxed);
+    numTasksDone.store(0, std::memory_order_relaxed);
+    const std::uint32_t batch = batchOf(state.load(std::memory_order_relaxed)) + 1;
+    state.store((std::uint64_t)batch << 32);
+    // a worker about to park checks the state with the lock held after counting itself as parked, so either it sees the new batch or it gets woken
+    if (numParked.load() > 0) {
+        const std::lock_guard<std::mutex> lock (parkLock);
+        unpark.notify_all();
+    }
+    doTasks(batch, 0);
+    while (numTasksDone.load(std::memory_order_acquire) < count)
+        spinPause();
+}
+
+void WorkerPool::doTasks(const std::uint32_t batch, const int worker) noexcept
+{
+    std::uint64_t s = state.load(std::memory_order_acquire);
+    while (batchOf(s) == batch) {
+        // the batch can't move on while any of its tasks are left, so once a task is claimed the function and context read are the claimed batch's
+        const int task = (int)(std::uint32_t)s;
+        if (task >= taskCount.load(std::memory_order_relaxed))
+            return;
+        if (state.compare_exchange_weak(s, s + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            taskFunction.load(std::memory_order_relaxed)(taskContext.load(std::memory_order_relaxed), task, worker);
+            numTasksDone.fetch_add(1, std::memory_order_release);
+            s = state.load(std::memory_order_acquire);
+        }
+    }
+}
+
+void WorkerPool::work(const int worker) noexcept
+{
+    std::uint32_t lastBatch = batchOf(state.load(std::memory_order_acquire));
+    while (!shouldExit.load(std::memory_order_relaxed)) {
+        std::uint32_t batch = batchOf(state.load(std::memory_order_acquire));
+        const auto spinEnd = std::chrono::steady_clock::now() + spinTime;
+        while (batch == lastBatch && !shouldExit.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < spinEnd) {
+            for (int i = 0; i < 64 && batch == lastBatch; ++i) {
+                spinPause();
+                batch = batchOf(state.load(std::memory_order_acquire));
+            }
+        }
+        if (batch == lastBatch) {
+            std::unique_lock<std::mutex> lock (parkLock);
+            ++numParked;
+            unpark.wait(lock, [&] { return shouldExit.load() || batchOf(state.load()) != lastBatch; });
+            --numParked;
+            continue;
+        }
+        lastBatch = batch;
+        doTasks(batch, worker);
+    }
+}
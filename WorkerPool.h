@@ -0,0 +1,106 @@
+//
+//  WorkerPool.h
+//  ThreeDAudio
+//
+//
+/*
+     3DAudio: simulates surround sound audio for headphones
+     Copyright (C) 2016  Andrew Barker
+
+     This program is free software: you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published by
+     the Free Software Foundation, either version 3 of the License, or
+     (at your option) any later version.
+
+     This program is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+     GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     The author can be contacted via email at andrew.barker.12345@gmail.com.
+ */
+
+#ifndef __WorkerPool__
+#define __WorkerPool__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#ifndef _WIN32
+  #include <pthread.h>
+#endif
+
+// a fixed set of threads that the audio thread hands a batch of independent tasks to (like rendering each source), spreading them over the audio thread
+// itself and the workers and returning once they're all done. handing out tasks never allocates or takes a lock, the workers grab them off an atomic
+// counter. between batches the workers spin for a little while and then park, and waking parked workers is the only time the audio thread touches a mutex
+// (one nobody else is holding at that point, the parked workers are waiting on it). the threads are the platform's own rather than std::threads so their
+// stack size can be picked, the tasks may put a lot more on the stack than the default (512 KB on a mac) holds.
+class WorkerPool
+{
+public:
+    static constexpr int maxNumWorkers = 31;
+
+    WorkerPool() {}
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    /** (re)start with numWorkers threads (0 to maxNumWorkers) besides the calling one, each with a stack of at least stackSize bytes (0 for the system's
+        default), does nothing if that many are already running with that stack size. fewer are started if the system won't make them. not realtime safe */
+    void start(int numWorkers, std::size_t stackSize = 0);
+    /** stop and join the threads, not realtime safe */
+    void stop();
+    /** number of threads besides the one calling run() */
+    int getNumWorkers() const noexcept { return (int)workers.size(); }
+    /** the stack size the threads were asked for in start() */
+    std::size_t getStackSize() const noexcept { return stackSize; }
+    /** call task(i, worker) for each i in [0, count) on the calling thread (worker 0) and the pool's threads (workers 1 to getNumWorkers()), in no particular
+        order or split, and return once they're all done. only one thread may call this at a time */
+    template <typename Task>
+    void run(const int count, Task& task) noexcept { run(count, &invoke<Task>, &task); }
+
+private:
+    template <typename Task>
+    static void invoke(void* task, const int i, const int worker) noexcept { (*static_cast<Task*>(task))(i, worker); }
+    void run(int count, void (*function)(void*, int, int), void* context) noexcept;
+    void work(int worker) noexcept;
+    // do tasks of a batch until there are none left (or the batch is over)
+    void doTasks(std::uint32_t batch, int worker) noexcept;
+    struct Worker
+    {
+        WorkerPool* pool;
+        int index;
+      #ifdef _WIN32
+        void* thread; // HANDLE
+      #else
+        pthread_t thread;
+      #endif
+    };
+    // start a worker's thread, false if it couldn't be made
+    bool startThread(Worker& worker) noexcept;
+  #ifdef _WIN32
+    static unsigned long __stdcall threadMain(void* worker);
+  #else
+    static void* threadMain(void* worker);
+  #endif
+    // reserved up front so the threads can hold on to their Worker
+    std::vector<Worker> workers;
+    std::size_t stackSize = 0;
+    // which batch (high 32 bits) and the next task of it to hand out (low 32 bits), the rest of the batch is set before it is stored
+    std::atomic<std::uint64_t> state {0};
+    std::atomic<int> taskCount {0};
+    std::atomic<void (*)(void*, int, int)> taskFunction {nullptr};
+    std::atomic<void*> taskContext {nullptr};
+    std::atomic<int> numTasksDone {0};
+    std::atomic<int> numParked {0};
+    std::mutex parkLock;
+    std::condition_variable unpark;
+    std::atomic<bool> shouldExit {false};
+};
+
+#endif /* defined(__WorkerPool__) */